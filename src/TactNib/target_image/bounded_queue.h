@@ -0,0 +1,92 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: bounded_queue.h
+ * Purpose:	  Fixed capacity, blocking FIFO used to connect pipeline stages.
+ *            A full queue blocks the producer (backpressure); closing the queue
+ *            wakes everyone and lets consumers drain what is left.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_BOUNDED_QUEUE_H
+#define SYSTEM_API_BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+namespace TactNib {
+
+    template<typename T>
+    class BoundedQueue {
+        public:
+            explicit BoundedQueue(size_t capacity) : capacity_(capacity > 0 ? capacity : 1), closed_(false) {}
+
+            // Wait for space; returns false if the queue was closed
+            bool Push(T item)
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                not_full_.wait(lock, [this]() { return closed_ || items_.size() < capacity_; });
+                if (closed_) {
+                    return false;
+                }
+                items_.push_back(std::move(item));
+                lock.unlock();
+                not_empty_.notify_one();
+                return true;
+            }
+
+            // Returns false instead of waiting when the queue is full or closed
+            bool TryPush(T item)
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (closed_ || items_.size() >= capacity_) {
+                    return false;
+                }
+                items_.push_back(std::move(item));
+                lock.unlock();
+                not_empty_.notify_one();
+                return true;
+            }
+
+            // Wait for an item; returns false once the queue is closed and empty
+            bool Pop(T &item)
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                not_empty_.wait(lock, [this]() { return closed_ || !items_.empty(); });
+                if (items_.empty()) {
+                    return false;
+                }
+                item = std::move(items_.front());
+                items_.pop_front();
+                lock.unlock();
+                not_full_.notify_one();
+                return true;
+            }
+
+            void Close()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    closed_ = true;
+                }
+                not_full_.notify_all();
+                not_empty_.notify_all();
+            }
+
+        private:
+            const size_t capacity_;
+            bool closed_;
+            std::deque<T> items_;
+            std::mutex mutex_;
+            std::condition_variable not_full_;
+            std::condition_variable not_empty_;
+    };
+
+} // TactNib
+
+#endif //SYSTEM_API_BOUNDED_QUEUE_H
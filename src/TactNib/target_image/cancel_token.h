@@ -0,0 +1,65 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: cancel_token.h
+ * Purpose:	  Cancellation flag and deadline of one finder request. The caller
+ *            keeps a copy to cancel a superseded frame; the finder checks its
+ *            copy between stages and inside the long loops.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_CANCEL_TOKEN_H
+#define SYSTEM_API_CANCEL_TOKEN_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+namespace TactNib {
+
+    // Copies share one state, so use a new token per request. Thread safe.
+    class CancelToken {
+        public:
+            using Clock = std::chrono::steady_clock;
+
+            CancelToken() : state_(std::make_shared<State>()) {}
+
+            void Cancel() { state_->cancelled.store(true, std::memory_order_relaxed); }
+
+            // Stop at deadline as if cancelled
+            void SetDeadline(Clock::time_point deadline)
+            {
+                state_->deadline.store(deadline.time_since_epoch().count(), std::memory_order_relaxed);
+            }
+            void SetTimeout(Clock::duration timeout) { SetDeadline(Clock::now() + timeout); }
+
+            bool cancelled() const { return state_->cancelled.load(std::memory_order_relaxed); }
+            bool expired() const
+            {
+                Clock::rep deadline = state_->deadline.load(std::memory_order_relaxed);
+                return deadline != kNoDeadline && Clock::now().time_since_epoch().count() >= deadline;
+            }
+
+            // What the finder checks
+            bool StopRequested() const { return cancelled() || expired(); }
+
+        private:
+            static constexpr Clock::rep kNoDeadline = std::numeric_limits<Clock::rep>::max();
+
+            struct State
+            {
+                std::atomic<bool> cancelled{false};
+                std::atomic<Clock::rep> deadline{kNoDeadline};
+            };
+
+            std::shared_ptr<State> state_;
+    };
+
+} // TactNib
+
+#endif //SYSTEM_API_CANCEL_TOKEN_H
@@ -0,0 +1,177 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: cascade_strategy.cc
+ * Purpose:	  Target finder that runs a cheap OpenCV configuration first and the
+ *            expensive one only when the cheap result does not look trustworthy.
+ *            The second pass starts from the scene the first pass already
+ *            decoded, scaled and brightness adjusted.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+
+#include "cascade_strategy.h"
+#include "opencv_algo.h"
+#include "trace.h"
+
+namespace TactNib {
+
+    //================================================
+    // Default constructor
+    //================================================
+    CascadeStrategy::CascadeStrategy(std::string image_scene_file, std::string image_object_file)
+        : TargetFinderStrategy(image_scene_file, image_object_file), fast_(std::string(), std::string()),
+          accurate_(std::string(), std::string()) {}
+
+    //================================================
+    // Member Function: SetConfig
+    //================================================
+    void CascadeStrategy::SetConfig(const FinderConfig &config) {
+
+        config_ = config;
+        accurate_.SetConfig(config);
+
+        FinderConfig fast_config = config;
+        fast_config.detector_type = config.cascade_detector_type;
+        fast_config.extract_type = config.cascade_extract_type;
+        fast_config.match_type = config.cascade_match_type;
+        fast_config.filter_type = config.cascade_filter_type;
+        fast_.SetConfig(fast_config);
+    }
+
+    //================================================
+    // Member Function: ShareSettings
+    //================================================
+    void CascadeStrategy::ShareSettings(OpenCvStrategy &stage) const {
+
+        stage.SetSceneSource(scene_source_);
+        stage.SetTargetSource(target_source_);
+        stage.SetTemplatePack(template_pack_);
+        stage.SetDisplayImages(display_images_);
+        stage.SetDebugSink(debug_sink_);
+        stage.SetCancelToken(cancel_);
+    }
+
+    //================================================
+    // Member Function: FindTarget
+    //================================================
+    TargetObjectImage CascadeStrategy::FindTarget() {
+
+        // Both stages analyze the same template image, so one decoded and prepared scene
+        // serves both
+        ShareSettings(fast_);
+        if (!fast_.PrepareTemplate()) {
+            return TargetObjectImage();
+        }
+
+        SceneContext context;
+        context.cancel = cancel_;
+        std::string scene_name = scene_source_.name();
+        context.label = scene_name.substr(scene_name.find_last_of('/') + 1);
+        context.label = context.label.substr(0, context.label.find_last_of('.'));
+
+        TraceScope trace_load("scene_load");
+        context.image_scene = scene_source_.DecodeForHeight(fast_.active_template()->image().rows);
+        trace_load.End();
+        if (context.image_scene.empty()) {
+            std::cout << "Unable to read scene image " << scene_name << std::endl;
+            return TargetObjectImage();
+        }
+        cv::Size source_size = scene_source_.FullSize();
+        context.source_scale = cv::Point2d(static_cast<double>(source_size.width) / context.image_scene.cols,
+                                           static_cast<double>(source_size.height) / context.image_scene.rows);
+
+        fast_.PrepareScene(context);
+        cv::Mat image_prepared = context.image_scene;
+
+        // Stage 1: the cheap configuration
+        TraceScope trace_total("find_target");
+        std::cout << "Cascade: fast stage " << ToString(config_.cascade_detector_type) << std::endl;
+        fast_.DetectFeatures(context);
+        fast_.MatchFeatures(context);
+        fast_.EstimateHomography(context);
+        fast_.RefineAlignment(context);
+        fast_.WarpAndScore(context);
+        if (context.stopped || Confident(context)) {
+            std::cout << "Total : Summary compute time is  " << trace_total.End() << " s" << std::endl;
+            std::cout << "Image Similarity: " << context.score << std::endl;
+            return fast_.MakeResult(context);
+        }
+
+        // Stage 2: the accurate configuration on the prepared scene
+        ShareSettings(accurate_);
+        if (!accurate_.PrepareTemplate()) {
+            return fast_.MakeResult(context);
+        }
+        std::cout << "Cascade: accurate stage " << ToString(config_.detector_type) << std::endl;
+        SceneContext accurate_context;
+        accurate_context.frame_index = context.frame_index;
+        accurate_context.cancel = cancel_;
+        accurate_context.label = context.label + "_accurate";
+        accurate_context.image_scene = image_prepared;
+        accurate_context.source_scale = context.source_scale;
+        accurate_.DetectFeatures(accurate_context);
+        accurate_.MatchFeatures(accurate_context);
+        accurate_.EstimateHomography(accurate_context);
+        accurate_.RefineAlignment(accurate_context);
+        accurate_.WarpAndScore(accurate_context);
+        std::cout << "Total : Summary compute time is  " << trace_total.End() << " s" << std::endl;
+
+        // The accurate stage is not always better, e.g. when the scene itself is poor. A
+        // stopped accurate stage has no score to compare.
+        if (!accurate_context.valid || accurate_context.stopped ||
+            (context.valid && context.score > accurate_context.score)) {
+            std::cout << "Image Similarity: " << context.score << std::endl;
+            return fast_.MakeResult(context);
+        }
+        std::cout << "Image Similarity: " << accurate_context.score << std::endl;
+        return accurate_.MakeResult(accurate_context);
+    }
+
+    //================================================
+    // Member Function: Confident
+    //================================================
+    bool CascadeStrategy::Confident(const SceneContext &context) const {
+
+        if (!context.valid || context.scene_corners.size() != 4) {
+            std::cout << "Cascade: no alignment" << std::endl;
+            return false;
+        }
+
+        // RANSAC support of the homography
+        double inlier_ratio = context.points_scene.empty() ? 0.0 :
+                              static_cast<double>(context.inliers) / context.points_scene.size();
+        if (context.inliers < config_.cascade_min_inliers || inlier_ratio < config_.cascade_min_inlier_ratio) {
+            std::cout << "Cascade: " << context.inliers << " inliers, ratio " << inlier_ratio << std::endl;
+            return false;
+        }
+
+        // The paper seen through a camera: a convex quad of reasonable size and skew
+        const std::vector<cv::Point2f> &corners = context.scene_corners;
+        double area = cv::contourArea(corners);
+        if (!cv::isContourConvex(corners) || area < config_.cascade_min_area * context.image_scene.size().area()) {
+            std::cout << "Cascade: implausible corners, area " << area << std::endl;
+            return false;
+        }
+        for (int i = 0; i < 2; i++) {
+            double side = cv::norm(corners[i + 1] - corners[i]);
+            double opposite = cv::norm(corners[(i + 3) % 4] - corners[i + 2]);
+            if (std::min(side, opposite) * config_.cascade_max_side_ratio < std::max(side, opposite)) {
+                std::cout << "Cascade: implausible corners, sides " << side << " and " << opposite << std::endl;
+                return false;
+            }
+        }
+
+        if (context.score < config_.cascade_min_score) {
+            std::cout << "Cascade: score " << context.score << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+} // TactNib
@@ -0,0 +1,52 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: cascade_strategy.h
+ * Purpose:	  Target finder that runs a cheap OpenCV configuration first and the
+ *            expensive one only when the cheap result does not look trustworthy.
+ *            The second pass starts from the scene the first pass already
+ *            decoded, scaled and brightness adjusted.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_CASCADE_STRATEGY_H
+#define SYSTEM_API_CASCADE_STRATEGY_H
+
+#include <string>
+#include "finder_config.h"
+#include "opencv_strategy.h"
+#include "scene_context.h"
+#include "target_finder_strategy.h"
+
+namespace TactNib {
+
+    class CascadeStrategy: public TargetFinderStrategy
+    {
+        public:
+            CascadeStrategy(std::string, std::string);
+
+            // config's algorithms are the accurate stage; cascade_* select the fast stage
+            void SetConfig(const FinderConfig &config);
+
+            // True when a stage result meets every cascade_* threshold of config_
+            bool Confident(const SceneContext &) const;
+
+        private:
+        TargetObjectImage FindTarget() override;
+
+        // Hand this strategy's sources and display settings to a stage
+        void ShareSettings(OpenCvStrategy &stage) const;
+
+        FinderConfig config_;
+        OpenCvStrategy fast_;
+        OpenCvStrategy accurate_;
+
+        protected:
+    };
+
+} // TactNib
+
+#endif //SYSTEM_API_CASCADE_STRATEGY_H
@@ -0,0 +1,213 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: color_transfer.cc
+ * Purpose:	  Brightness normalization of the scene to the template: the HSV
+ *            saturation of the scene is shifted and scaled so its mean and
+ *            standard deviation match the template's. Works directly on BGR
+ *            pixels; one fused pass measures the scene, one transforms it.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <algorithm>
+#include <cmath>
+
+#include "color_transfer.h"
+#include "simd_support.h"
+
+using namespace cv;
+
+namespace TactNib {
+
+    namespace {
+        // Pixels converted at a time; the planes of a chunk stay in L1
+        const int kChunk = 256;
+
+        // Row ranges processed in parallel; fixed so the sums are deterministic
+        const int kStripes = 16;
+
+        // Keeps the saturation gain finite on gray pixels, where max - channel is 0 anyway
+        const float kMinSaturation = 1e-3f;
+
+        //================================================
+        // Function: ChunkSaturation
+        //  Note: Splits count BGR pixels into float planes b, g, r and computes the
+        //        HSV value v = max and saturation s = 255 * (max - min) / max, the
+        //        same quantities cvtColor(COLOR_BGR2HSV) computes, without rounding.
+        //================================================
+        void ChunkSaturation(const uchar *bgr, int count, float *b, float *g, float *r, float *v, float *s)
+        {
+            for (int i = 0; i < count; i++) {
+                b[i] = bgr[3 * i];
+                g[i] = bgr[3 * i + 1];
+                r[i] = bgr[3 * i + 2];
+            }
+
+            int i = 0;
+#if defined(TACTNIB_SIMD_FLOAT)
+            const Simd::FloatVec scale = Simd::Set(255.0f);
+            const Simd::FloatVec one = Simd::Set(1.0f);
+            for (; i + Simd::kFloatLanes <= count; i += Simd::kFloatLanes) {
+                Simd::FloatVec vb = Simd::Load(b + i);
+                Simd::FloatVec vg = Simd::Load(g + i);
+                Simd::FloatVec vr = Simd::Load(r + i);
+                Simd::FloatVec vmax = Simd::Max(Simd::Max(vb, vg), vr);
+                Simd::FloatVec vmin = Simd::Min(Simd::Min(vb, vg), vr);
+                Simd::Store(v + i, vmax);
+                // A black pixel has max = min = 0; dividing by max(max, 1) gives s = 0
+                Simd::Store(s + i, Simd::Div(Simd::Mul(Simd::Sub(vmax, vmin), scale), Simd::Max(vmax, one)));
+            }
+#endif
+            for (; i < count; i++) {
+                float vmax = std::max(std::max(b[i], g[i]), r[i]);
+                float vmin = std::min(std::min(b[i], g[i]), r[i]);
+                v[i] = vmax;
+                s[i] = (vmax - vmin) * 255.0f / std::max(vmax, 1.0f);
+            }
+        }
+
+        //================================================
+        // Function: ChunkTransform
+        //  Note: New saturation s' = gain * s + offset clipped to [0, 255]. Keeping hue
+        //        and value, every channel moves along its distance to the maximum:
+        //        c' = v - (v - c) * s' / s. Results are left in b, g, r.
+        //================================================
+        void ChunkTransform(int count, float gain, float offset, float *b, float *g, float *r, const float *v,
+                            const float *s)
+        {
+            int i = 0;
+#if defined(TACTNIB_SIMD_FLOAT)
+            const Simd::FloatVec vgain = Simd::Set(gain);
+            const Simd::FloatVec voffset = Simd::Set(offset);
+            const Simd::FloatVec zero = Simd::Set(0.0f);
+            const Simd::FloatVec full = Simd::Set(255.0f);
+            const Simd::FloatVec min_saturation = Simd::Set(kMinSaturation);
+            for (; i + Simd::kFloatLanes <= count; i += Simd::kFloatLanes) {
+                Simd::FloatVec vs = Simd::Load(s + i);
+                Simd::FloatVec vv = Simd::Load(v + i);
+                Simd::FloatVec target = Simd::Min(Simd::Max(Simd::MulAdd(vs, vgain, voffset), zero), full);
+                Simd::FloatVec ratio = Simd::Div(target, Simd::Max(vs, min_saturation));
+                Simd::Store(b + i, Simd::Sub(vv, Simd::Mul(Simd::Sub(vv, Simd::Load(b + i)), ratio)));
+                Simd::Store(g + i, Simd::Sub(vv, Simd::Mul(Simd::Sub(vv, Simd::Load(g + i)), ratio)));
+                Simd::Store(r + i, Simd::Sub(vv, Simd::Mul(Simd::Sub(vv, Simd::Load(r + i)), ratio)));
+            }
+#endif
+            for (; i < count; i++) {
+                float target = std::min(std::max(s[i] * gain + offset, 0.0f), 255.0f);
+                float ratio = target / std::max(s[i], kMinSaturation);
+                b[i] = v[i] - (v[i] - b[i]) * ratio;
+                g[i] = v[i] - (v[i] - g[i]) * ratio;
+                r[i] = v[i] - (v[i] - r[i]) * ratio;
+            }
+        }
+
+        Range StripeRows(int stripe, int rows)
+        {
+            return Range(rows * stripe / kStripes, rows * (stripe + 1) / kStripes);
+        }
+    }
+
+    //================================================
+    // Member Function: SetReference
+    //================================================
+    void ColorTransfer::SetReference(const Mat &reference)
+    {
+        reference_ = Measure(reference);
+        has_reference_ = true;
+    }
+
+    //================================================
+    // Member Function: Measure
+    //================================================
+    ColorStat ColorTransfer::Measure(const Mat &image)
+    {
+        ColorStat stat;
+        if (image.empty() || image.type() != CV_8UC3) {
+            return stat;
+        }
+
+        double sums[kStripes][2] = {};
+        parallel_for_(Range(0, kStripes), [&](const Range &range) {
+            float b[kChunk], g[kChunk], r[kChunk], v[kChunk], s[kChunk];
+            for (int stripe = range.start; stripe < range.end; stripe++) {
+                Range rows = StripeRows(stripe, image.rows);
+                for (int y = rows.start; y < rows.end; y++) {
+                    const uchar *row = image.ptr<uchar>(y);
+                    for (int x = 0; x < image.cols; x += kChunk) {
+                        int count = std::min(kChunk, image.cols - x);
+                        ChunkSaturation(row + 3 * x, count, b, g, r, v, s);
+
+                        // Float sums of one chunk stay exact enough; chunks are added in double
+                        float chunk_sum = 0.0f;
+                        float chunk_sum_sq = 0.0f;
+                        for (int i = 0; i < count; i++) {
+                            chunk_sum += s[i];
+                            chunk_sum_sq += s[i] * s[i];
+                        }
+                        sums[stripe][0] += chunk_sum;
+                        sums[stripe][1] += chunk_sum_sq;
+                    }
+                }
+            }
+        });
+
+        double sum = 0.0;
+        double sum_sq = 0.0;
+        for (int stripe = 0; stripe < kStripes; stripe++) {
+            sum += sums[stripe][0];
+            sum_sq += sums[stripe][1];
+        }
+        const double pixels = static_cast<double>(image.rows) * image.cols;
+        stat.mean = sum / pixels;
+        stat.stddev = std::sqrt(std::max(sum_sq / pixels - stat.mean * stat.mean, 0.0));
+        return stat;
+    }
+
+    //================================================
+    // Member Function: Apply
+    //================================================
+    void ColorTransfer::Apply(const Mat &scene, Mat &dst) const
+    {
+        if (!has_reference_ || scene.empty() || scene.type() != CV_8UC3) {
+            if (dst.data != scene.data) {
+                scene.copyTo(dst);
+            }
+            return;
+        }
+
+        // Match the scene's saturation mean and spread to the template's; a flat
+        // scene is only shifted
+        ColorStat stat = Measure(scene);
+        float gain = stat.stddev > 1e-6 ? static_cast<float>(reference_.stddev / stat.stddev) : 1.0f;
+        float offset = static_cast<float>(reference_.mean - stat.mean * gain);
+
+        // Every chunk is read before it is written, so dst may be scene
+        Mat source = scene;
+        dst.create(scene.size(), CV_8UC3);
+        parallel_for_(Range(0, kStripes), [&](const Range &range) {
+            float b[kChunk], g[kChunk], r[kChunk], v[kChunk], s[kChunk];
+            for (int stripe = range.start; stripe < range.end; stripe++) {
+                Range rows = StripeRows(stripe, source.rows);
+                for (int y = rows.start; y < rows.end; y++) {
+                    const uchar *in = source.ptr<uchar>(y);
+                    uchar *out = dst.ptr<uchar>(y);
+                    for (int x = 0; x < source.cols; x += kChunk) {
+                        int count = std::min(kChunk, source.cols - x);
+                        ChunkSaturation(in + 3 * x, count, b, g, r, v, s);
+                        ChunkTransform(count, gain, offset, b, g, r, v, s);
+                        uchar *pixel = out + 3 * x;
+                        for (int i = 0; i < count; i++) {
+                            pixel[3 * i] = saturate_cast<uchar>(b[i]);
+                            pixel[3 * i + 1] = saturate_cast<uchar>(g[i]);
+                            pixel[3 * i + 2] = saturate_cast<uchar>(r[i]);
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+} // TactNib
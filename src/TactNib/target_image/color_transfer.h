@@ -0,0 +1,53 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: color_transfer.h
+ * Purpose:	  Brightness normalization of the scene to the template: the HSV
+ *            saturation of the scene is shifted and scaled so its mean and
+ *            standard deviation match the template's. Works directly on BGR
+ *            pixels; one fused pass measures the scene, one transforms it.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_COLOR_TRANSFER_H
+#define SYSTEM_API_COLOR_TRANSFER_H
+
+#include <opencv2/core.hpp>
+
+namespace TactNib {
+
+    // Statistics of the HSV saturation, on the 0..255 scale of OpenCV's 8-bit HSV
+    struct ColorStat
+    {
+        double mean = 0.0;
+        double stddev = 0.0;
+    };
+
+    class ColorTransfer {
+        public:
+            ColorTransfer() = default;
+
+            // Measure the reference (template) once; BGR 8-bit
+            void SetReference(const cv::Mat &reference);
+            void SetReference(const ColorStat &stat) { reference_ = stat; has_reference_ = true; }
+            bool HasReference() const { return has_reference_; }
+            const ColorStat &reference() const { return reference_; }
+
+            // Measure the scene and transform it into dst, which may be the scene itself.
+            // Images that are not BGR 8-bit are copied unchanged.
+            void Apply(const cv::Mat &scene, cv::Mat &dst) const;
+
+            // Saturation statistics of a BGR 8-bit image
+            static ColorStat Measure(const cv::Mat &image);
+
+        private:
+            bool has_reference_ = false;
+            ColorStat reference_;
+    };
+
+} // TactNib
+
+#endif //SYSTEM_API_COLOR_TRANSFER_H
@@ -0,0 +1,257 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: contour_strategy.cc
+ * Purpose:	  Concrete class for image finder algorithm. The purpose of this class is
+ *            to implement the strategy design pattern to allow various algorithms
+ *            to be used at runtime. This class will implement the "FindTarget" function
+ *            that will find the paper target by its outline, without features.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+
+#include "contour_strategy.h"
+#include "morphology.h"
+#include "opencv_algo.h"
+#include "trace.h"
+
+namespace TactNib {
+
+    namespace {
+        // Largest of B, G and R: the white paper and its blue print both stand out from
+        // the background, where in gray the blue print is as dark as the background
+        void BrightestChannel(const Mat &image, Mat &value)
+        {
+            std::vector<Mat> channels;
+            split(image, channels);
+            max(channels[0], channels[1], value);
+            max(value, channels[2], value);
+        }
+
+        // Sub-pixel corner positions; only a patch around each corner is looked at
+        void RefineCorners(const Mat &scene, std::vector<Point2f> &corners, int window)
+        {
+            const int reach = 2 * window + 2;
+            const Rect frame(0, 0, scene.cols, scene.rows);
+            for (Point2f &corner : corners) {
+                Rect patch = Rect(cvFloor(corner.x) - reach, cvFloor(corner.y) - reach, 2 * reach + 1, 2 * reach + 1) &
+                             frame;
+                if (patch.width < 2 * window + 5 || patch.height < 2 * window + 5) {
+                    continue;
+                }
+                Mat value;
+                BrightestChannel(scene(patch), value);
+                std::vector<Point2f> point = {corner - Point2f(static_cast<float>(patch.x), static_cast<float>(patch.y))};
+                cornerSubPix(value, point, Size(window, window), Size(-1, -1),
+                             TermCriteria(TermCriteria::EPS + TermCriteria::COUNT, 30, 0.01));
+                corner = point[0] + Point2f(static_cast<float>(patch.x), static_cast<float>(patch.y));
+            }
+        }
+    }
+
+    //================================================
+    // Default constructor
+    //================================================
+    ContourStrategy::ContourStrategy(std::string image_scene_file, std::string image_object_file):TargetFinderStrategy(image_scene_file, image_object_file){}
+
+    //================================================
+    // Member Function: FindTarget
+    //================================================
+    TargetObjectImage ContourStrategy::FindTarget() {
+
+        TargetObjectImage target_object;
+        if (!PrepareTemplate()) {
+            return target_object;
+        }
+
+        // Corners are refined at full resolution
+        TraceScope trace_load("scene_load");
+        Mat image_scene = scene_source_.Decode();
+        trace_load.End();
+        if (image_scene.empty()) {
+            std::cout << "Unable to read scene image " << scene_source_.name() << std::endl;
+            return target_object;
+        }
+
+        // Step 1: Paper outline
+        TraceScope trace_total("find_target");
+        std::cout << "Step 1: Find the paper outline" << std::endl;
+        TraceScope trace_quad("quad");
+        std::vector<Point2f> corners;
+        bool found = FindQuad(image_scene, corners);
+        std::cout << "Step 1: Compute time is  " << trace_quad.End() << " s" << std::endl;
+        if (!found) {
+            std::cout << "Step 1: No paper outline found" << std::endl;
+            return target_object;
+        }
+        for (int i = 0; i < 4; i++) {
+            target_object.corner_points_[i].x = cvRound(corners[i].x);
+            target_object.corner_points_[i].y = cvRound(corners[i].y);
+        }
+        if (cancel_.StopRequested()) {
+            std::cout << "Stopped: corners only" << std::endl;
+            target_object.partial_ = true;
+            return target_object;
+        }
+
+        // Step 2: Homography straight from the four corners, then warp
+        std::cout << "Step 2: Warp" << std::endl;
+        TraceScope trace_warp("warp");
+        Mat h_scene_to_obj = getPerspectiveTransform(corners, template_corners_);
+        warpPerspective(image_scene, target_object.image_, h_scene_to_obj, image_object_.size());
+        color_transfer_.Apply(target_object.image_, target_object.image_);
+        std::cout << "Step 2: Compute time is  " << trace_warp.End() << " s" << std::endl;
+        if (display_images_) {
+            imshow("align", target_object.image_);
+        }
+        if (debug_sink_ != nullptr) {
+            std::string label = scene_source_.name();
+            label = label.substr(label.find_last_of('/') + 1);
+            debug_sink_->Submit(label.substr(0, label.find_last_of('.')), "align", target_object.image_);
+        }
+
+        // Step 3: Score the alignment of scene's target to template target
+        std::cout << "Step 3: Score the alignment of scene's target and template target" << std::endl;
+        TraceScope trace_ssim("ssim");
+        Scalar results = ssim_engine_->Score(target_object.image_, nullptr, &cancel_);
+        if (cancel_.StopRequested()) {
+            std::cout << "Stopped: no score" << std::endl;
+            target_object.partial_ = true;
+            return target_object;
+        }
+        target_object.score_ = ((results.val[0] + results.val[1] + results.val[2]) / 3) * 100;
+        std::cout << "Step 3: Compute time is  " << trace_ssim.End() << " s" << std::endl;
+
+        std::cout << "Total : Summary compute time is  " << trace_total.End() << " s" << std::endl;
+        std::cout << "Image Similarity: " << target_object.score_ << std::endl;
+        return target_object;
+    }
+
+    //================================================
+    // Member Function: FindQuad
+    //================================================
+    bool ContourStrategy::FindQuad(const Mat &scene, std::vector<Point2f> &corners) const {
+
+        if (scene.empty() || scene.type() != CV_8UC3) {
+            return false;
+        }
+
+        // Step 1a: Reduced copy of the brightest channel
+        double scale = std::min(1.0, static_cast<double>(std::max(config_.quad_max_side, 64)) /
+                                     std::max(scene.cols, scene.rows));
+        Mat reduced = scene;
+        if (scale < 1.0) {
+            resize(scene, reduced, Size(), scale, scale, INTER_AREA);
+        }
+        Mat value;
+        BrightestChannel(reduced, value);
+
+        // Step 1b: Blank paper with the closing of ProcessImage, kernel scaled along
+        Size ksize = Morphology::IteratedKernelSize(Size(5, 5), 10);
+        ksize.width = std::max(3, cvRound(ksize.width * scale) | 1);
+        ksize.height = std::max(3, cvRound(ksize.height * scale) | 1);
+        Mat blank;
+        Morphology::CloseRect(value, blank, ksize);
+
+        // Step 1c: Edges, thickened so the outline closes
+        GaussianBlur(blank, blank, Size(5, 5), 0);
+        Mat edges;
+        Canny(blank, edges, 0, 200);
+        dilate(edges, edges, getStructuringElement(MORPH_RECT, Size(3, 3)));
+
+        // Step 1d: The outermost contours, largest first; the print inside the paper is
+        // never an outer contour
+        std::vector<std::vector<Point>> contours;
+        findContours(edges, contours, RETR_EXTERNAL, CHAIN_APPROX_SIMPLE);
+        std::vector<double> areas(contours.size());
+        std::vector<size_t> order(contours.size());
+        for (size_t i = 0; i < contours.size(); i++) {
+            areas[i] = contourArea(contours[i]);
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&areas](size_t a, size_t b) { return areas[a] > areas[b]; });
+
+        // Step 1e: Polygon approximation of the hull, coarser until it is a quad
+        const double min_area = config_.quad_min_area * reduced.total();
+        const Rect inner(2, 2, reduced.cols - 4, reduced.rows - 4);
+        std::vector<Point> hull;
+        std::vector<Point> polygon;
+        for (size_t i = 0; i < std::min<size_t>(order.size(), 5); i++) {
+            convexHull(contours[order[i]], hull);
+            if (contourArea(hull) < min_area) {
+                continue;
+            }
+            double perimeter = arcLength(hull, true);
+            for (int step = 1; step <= 5; step++) {
+                approxPolyDP(hull, polygon, 0.02 * step * perimeter, true);
+                if (polygon.size() <= 4) {
+                    break;
+                }
+            }
+            if (polygon.size() != 4 || contourArea(polygon) < min_area) {
+                continue;
+            }
+
+            // A paper cut off by the frame has part of the scene border for an edge
+            bool inside = std::all_of(polygon.begin(), polygon.end(), [&inner](const Point &p) {
+                return inner.contains(p);
+            });
+            if (!inside) {
+                continue;
+            }
+
+            // Step 1f: Back to full resolution, pixel centers aligned
+            std::vector<Point2f> points;
+            for (const Point &p : polygon) {
+                points.emplace_back(static_cast<float>((p.x + 0.5) / scale - 0.5),
+                                    static_cast<float>((p.y + 0.5) / scale - 0.5));
+            }
+            corners = OpencvAlgo::OrderCorners(points);
+            RefineCorners(scene, corners, std::max(3, cvCeil(2.0 / scale)));
+            return true;
+        }
+        return false;
+    }
+
+    //================================================
+    // Member Function: PrepareTemplate
+    //================================================
+    bool ContourStrategy::PrepareTemplate() {
+
+        // A library routes the next scene to another pack
+        if (template_prepared_ && (template_pack_ == nullptr || image_object_.data == template_pack_->image().data)) {
+            return true;
+        }
+
+        SsimOptions ssim_options;
+        ssim_options.scale = config_.ssim_scale;
+        ssim_options.grayscale = config_.ssim_grayscale;
+        if (template_pack_ != nullptr) {
+            image_object_ = template_pack_->image();
+            template_corners_ = template_pack_->corners();
+            color_transfer_ = template_pack_->color_transfer();
+            ssim_engine_ = template_pack_->GetSsimEngine(ssim_options);
+        } else {
+            image_object_ = target_source_.Decode();
+            if (image_object_.empty()) {
+                std::cout << "Unable to read template image " << target_source_.name() << std::endl;
+                return false;
+            }
+            float width = static_cast<float>(image_object_.cols);
+            float height = static_cast<float>(image_object_.rows);
+            template_corners_ = {Point2f(0, 0), Point2f(width, 0), Point2f(width, height), Point2f(0, height)};
+            color_transfer_.SetReference(image_object_);
+            auto engine = std::make_shared<SsimEngine>(ssim_options);
+            engine->SetReference(image_object_);
+            ssim_engine_ = engine;
+        }
+        template_prepared_ = true;
+        return true;
+    }
+
+} // TactNib
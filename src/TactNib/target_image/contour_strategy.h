@@ -0,0 +1,59 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: contour_strategy.h
+ * Purpose:	  Concrete class for image finder algorithm. The purpose of this class is
+ *            to implement the strategy design pattern to allow various algorithms
+ *            to be used at runtime. This class will implement the "FindTarget" function
+ *            that will find the paper target by its outline, without features.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_CONTOUR_STRATEGY_H
+#define SYSTEM_API_CONTOUR_STRATEGY_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "color_transfer.h"
+#include "finder_config.h"
+#include "ssim_engine.h"
+#include "target_finder_strategy.h"
+
+namespace TactNib {
+
+    // The document scanner approach of ProcessImage carried through: blank the paper,
+    // take its outline on a reduced copy, fit a quad and refine the corners at full
+    // resolution. Only works when all four paper edges are in the scene.
+    class ContourStrategy: public TargetFinderStrategy {
+        public:
+            ContourStrategy(std::string, std::string);
+
+            void SetConfig(const FinderConfig &config) { config_ = config; }
+
+            // Paper corners in scene pixels, ordered like TemplatePack::corners(). False
+            // when no quad covers quad_min_area or the quad runs into the scene border.
+            bool FindQuad(const cv::Mat &scene, std::vector<cv::Point2f> &corners) const;
+
+        private:
+        TargetObjectImage FindTarget() override;
+
+        // Template size, brightness reference and SSIM scorer, from the pack when set
+        bool PrepareTemplate();
+
+        FinderConfig config_;
+        bool template_prepared_ = false;
+        cv::Mat image_object_;
+        std::vector<cv::Point2f> template_corners_;
+        ColorTransfer color_transfer_;
+        std::shared_ptr<const SsimEngine> ssim_engine_;
+
+        protected:
+    };
+
+} // TactNib
+
+#endif //SYSTEM_API_CONTOUR_STRATEGY_H
@@ -0,0 +1,101 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: debug_sink.cc
+ * Purpose:	  Optional receiver for intermediate finder images (matches, dewarp,
+ *            overlay). Rendering, encoding and writing happen on a background
+ *            thread behind a bounded queue; when the queue is full the artifact
+ *            is dropped so the scoring pipeline never waits on a debug capture.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <iostream>
+#include <vector>
+#include <opencv2/imgcodecs.hpp>
+
+#include "debug_sink.h"
+
+namespace TactNib {
+
+    //================================================
+    // Default constructor
+    //================================================
+    DebugSink::DebugSink(DebugSinkOptions options) : options_(options), queue_(options.queue_depth)
+    {
+        written_ = 0;
+        dropped_ = 0;
+        writer_ = std::thread([this]() { WriterLoop(); });
+    }
+
+    //================================================
+    // Destructor
+    //  Note: Writes what is already queued before returning
+    //================================================
+    DebugSink::~DebugSink()
+    {
+        queue_.Close();
+        if (writer_.joinable()) {
+            writer_.join();
+        }
+        std::cout << "DebugSink: written " << written_ << ", dropped " << dropped_ << std::endl;
+    }
+
+    //================================================
+    // Member Function: Submit
+    //================================================
+    bool DebugSink::Submit(const std::string &label, const std::string &name, const cv::Mat &image)
+    {
+        Artifact artifact;
+        artifact.file_name = options_.output_dir + "/" + label + "_" + name + ".jpg";
+        artifact.image = image;
+        return Enqueue(std::move(artifact));
+    }
+
+    bool DebugSink::Submit(const std::string &label, const std::string &name, RenderFunction render)
+    {
+        Artifact artifact;
+        artifact.file_name = options_.output_dir + "/" + label + "_" + name + ".jpg";
+        artifact.render = std::move(render);
+        return Enqueue(std::move(artifact));
+    }
+
+    //================================================
+    // Member Function: Enqueue
+    //================================================
+    bool DebugSink::Enqueue(Artifact artifact)
+    {
+        if (!queue_.TryPush(std::move(artifact))) {
+            dropped_++;
+            return false;
+        }
+        return true;
+    }
+
+    //================================================
+    // Member Function: WriterLoop
+    //================================================
+    void DebugSink::WriterLoop()
+    {
+        std::vector<int> params = {cv::IMWRITE_JPEG_QUALITY, options_.jpeg_quality};
+        Artifact artifact;
+        while (queue_.Pop(artifact)) {
+            try {
+                cv::Mat image = artifact.render ? artifact.render() : artifact.image;
+                if (!image.empty() && cv::imwrite(artifact.file_name, image, params)) {
+                    written_++;
+                } else {
+                    std::cout << "DebugSink: unable to write " << artifact.file_name << std::endl;
+                }
+            } catch (const cv::Exception &e) {
+                std::cout << "DebugSink: " << artifact.file_name << " failed: " << e.what() << std::endl;
+            }
+
+            // Release the shared images before waiting for the next artifact
+            artifact = Artifact();
+        }
+    }
+
+} // TactNib
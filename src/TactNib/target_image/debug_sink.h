@@ -0,0 +1,77 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: debug_sink.h
+ * Purpose:	  Optional receiver for intermediate finder images (matches, dewarp,
+ *            overlay). Rendering, encoding and writing happen on a background
+ *            thread behind a bounded queue; when the queue is full the artifact
+ *            is dropped so the scoring pipeline never waits on a debug capture.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_DEBUG_SINK_H
+#define SYSTEM_API_DEBUG_SINK_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <opencv2/core.hpp>
+#include "bounded_queue.h"
+
+namespace TactNib {
+
+    struct DebugSinkOptions
+    {
+        // Directory the images are written to; file names are <label>_<name>.jpg
+        std::string output_dir = ".";
+
+        // Artifacts allowed to wait for the writer; further artifacts are dropped
+        size_t queue_depth = 8;
+
+        int jpeg_quality = 90;
+    };
+
+    class DebugSink {
+        public:
+            // Builds the image on the writer thread, e.g. drawMatches or an overlay
+            using RenderFunction = std::function<cv::Mat()>;
+
+            explicit DebugSink(DebugSinkOptions options = DebugSinkOptions());
+            ~DebugSink();
+            DebugSink(const DebugSink &) = delete;
+            DebugSink &operator=(const DebugSink &) = delete;
+
+            // Never blocks; returns false when the artifact was dropped. The Mat is shared,
+            // not copied, so the caller must not write into it afterwards.
+            bool Submit(const std::string &label, const std::string &name, const cv::Mat &image);
+            bool Submit(const std::string &label, const std::string &name, RenderFunction render);
+
+            int64_t written() const { return written_; }
+            int64_t dropped() const { return dropped_; }
+
+        private:
+            struct Artifact
+            {
+                std::string file_name;
+                cv::Mat image;
+                RenderFunction render;
+            };
+
+            bool Enqueue(Artifact artifact);
+            void WriterLoop();
+
+            DebugSinkOptions options_;
+            BoundedQueue<Artifact> queue_;
+            std::atomic<int64_t> written_;
+            std::atomic<int64_t> dropped_;
+            std::thread writer_;
+    };
+
+} // TactNib
+
+#endif //SYSTEM_API_DEBUG_SINK_H
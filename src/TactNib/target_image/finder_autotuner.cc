@@ -0,0 +1,175 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: finder_autotuner.cc
+ * Purpose:	  Offline tuning of the OpenCV target finder on the machine it will
+ *            run on. Every candidate configuration scores the same sample scenes;
+ *            the fastest one whose worst score still meets the required score wins.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <algorithm>
+#include <iostream>
+#include <opencv2/imgcodecs.hpp>
+
+#include "finder_autotuner.h"
+#include "opencv_strategy.h"
+#include "trace.h"
+
+namespace TactNib {
+
+    //================================================
+    // Default constructor
+    //================================================
+    FinderAutotuner::FinderAutotuner(std::string template_file, FinderConfig base)
+    {
+        template_file_ = template_file;
+        base_ = base;
+    }
+
+    //================================================
+    // Member Function: AddSampleScene
+    //  Note: Scenes are decoded once so decoding is not part of any candidate's time
+    //================================================
+    bool FinderAutotuner::AddSampleScene(const std::string &scene_file)
+    {
+        cv::Mat scene = cv::imread(scene_file, cv::IMREAD_COLOR);
+        if (scene.empty()) {
+            std::cout << "FinderAutotuner: unable to read scene image " << scene_file << std::endl;
+            return false;
+        }
+        scenes_.push_back(scene);
+        return true;
+    }
+
+    //================================================
+    // Member Function: Candidates
+    //================================================
+    std::vector<FinderConfig> FinderAutotuner::Candidates() const
+    {
+        const FeatureDetectorType detectors[] = {FeatureDetectorType::Detect_FAST, FeatureDetectorType::Detect_SIFT,
+                                                 FeatureDetectorType::Detect_ORB};
+        const FeatureExtractType extractors[] = {FeatureExtractType::Extract_SIFT, FeatureExtractType::Extract_ORB};
+        const MatchType matchers[] = {MatchType::Match_FLANN, MatchType::Match_BRUTEFORCE,
+                                      MatchType::Match_HAMMING, MatchType::Match_ROOTSIFT};
+        const FilterType filters[] = {FilterType::Filter_LOWES, FilterType::Filter_SCORE};
+
+        // FAST has no descriptor extractor, so Extract_FAST is never a candidate, and the
+        // Hamming matcher only takes binary descriptors, the RootSIFT matcher only SIFT ones
+        std::vector<FinderConfig> candidates;
+        for (FeatureDetectorType detector_type : detectors) {
+            for (FeatureExtractType extract_type : extractors) {
+                for (MatchType match_type : matchers) {
+                    if ((match_type == MatchType::Match_HAMMING && extract_type == FeatureExtractType::Extract_SIFT) ||
+                        !MatcherSupports(match_type, extract_type)) {
+                        continue;
+                    }
+                    for (FilterType filter_type : filters) {
+                        for (bool ecc_refine : {false, true}) {
+                            FinderConfig config = base_;
+                            config.detector_type = detector_type;
+                            config.extract_type = extract_type;
+                            config.match_type = match_type;
+                            config.filter_type = filter_type;
+                            config.ecc_refine = ecc_refine;
+                            candidates.push_back(config);
+                        }
+                    }
+                }
+            }
+        }
+        return candidates;
+    }
+
+    //================================================
+    // Member Function: Run
+    //================================================
+    std::vector<AutotuneResult> FinderAutotuner::Run(double required_score) const
+    {
+        std::vector<AutotuneResult> results;
+        for (const FinderConfig &config : Candidates()) {
+            results.push_back(Evaluate(config, required_score));
+        }
+        return results;
+    }
+
+    //================================================
+    // Member Function: Evaluate
+    //================================================
+    AutotuneResult FinderAutotuner::Evaluate(const FinderConfig &config, double required_score) const
+    {
+        AutotuneResult result;
+        result.config = config;
+        result.scenes = static_cast<int>(scenes_.size());
+        if (scenes_.empty()) {
+            return result;
+        }
+
+        OpenCvStrategy strategy(std::string(), template_file_);
+        strategy.SetConfig(config);
+        strategy.SetDisplayImages(false);
+        try {
+            if (!strategy.PrepareTemplate()) {
+                return result;
+            }
+        } catch (const cv::Exception &e) {
+            std::cout << "FinderAutotuner: template failed: " << e.what() << std::endl;
+            return result;
+        }
+
+        double total_seconds = 0.0;
+        double total_score = 0.0;
+        result.min_score = 100.0;
+        for (const cv::Mat &scene : scenes_) {
+            SceneContext context;
+            context.image_scene = scene;
+            TraceScope trace("autotune_scene");
+            try {
+                strategy.PrepareScene(context);
+                strategy.DetectFeatures(context);
+                strategy.MatchFeatures(context);
+                strategy.EstimateHomography(context);
+                strategy.RefineAlignment(context);
+                strategy.WarpAndScore(context);
+            } catch (const cv::Exception &e) {
+                std::cout << "FinderAutotuner: scene failed: " << e.what() << std::endl;
+                context.valid = false;
+            }
+            total_seconds += trace.End();
+
+            double score = context.valid ? context.score : 0.0;
+            if (context.valid) {
+                result.located++;
+            }
+            total_score += score;
+            result.min_score = std::min(result.min_score, score);
+        }
+
+        result.mean_seconds = total_seconds / result.scenes;
+        result.mean_score = total_score / result.scenes;
+        result.meets_score = result.located == result.scenes && result.min_score >= required_score;
+        return result;
+    }
+
+    //================================================
+    // Member Function: SelectFastest
+    //================================================
+    bool FinderAutotuner::SelectFastest(const std::vector<AutotuneResult> &results, FinderConfig &best)
+    {
+        const AutotuneResult *fastest = nullptr;
+        for (const AutotuneResult &result : results) {
+            if (result.meets_score && (fastest == nullptr || result.mean_seconds < fastest->mean_seconds)) {
+                fastest = &result;
+            }
+        }
+        if (fastest == nullptr) {
+            return false;
+        }
+        best = fastest->config;
+        return true;
+    }
+
+} // TactNib
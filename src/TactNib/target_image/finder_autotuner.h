@@ -0,0 +1,61 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: finder_autotuner.h
+ * Purpose:	  Offline tuning of the OpenCV target finder on the machine it will
+ *            run on. Every candidate configuration scores the same sample scenes;
+ *            the fastest one whose worst score still meets the required score wins.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_FINDER_AUTOTUNER_H
+#define SYSTEM_API_FINDER_AUTOTUNER_H
+
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "finder_config.h"
+
+namespace TactNib {
+
+    struct AutotuneResult
+    {
+        FinderConfig config;
+        int scenes = 0;
+        int located = 0;
+        double min_score = 0.0;
+        double mean_score = 0.0;
+        double mean_seconds = 0.0;  // per scene, template analysis excluded
+        bool meets_score = false;   // every scene located with at least the required score
+    };
+
+    class FinderAutotuner {
+        public:
+            // base supplies the thresholds; candidates vary the algorithms and ECC refinement
+            explicit FinderAutotuner(std::string template_file, FinderConfig base = FinderConfig());
+
+            bool AddSampleScene(const std::string &scene_file);
+
+            // Detector x extractor x matcher x filter, each with and without ECC refinement
+            std::vector<FinderConfig> Candidates() const;
+
+            // Run every candidate over the sample scenes
+            std::vector<AutotuneResult> Run(double required_score) const;
+
+            // Fastest result that meets the score; false when none does
+            static bool SelectFastest(const std::vector<AutotuneResult> &, FinderConfig &best);
+
+        private:
+            AutotuneResult Evaluate(const FinderConfig &, double required_score) const;
+
+            std::string template_file_;
+            FinderConfig base_;
+            std::vector<cv::Mat> scenes_;
+    };
+
+} // TactNib
+
+#endif //SYSTEM_API_FINDER_AUTOTUNER_H
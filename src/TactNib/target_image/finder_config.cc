@@ -0,0 +1,238 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: finder_config.cc
+ * Purpose:	  Reading and writing the OpenCV target finder configuration, one
+ *            file per template, so each board can carry its own tuned settings.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <iostream>
+#include <opencv2/core.hpp>
+
+#include "finder_config.h"
+
+namespace TactNib {
+
+    namespace {
+        // Leaves value alone when the key is missing
+        template<typename T>
+        void ReadValue(const cv::FileNode &node, T &value)
+        {
+            if (!node.empty()) {
+                node >> value;
+            }
+        }
+
+        void ReadValue(const cv::FileNode &node, bool &value)
+        {
+            if (!node.empty()) {
+                value = static_cast<int>(node) != 0;
+            }
+        }
+
+        // Enums are matched against ToString of every value
+        template<typename T, size_t N>
+        bool ReadEnum(const cv::FileNode &node, const T (&values)[N], T &value)
+        {
+            if (node.empty()) {
+                return true;
+            }
+            std::string name = static_cast<std::string>(node);
+            for (T candidate : values) {
+                if (name == ToString(candidate)) {
+                    value = candidate;
+                    return true;
+                }
+            }
+            std::cout << "FinderConfig: unknown value " << name << " for " << node.name() << std::endl;
+            return false;
+        }
+    }
+
+    //================================================
+    // Function: LoadFinderConfig
+    //================================================
+    bool LoadFinderConfig(const std::string &config_file, FinderConfig &config)
+    {
+        cv::FileStorage storage;
+        try {
+            if (!storage.open(config_file, cv::FileStorage::READ)) {
+                std::cout << "FinderConfig: unable to open " << config_file << std::endl;
+                return false;
+            }
+        } catch (const cv::Exception &e) {
+            std::cout << "FinderConfig: unable to parse " << config_file << ": " << e.what() << std::endl;
+            return false;
+        }
+
+        const FeatureDetectorType detectors[] = {FeatureDetectorType::Detect_FAST, FeatureDetectorType::Detect_SIFT,
+                                                 FeatureDetectorType::Detect_ORB};
+        const FeatureExtractType extractors[] = {FeatureExtractType::Extract_FAST, FeatureExtractType::Extract_SIFT,
+                                                 FeatureExtractType::Extract_ORB};
+        const MatchType matchers[] = {MatchType::Match_FLANN, MatchType::Match_BRUTEFORCE,
+                                      MatchType::Match_HAMMING, MatchType::Match_ROOTSIFT};
+        const FilterType filters[] = {FilterType::Filter_LOWES, FilterType::Filter_SCORE};
+
+        // Parse into a copy so a bad file leaves config untouched
+        FinderConfig loaded = config;
+        bool valid = ReadEnum(storage["detector_type"], detectors, loaded.detector_type) &&
+                     ReadEnum(storage["extract_type"], extractors, loaded.extract_type) &&
+                     ReadEnum(storage["match_type"], matchers, loaded.match_type) &&
+                     ReadEnum(storage["filter_type"], filters, loaded.filter_type) &&
+                     ReadEnum(storage["cascade_detector_type"], detectors, loaded.cascade_detector_type) &&
+                     ReadEnum(storage["cascade_extract_type"], extractors, loaded.cascade_extract_type) &&
+                     ReadEnum(storage["cascade_match_type"], matchers, loaded.cascade_match_type) &&
+                     ReadEnum(storage["cascade_filter_type"], filters, loaded.cascade_filter_type);
+        if (!valid) {
+            return false;
+        }
+        if (!MatcherSupports(loaded.match_type, loaded.extract_type) ||
+            !MatcherSupports(loaded.cascade_match_type, loaded.cascade_extract_type)) {
+            std::cout << "FinderConfig: " << config_file << " pairs a matcher with descriptors it cannot match" << std::endl;
+            return false;
+        }
+
+        ReadValue(storage["max_features"], loaded.max_features);
+        ReadValue(storage["lowes_ratio"], loaded.lowes_ratio);
+        ReadValue(storage["good_match_percent"], loaded.good_match_percent);
+        ReadValue(storage["cross_check"], loaded.cross_check);
+        ReadValue(storage["rootsift_probes"], loaded.rootsift_probes);
+        ReadValue(storage["marker_top_margin"], loaded.marker_top_margin);
+        ReadValue(storage["marker_left_margin"], loaded.marker_left_margin);
+        ReadValue(storage["template_roi"], loaded.template_roi);
+        ReadValue(storage["scene_roi"], loaded.scene_roi);
+        ReadValue(storage["scene_roi_margin"], loaded.scene_roi_margin);
+        ReadValue(storage["brightness_scaled"], loaded.brightness_scaled);
+        ReadValue(storage["ssim_scale"], loaded.ssim_scale);
+        ReadValue(storage["ssim_grayscale"], loaded.ssim_grayscale);
+        ReadValue(storage["ecc_refine"], loaded.ecc_refine);
+        ReadValue(storage["ecc_levels"], loaded.ecc_levels);
+        ReadValue(storage["ecc_full_resolution"], loaded.ecc_full_resolution);
+        ReadValue(storage["detect_model"], loaded.detect_model);
+        ReadValue(storage["detect_model_int8"], loaded.detect_model_int8);
+        ReadValue(storage["detect_input_size"], loaded.detect_input_size);
+        ReadValue(storage["detect_score_threshold"], loaded.detect_score_threshold);
+        ReadValue(storage["detect_batch"], loaded.detect_batch);
+        ReadValue(storage["cascade_min_inliers"], loaded.cascade_min_inliers);
+        ReadValue(storage["cascade_min_inlier_ratio"], loaded.cascade_min_inlier_ratio);
+        ReadValue(storage["cascade_min_area"], loaded.cascade_min_area);
+        ReadValue(storage["cascade_max_side_ratio"], loaded.cascade_max_side_ratio);
+        ReadValue(storage["cascade_min_score"], loaded.cascade_min_score);
+        ReadValue(storage["quad_max_side"], loaded.quad_max_side);
+        ReadValue(storage["quad_min_area"], loaded.quad_min_area);
+
+        config = loaded;
+        return true;
+    }
+
+    //================================================
+    // Function: MatcherSupports
+    //================================================
+    bool MatcherSupports(MatchType match_type, FeatureExtractType extract_type)
+    {
+        return match_type != MatchType::Match_ROOTSIFT || extract_type == FeatureExtractType::Extract_SIFT;
+    }
+
+    //================================================
+    // Function: SaveFinderConfig
+    //================================================
+    bool SaveFinderConfig(const std::string &config_file, const FinderConfig &config)
+    {
+        cv::FileStorage storage;
+        try {
+            if (!storage.open(config_file, cv::FileStorage::WRITE)) {
+                std::cout << "FinderConfig: unable to create " << config_file << std::endl;
+                return false;
+            }
+        } catch (const cv::Exception &e) {
+            std::cout << "FinderConfig: unable to create " << config_file << ": " << e.what() << std::endl;
+            return false;
+        }
+
+        storage << "detector_type" << ToString(config.detector_type);
+        storage << "extract_type" << ToString(config.extract_type);
+        storage << "match_type" << ToString(config.match_type);
+        storage << "filter_type" << ToString(config.filter_type);
+        storage << "max_features" << config.max_features;
+        storage << "lowes_ratio" << config.lowes_ratio;
+        storage << "good_match_percent" << config.good_match_percent;
+        storage << "cross_check" << static_cast<int>(config.cross_check);
+        storage << "rootsift_probes" << config.rootsift_probes;
+        storage << "marker_top_margin" << config.marker_top_margin;
+        storage << "marker_left_margin" << config.marker_left_margin;
+        storage << "template_roi" << static_cast<int>(config.template_roi);
+        storage << "scene_roi" << static_cast<int>(config.scene_roi);
+        storage << "scene_roi_margin" << config.scene_roi_margin;
+        storage << "brightness_scaled" << static_cast<int>(config.brightness_scaled);
+        storage << "ssim_scale" << config.ssim_scale;
+        storage << "ssim_grayscale" << static_cast<int>(config.ssim_grayscale);
+        storage << "ecc_refine" << static_cast<int>(config.ecc_refine);
+        storage << "ecc_levels" << config.ecc_levels;
+        storage << "ecc_full_resolution" << static_cast<int>(config.ecc_full_resolution);
+        storage << "detect_model" << config.detect_model;
+        storage << "detect_model_int8" << config.detect_model_int8;
+        storage << "detect_input_size" << config.detect_input_size;
+        storage << "detect_score_threshold" << config.detect_score_threshold;
+        storage << "detect_batch" << config.detect_batch;
+        storage << "cascade_detector_type" << ToString(config.cascade_detector_type);
+        storage << "cascade_extract_type" << ToString(config.cascade_extract_type);
+        storage << "cascade_match_type" << ToString(config.cascade_match_type);
+        storage << "cascade_filter_type" << ToString(config.cascade_filter_type);
+        storage << "cascade_min_inliers" << config.cascade_min_inliers;
+        storage << "cascade_min_inlier_ratio" << config.cascade_min_inlier_ratio;
+        storage << "cascade_min_area" << config.cascade_min_area;
+        storage << "cascade_max_side_ratio" << config.cascade_max_side_ratio;
+        storage << "cascade_min_score" << config.cascade_min_score;
+        storage << "quad_max_side" << config.quad_max_side;
+        storage << "quad_min_area" << config.quad_min_area;
+        return true;
+    }
+
+    //================================================
+    // Function: ToString
+    //================================================
+    const char *ToString(FeatureDetectorType type)
+    {
+        switch (type) {
+            case FeatureDetectorType::Detect_FAST: return "FAST";
+            case FeatureDetectorType::Detect_SIFT: return "SIFT";
+            case FeatureDetectorType::Detect_ORB: return "ORB";
+        }
+        return "UNKNOWN";
+    }
+
+    const char *ToString(FeatureExtractType type)
+    {
+        switch (type) {
+            case FeatureExtractType::Extract_FAST: return "FAST";
+            case FeatureExtractType::Extract_SIFT: return "SIFT";
+            case FeatureExtractType::Extract_ORB: return "ORB";
+        }
+        return "UNKNOWN";
+    }
+
+    const char *ToString(MatchType type)
+    {
+        switch (type) {
+            case MatchType::Match_FLANN: return "FLANN";
+            case MatchType::Match_BRUTEFORCE: return "BRUTEFORCE";
+            case MatchType::Match_HAMMING: return "HAMMING";
+            case MatchType::Match_ROOTSIFT: return "ROOTSIFT";
+        }
+        return "UNKNOWN";
+    }
+
+    const char *ToString(FilterType type)
+    {
+        switch (type) {
+            case FilterType::Filter_LOWES: return "LOWES";
+            case FilterType::Filter_SCORE: return "SCORE";
+        }
+        return "UNKNOWN";
+    }
+
+} // TactNib
@@ -0,0 +1,127 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: finder_config.h
+ * Purpose:	  Enumerations and configuration shared by the OpenCV target finder,
+ *            the template pack, and the tools that build them.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_FINDER_CONFIG_H
+#define SYSTEM_API_FINDER_CONFIG_H
+
+#include <string>
+
+namespace TactNib {
+
+    // Enumerations used for the feature detection algorithm
+    enum class FeatureDetectorType
+    {
+        Detect_FAST, Detect_SIFT, Detect_ORB
+    };
+
+    enum class FeatureExtractType
+    {
+        Extract_FAST, Extract_SIFT, Extract_ORB
+    };
+
+    enum class MatchType
+    {
+        Match_FLANN, Match_BRUTEFORCE, Match_HAMMING, Match_ROOTSIFT
+    };
+
+    enum class FilterType
+    {
+        Filter_LOWES, Filter_SCORE
+    };
+
+    // Algorithm selection for the OpenCV target finder
+    struct FinderConfig
+    {
+        FeatureDetectorType detector_type = FeatureDetectorType::Detect_SIFT;
+        FeatureExtractType extract_type = FeatureExtractType::Extract_SIFT;
+        MatchType match_type = MatchType::Match_FLANN;
+        FilterType filter_type = FilterType::Filter_LOWES;
+
+        // Feature and match thresholds
+        int max_features = 500;             // ORB keypoint budget
+        double lowes_ratio = 0.55;          // Filter_LOWES ratio test
+        double good_match_percent = 0.15;   // Filter_SCORE keeps this share of the best matches
+        bool cross_check = false;           // Match_HAMMING keeps mutual nearest neighbours only
+        int rootsift_probes = 0;            // Match_ROOTSIFT index cells scanned per query, 0 = exact
+
+        // Step 6 keeps template matches on the location markers: the top and bottom bands
+        // of this height, minus the left part of the top band and right part of the bottom
+        double marker_top_margin = 0.14;
+        double marker_left_margin = 0.25;
+
+        // Detect template features only on the markers (stored with the template), and
+        // scene features only near the markers projected with the previous frame's
+        // homography, grown by scene_roi_margin pixels
+        bool template_roi = true;
+        bool scene_roi = true;
+        int scene_roi_margin = 48;
+
+        // Normalize the scene brightness after scaling it to the template instead of
+        // before; much cheaper when the scene is larger than the template
+        bool brightness_scaled = false;
+
+        // Alignment scoring resolution (1.0 = full) and color mode, see SsimOptions
+        double ssim_scale = 1.0;
+        bool ssim_grayscale = false;
+
+        // Refine the feature homography with pyramid ECC before the warp, see EccOptions.
+        // A refinement that does not beat the feature homography is discarded. The full
+        // resolution level is the most expensive and is off by default.
+        bool ecc_refine = false;
+        int ecc_levels = 3;
+        bool ecc_full_resolution = false;
+
+        // ObjectDetect strategy: oriented box model (ONNX) run on the CPU, see ObjectDetector.
+        // detect_model_int8 replaces detect_model when set and it loads.
+        std::string detect_model;
+        std::string detect_model_int8;
+        int detect_input_size = 640;
+        double detect_score_threshold = 0.25;
+        int detect_batch = 4;               // scenes per forward pass in ProcessScenes
+
+        // Cascade strategy: run the cascade_* algorithms first, and the ones at the top only
+        // when that result misses one of the thresholds below. Corners are sane when they
+        // form a convex quad of at least cascade_min_area of the scaled scene whose
+        // opposite sides differ by no more than cascade_max_side_ratio.
+        FeatureDetectorType cascade_detector_type = FeatureDetectorType::Detect_ORB;
+        FeatureExtractType cascade_extract_type = FeatureExtractType::Extract_ORB;
+        MatchType cascade_match_type = MatchType::Match_FLANN;
+        FilterType cascade_filter_type = FilterType::Filter_SCORE;
+        int cascade_min_inliers = 20;
+        double cascade_min_inlier_ratio = 0.3;     // of the matches left after Step 6
+        double cascade_min_area = 0.1;
+        double cascade_max_side_ratio = 2.0;
+        double cascade_min_score = 60.0;
+
+        // ContourQuad strategy: the paper outline is searched on a copy whose longer side
+        // is quad_max_side pixels and must cover quad_min_area of it
+        int quad_max_side = 640;
+        double quad_min_area = 0.2;
+    };
+
+    // Config files are OpenCV FileStorage (YAML, JSON or XML by extension); enums are
+    // stored by name, e.g. "SIFT", and keys missing from the file keep their defaults
+    bool LoadFinderConfig(const std::string &config_file, FinderConfig &config);
+    bool SaveFinderConfig(const std::string &config_file, const FinderConfig &config);
+
+    // False for a matcher that cannot read the extractor's descriptors:
+    // Match_ROOTSIFT only takes SIFT
+    bool MatcherSupports(MatchType match_type, FeatureExtractType extract_type);
+
+    const char *ToString(FeatureDetectorType);
+    const char *ToString(FeatureExtractType);
+    const char *ToString(MatchType);
+    const char *ToString(FilterType);
+
+} // TactNib
+
+#endif //SYSTEM_API_FINDER_CONFIG_H
@@ -0,0 +1,111 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: finder_workspace.cc
+ * Purpose:	  Per-thread working memory of the OpenCV target finder: the feature
+ *            detector, extractor and matcher built once for the configuration,
+ *            and image buffers reused from frame to frame, so a worker scoring
+ *            frames of the same size stops allocating after the first frames.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <algorithm>
+
+#include "finder_workspace.h"
+#include "opencv_algo.h"
+#include "template_pack.h"
+
+namespace TactNib {
+
+    //================================================
+    // Member Function: Acquire
+    //================================================
+    cv::Mat MatPool::Acquire(cv::Size size, int type)
+    {
+        // The pool's own reference is the only one left when nobody uses the buffer;
+        // the count is read atomically since frames are released on other threads
+        for (cv::Mat &buffer : buffers_) {
+            if (buffer.u != nullptr && buffer.size() == size && buffer.type() == type &&
+                CV_XADD(&buffer.u->refcount, 0) == 1) {
+                return buffer;
+            }
+        }
+
+        cv::Mat buffer(size, type);
+        if (buffer.empty()) {
+            return buffer;
+        }
+        if (buffers_.size() < kMaxBuffers) {
+            buffers_.push_back(buffer);
+        } else {
+            // Replace a free buffer of another size, e.g. after the template changed
+            for (cv::Mat &pooled : buffers_) {
+                if (pooled.u != nullptr && CV_XADD(&pooled.u->refcount, 0) == 1) {
+                    pooled = buffer;
+                    break;
+                }
+            }
+        }
+        return buffer;
+    }
+
+    //================================================
+    // Member Function: ForThread
+    //================================================
+    FinderWorkspace &FinderWorkspace::ForThread(const FinderConfig &config)
+    {
+        // Pool workers, stream stages and the caller's thread each keep their own
+        thread_local FinderWorkspace workspace;
+        workspace.Configure(config);
+        return workspace;
+    }
+
+    //================================================
+    // Member Function: Configure
+    //================================================
+    void FinderWorkspace::Configure(const FinderConfig &config)
+    {
+        auto same = [&config](const Algorithms &algorithms) {
+            return config.detector_type == algorithms.config.detector_type &&
+                   config.extract_type == algorithms.config.extract_type &&
+                   config.match_type == algorithms.config.match_type &&
+                   config.max_features == algorithms.config.max_features;
+        };
+        auto found = std::find_if(algorithms_.begin(), algorithms_.end(), same);
+        if (found != algorithms_.end()) {
+            std::rotate(algorithms_.begin(), found, found + 1);
+            return;
+        }
+
+        Algorithms algorithms;
+        algorithms.detector = OpencvAlgo::CreateFeatureDetector(config.detector_type, config.max_features);
+        algorithms.extractor = OpencvAlgo::CreateFeatureExtractor(config.extract_type, config.max_features);
+        algorithms.matcher = OpencvAlgo::CreateDescriptorMatcher(config.match_type, config.extract_type);
+        algorithms.config = config;
+        algorithms_.insert(algorithms_.begin(), std::move(algorithms));
+        if (algorithms_.size() > kMaxAlgorithms) {
+            algorithms_.pop_back();
+        }
+    }
+
+    //================================================
+    // Member Function: TemplateMatcher
+    //================================================
+    cv::DescriptorMatcher &FinderWorkspace::TemplateMatcher(const std::shared_ptr<const TemplatePack> &pack)
+    {
+        // lock() is empty once the trained template is gone, so a new pack at the same
+        // address is never mistaken for it
+        Algorithms &algorithms = algorithms_.front();
+        if (algorithms.indexed_template.lock() != pack) {
+            algorithms.matcher->clear();
+            algorithms.matcher->add(std::vector<cv::Mat>{pack->descriptors()});
+            algorithms.matcher->train();
+            algorithms.indexed_template = pack;
+        }
+        return *algorithms.matcher;
+    }
+
+} // TactNib
@@ -0,0 +1,101 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: finder_workspace.h
+ * Purpose:	  Per-thread working memory of the OpenCV target finder: the feature
+ *            detector, extractor and matcher built once for the configuration,
+ *            and image buffers reused from frame to frame, so a worker scoring
+ *            frames of the same size stops allocating after the first frames.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_FINDER_WORKSPACE_H
+#define SYSTEM_API_FINDER_WORKSPACE_H
+
+#include <memory>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+#include "finder_config.h"
+#include "ssim_engine.h"
+
+namespace TactNib {
+
+    class TemplatePack;
+
+    // Buffers handed out to SceneContext. A buffer is handed out again only once no Mat
+    // refers to it any more, so a frame still queued for a later stage, or a result
+    // the caller kept, is never overwritten.
+    class MatPool {
+        public:
+            cv::Mat Acquire(cv::Size size, int type);
+            size_t size() const { return buffers_.size(); }
+
+        private:
+            // Frames in flight in a stream never exceed a few queue depths
+            static const size_t kMaxBuffers = 8;
+
+            std::vector<cv::Mat> buffers_;
+    };
+
+    class FinderWorkspace {
+        public:
+            // The calling thread's workspace, with algorithms for config. The pools and
+            // buffers survive configuration changes, and the algorithms of the previous
+            // configuration are kept, so alternating between two costs nothing.
+            static FinderWorkspace &ForThread(const FinderConfig &config);
+
+            FinderWorkspace() = default;
+            FinderWorkspace(const FinderWorkspace &) = delete;
+            FinderWorkspace &operator=(const FinderWorkspace &) = delete;
+
+            // Rebuild the detector, extractor and matcher when config selects other ones
+            void Configure(const FinderConfig &config);
+
+            cv::Feature2D &detector() { return *algorithms_.front().detector; }
+            cv::Feature2D &extractor() { return *algorithms_.front().extractor; }
+            cv::DescriptorMatcher &matcher() { return *algorithms_.front().matcher; }
+
+            // The matcher trained on the template's descriptors, for matching scene
+            // descriptors as queries. The index is built on the first call for a template
+            // and kept until another template or configuration comes along.
+            cv::DescriptorMatcher &TemplateMatcher(const std::shared_ptr<const TemplatePack> &pack);
+
+            // Scene scaled to the template and dewarped scene; these travel with the frame
+            MatPool &scene_pool() { return scene_pool_; }
+            MatPool &dewarp_pool() { return dewarp_pool_; }
+
+            // Temporaries of a single stage call
+            cv::Mat &brightness_buffer() { return brightness_buffer_; }
+            cv::Mat &mask_buffer() { return mask_buffer_; }
+            SsimScratch &ssim_scratch() { return ssim_scratch_; }
+
+        private:
+            struct Algorithms
+            {
+                FinderConfig config;
+                cv::Ptr<cv::Feature2D> detector;
+                cv::Ptr<cv::Feature2D> extractor;
+                cv::Ptr<cv::DescriptorMatcher> matcher;
+                std::weak_ptr<const TemplatePack> indexed_template;     // what matcher was trained on
+            };
+
+            // The cascade strategy switches between two configurations per frame
+            static const size_t kMaxAlgorithms = 2;
+
+            // Most recently configured first
+            std::vector<Algorithms> algorithms_;
+
+            MatPool scene_pool_;
+            MatPool dewarp_pool_;
+            cv::Mat brightness_buffer_;
+            cv::Mat mask_buffer_;
+            SsimScratch ssim_scratch_;
+    };
+
+} // TactNib
+
+#endif //SYSTEM_API_FINDER_WORKSPACE_H
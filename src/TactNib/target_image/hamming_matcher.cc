@@ -0,0 +1,244 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: hamming_matcher.cc
+ * Purpose:	  Brute force matcher for binary descriptors (ORB). Distances are
+ *            computed with vector popcount kernels over cache sized tiles of
+ *            descriptors on all cores, keeping the two nearest neighbours so
+ *            the ORB paths can use Lowe's ratio test.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include "hamming_matcher.h"
+#include "simd_support.h"
+
+using namespace cv;
+
+namespace TactNib {
+
+    struct HammingMatcher::Nearest
+    {
+        int distance[2] = {INT_MAX, INT_MAX};
+        int index[2] = {-1, -1};
+    };
+
+    namespace {
+        // Query rows per task and train rows per tile. A tile of 256 ORB descriptors is
+        // 8 KB and stays in L1 while every query of the task is compared against it.
+        const int kQueryTile = 32;
+        const int kTrainTile = 256;
+
+        bool ValidDescriptors(const Mat &query, const Mat &train)
+        {
+            if (query.type() != CV_8U || train.type() != CV_8U || query.cols != train.cols) {
+                std::cout << "HammingMatcher: descriptors must be CV_8U rows of equal width" << std::endl;
+                return false;
+            }
+            return true;
+        }
+    }
+
+    //================================================
+    // Default constructor
+    //================================================
+    HammingMatcher::HammingMatcher(HammingMatchOptions options)
+    {
+        options_ = options;
+    }
+
+    //================================================
+    // Member Function: Distance
+    //  Note: AVX2 counts bits with a nibble lookup (vpshufb) summed by vpsadbw,
+    //        baseline SSE2 with in-register bit sums and psadbw, NEON with vcnt; the
+    //        rest 64 bits at a time
+    //================================================
+    int HammingMatcher::Distance(const uchar *a, const uchar *b, int width)
+    {
+        int distance = 0;
+        int i = 0;
+#if defined(TACTNIB_SIMD_AVX2)
+        if (width >= 32) {
+            const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+            const __m256i low_nibble = _mm256_set1_epi8(0x0f);
+            const __m256i zero = _mm256_setzero_si256();
+            __m256i sums = zero;
+            for (; i + 32 <= width; i += 32) {
+                __m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i)),
+                                             _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i)));
+                __m256i low = _mm256_shuffle_epi8(lut, _mm256_and_si256(x, low_nibble));
+                __m256i high = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(x, 4), low_nibble));
+                sums = _mm256_add_epi64(sums, _mm256_sad_epu8(_mm256_add_epi8(low, high), zero));
+            }
+            __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+            half = _mm_add_epi64(half, _mm_unpackhi_epi64(half, half));
+            distance = static_cast<int>(_mm_cvtsi128_si64(half));
+        }
+#elif defined(TACTNIB_SIMD_SSE2)
+        if (width >= 16) {
+            // No byte shuffle before SSSE3: bits are summed in place in pairs, nibbles,
+            // then bytes; 16 bit shifts are fine since the masks drop the carried bits
+            const __m128i pairs = _mm_set1_epi8(0x55);
+            const __m128i nibbles = _mm_set1_epi8(0x33);
+            const __m128i low_nibble = _mm_set1_epi8(0x0f);
+            const __m128i zero = _mm_setzero_si128();
+            __m128i sums = zero;
+            for (; i + 16 <= width; i += 16) {
+                __m128i x = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)),
+                                          _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+                x = _mm_sub_epi8(x, _mm_and_si128(_mm_srli_epi16(x, 1), pairs));
+                x = _mm_add_epi8(_mm_and_si128(x, nibbles), _mm_and_si128(_mm_srli_epi16(x, 2), nibbles));
+                x = _mm_and_si128(_mm_add_epi8(x, _mm_srli_epi16(x, 4)), low_nibble);
+                sums = _mm_add_epi64(sums, _mm_sad_epu8(x, zero));
+            }
+            sums = _mm_add_epi64(sums, _mm_unpackhi_epi64(sums, sums));
+            distance = static_cast<int>(_mm_cvtsi128_si64(sums));
+        }
+#elif defined(TACTNIB_SIMD_NEON)
+        if (width >= 16) {
+            uint16x8_t sums = vdupq_n_u16(0);
+            for (; i + 16 <= width; i += 16) {
+                sums = vpadalq_u8(sums, vcntq_u8(veorq_u8(vld1q_u8(a + i), vld1q_u8(b + i))));
+            }
+            distance = static_cast<int>(vaddvq_u16(sums));
+        }
+#endif
+        for (; i + 8 <= width; i += 8) {
+            uint64_t x;
+            uint64_t y;
+            std::memcpy(&x, a + i, sizeof(x));
+            std::memcpy(&y, b + i, sizeof(y));
+            distance += __builtin_popcountll(x ^ y);
+        }
+        for (; i < width; i++) {
+            distance += __builtin_popcount(static_cast<unsigned int>(a[i] ^ b[i]));
+        }
+        return distance;
+    }
+
+    //================================================
+    // Member Function: FindNearest
+    //================================================
+    void HammingMatcher::FindNearest(const Mat &query, const Mat &train, std::vector<Nearest> &nearest) const
+    {
+        nearest.assign(query.rows, Nearest());
+        const int width = query.cols;
+        const int query_tiles = (query.rows + kQueryTile - 1) / kQueryTile;
+
+        // Tasks own disjoint query rows, so nothing is shared between threads
+        parallel_for_(Range(0, query_tiles), [&](const Range &range) {
+            for (int tile = range.start; tile < range.end; tile++) {
+                if (options_.cancel.StopRequested()) {
+                    return;
+                }
+                const int q0 = tile * kQueryTile;
+                const int q1 = std::min(q0 + kQueryTile, query.rows);
+                for (int t0 = 0; t0 < train.rows; t0 += kTrainTile) {
+                    const int t1 = std::min(t0 + kTrainTile, train.rows);
+                    for (int q = q0; q < q1; q++) {
+                        const uchar *descriptor = query.ptr<uchar>(q);
+                        Nearest &best = nearest[q];
+                        for (int t = t0; t < t1; t++) {
+                            int distance = Distance(descriptor, train.ptr<uchar>(t), width);
+                            if (distance >= best.distance[1]) {
+                                continue;
+                            }
+                            if (distance < best.distance[0]) {
+                                best.distance[1] = best.distance[0];
+                                best.index[1] = best.index[0];
+                                best.distance[0] = distance;
+                                best.index[0] = t;
+                            } else {
+                                best.distance[1] = distance;
+                                best.index[1] = t;
+                            }
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    //================================================
+    // Member Function: NearestQueries
+    //  Note: For cross checking, the nearest query row of every train row
+    //================================================
+    std::vector<int> HammingMatcher::NearestQueries(const Mat &query, const Mat &train) const
+    {
+        std::vector<Nearest> reverse;
+        FindNearest(train, query, reverse);
+        std::vector<int> nearest_query(reverse.size());
+        for (size_t t = 0; t < reverse.size(); t++) {
+            nearest_query[t] = reverse[t].index[0];
+        }
+        return nearest_query;
+    }
+
+    //================================================
+    // Member Function: Match
+    //================================================
+    void HammingMatcher::Match(const Mat &query, const Mat &train, std::vector<DMatch> &matches) const
+    {
+        matches.clear();
+        if (query.empty() || train.empty() || !ValidDescriptors(query, train)) {
+            return;
+        }
+
+        std::vector<Nearest> nearest;
+        FindNearest(query, train, nearest);
+        std::vector<int> nearest_query;
+        if (options_.cross_check) {
+            nearest_query = NearestQueries(query, train);
+        }
+
+        matches.reserve(nearest.size());
+        for (int q = 0; q < static_cast<int>(nearest.size()); q++) {
+            int t = nearest[q].index[0];
+            if (t < 0 || (options_.cross_check && nearest_query[t] != q)) {
+                continue;
+            }
+            matches.emplace_back(q, t, static_cast<float>(nearest[q].distance[0]));
+        }
+    }
+
+    //================================================
+    // Member Function: KnnMatch2
+    //================================================
+    void HammingMatcher::KnnMatch2(const Mat &query, const Mat &train,
+                                   std::vector<std::vector<DMatch>> &knn_matches) const
+    {
+        knn_matches.clear();
+        if (query.empty() || train.empty() || !ValidDescriptors(query, train)) {
+            return;
+        }
+
+        std::vector<Nearest> nearest;
+        FindNearest(query, train, nearest);
+        std::vector<int> nearest_query;
+        if (options_.cross_check) {
+            nearest_query = NearestQueries(query, train);
+        }
+
+        // One entry per query row, like cv::DescriptorMatcher::knnMatch
+        knn_matches.resize(nearest.size());
+        for (int q = 0; q < static_cast<int>(nearest.size()); q++) {
+            const Nearest &best = nearest[q];
+            if (best.index[0] < 0 || (options_.cross_check && nearest_query[best.index[0]] != q)) {
+                continue;
+            }
+            for (int k = 0; k < 2 && best.index[k] >= 0; k++) {
+                knn_matches[q].emplace_back(q, best.index[k], static_cast<float>(best.distance[k]));
+            }
+        }
+    }
+
+} // TactNib
@@ -0,0 +1,62 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: hamming_matcher.h
+ * Purpose:	  Brute force matcher for binary descriptors (ORB). Distances are
+ *            computed with vector popcount kernels over cache sized tiles of
+ *            descriptors on all cores, keeping the two nearest neighbours so
+ *            the ORB paths can use Lowe's ratio test.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_HAMMING_MATCHER_H
+#define SYSTEM_API_HAMMING_MATCHER_H
+
+#include <vector>
+#include <opencv2/core.hpp>
+#include "cancel_token.h"
+
+namespace TactNib {
+
+    struct HammingMatchOptions
+    {
+        // Keep a query's nearest neighbour only when the query is also the nearest
+        // neighbour of that train descriptor. Runs a second pass train -> query.
+        bool cross_check = false;
+
+        // Query tiles left when the token fires are not matched
+        CancelToken cancel;
+    };
+
+    // Descriptors are CV_8U rows of equal width, query and train as in cv::DescriptorMatcher.
+    // Ties keep the lower train index, so results do not depend on the thread count.
+    class HammingMatcher {
+        public:
+            explicit HammingMatcher(HammingMatchOptions options = HammingMatchOptions());
+
+            // Nearest train descriptor for every query descriptor
+            void Match(const cv::Mat &query, const cv::Mat &train, std::vector<cv::DMatch> &matches) const;
+
+            // The two nearest train descriptors for every query descriptor, nearest first;
+            // fewer when train has fewer rows or cross checking removed the query
+            void KnnMatch2(const cv::Mat &query, const cv::Mat &train,
+                           std::vector<std::vector<cv::DMatch>> &knn_matches) const;
+
+            // Hamming distance of two descriptors of width bytes
+            static int Distance(const uchar *a, const uchar *b, int width);
+
+        private:
+            struct Nearest;
+
+            void FindNearest(const cv::Mat &query, const cv::Mat &train, std::vector<Nearest> &nearest) const;
+            std::vector<int> NearestQueries(const cv::Mat &query, const cv::Mat &train) const;
+
+            HammingMatchOptions options_;
+    };
+
+} // TactNib
+
+#endif //SYSTEM_API_HAMMING_MATCHER_H
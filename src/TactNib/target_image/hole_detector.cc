@@ -0,0 +1,360 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: hole_detector.cc
+ * Purpose:	  Bullet hole detector for dark holes on light paper: one adaptive
+ *            threshold and one connected component pass that collects moments
+ *            while labeling, instead of SimpleBlobDetector's contour search at
+ *            many threshold levels. Row bands are labeled in parallel and joined
+ *            at their seams.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <opencv2/imgproc.hpp>
+
+#include "hole_detector.h"
+#include "simd_support.h"
+
+using namespace cv;
+
+namespace TactNib {
+
+    namespace {
+        // Rows labeled by one task; seams cost one row comparison each
+        const int kBandRows = 64;
+
+        // Moments and extents of one component, merged when labels are joined
+        struct BlobStats
+        {
+            int area = 0;
+            int64_t sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0, sum_yy = 0;
+            int min_x = INT_MAX, max_x = INT_MIN, min_y = INT_MAX, max_y = INT_MIN;
+            int min_sum = INT_MAX, max_sum = INT_MIN, min_diff = INT_MAX, max_diff = INT_MIN;
+
+            void Add(int x, int y)
+            {
+                area++;
+                sum_x += x;
+                sum_y += y;
+                sum_xx += static_cast<int64_t>(x) * x;
+                sum_xy += static_cast<int64_t>(x) * y;
+                sum_yy += static_cast<int64_t>(y) * y;
+                min_x = std::min(min_x, x);
+                max_x = std::max(max_x, x);
+                min_y = std::min(min_y, y);
+                max_y = std::max(max_y, y);
+                min_sum = std::min(min_sum, x + y);
+                max_sum = std::max(max_sum, x + y);
+                min_diff = std::min(min_diff, x - y);
+                max_diff = std::max(max_diff, x - y);
+            }
+
+            void Merge(const BlobStats &other)
+            {
+                area += other.area;
+                sum_x += other.sum_x;
+                sum_y += other.sum_y;
+                sum_xx += other.sum_xx;
+                sum_xy += other.sum_xy;
+                sum_yy += other.sum_yy;
+                min_x = std::min(min_x, other.min_x);
+                max_x = std::max(max_x, other.max_x);
+                min_y = std::min(min_y, other.min_y);
+                max_y = std::max(max_y, other.max_y);
+                min_sum = std::min(min_sum, other.min_sum);
+                max_sum = std::max(max_sum, other.max_sum);
+                min_diff = std::min(min_diff, other.min_diff);
+                max_diff = std::max(max_diff, other.max_diff);
+            }
+        };
+
+        // Labels of one band; label 0 is background
+        struct Band
+        {
+            int y0 = 0, y1 = 0;
+            std::vector<int> parent;
+            std::vector<BlobStats> stats;
+            std::vector<int> compact;       // label -> index among the band's components
+            int components = 0;
+        };
+
+        int FindRoot(std::vector<int> &parent, int label)
+        {
+            while (parent[label] != label) {
+                parent[label] = parent[parent[label]];
+                label = parent[label];
+            }
+            return label;
+        }
+
+        // The lower label becomes the root, so a root never follows its members
+        int Union(std::vector<int> &parent, int a, int b)
+        {
+            a = FindRoot(parent, a);
+            b = FindRoot(parent, b);
+            if (a < b) {
+                parent[b] = a;
+                return a;
+            }
+            parent[a] = b;
+            return b;
+        }
+
+        //================================================
+        // Function: ThresholdRow
+        //  Note: mask = gray < mean - offset, saturating so a dark window never
+        //        marks anything
+        //================================================
+        void ThresholdRow(const uchar *gray, const uchar *mean, uchar *mask, int width, uchar offset)
+        {
+            int x = 0;
+#if defined(TACTNIB_SIMD_AVX2)
+            const __m256i level_offset = _mm256_set1_epi8(static_cast<char>(offset));
+            const __m256i zero = _mm256_setzero_si256();
+            const __m256i ones = _mm256_set1_epi8(-1);
+            for (; x + 32 <= width; x += 32) {
+                __m256i level = _mm256_subs_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(mean + x)),
+                                                 level_offset);
+                __m256i below = _mm256_subs_epu8(level, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(gray + x)));
+                __m256i hole = _mm256_xor_si256(_mm256_cmpeq_epi8(below, zero), ones);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(mask + x), hole);
+            }
+#elif defined(TACTNIB_SIMD_SSE2)
+            const __m128i level_offset = _mm_set1_epi8(static_cast<char>(offset));
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i ones = _mm_set1_epi8(-1);
+            for (; x + 16 <= width; x += 16) {
+                __m128i level = _mm_subs_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(mean + x)), level_offset);
+                __m128i below = _mm_subs_epu8(level, _mm_loadu_si128(reinterpret_cast<const __m128i *>(gray + x)));
+                __m128i hole = _mm_xor_si128(_mm_cmpeq_epi8(below, zero), ones);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(mask + x), hole);
+            }
+#elif defined(TACTNIB_SIMD_NEON)
+            const uint8x16_t level_offset = vdupq_n_u8(offset);
+            for (; x + 16 <= width; x += 16) {
+                uint8x16_t level = vqsubq_u8(vld1q_u8(mean + x), level_offset);
+                vst1q_u8(mask + x, vcltq_u8(vld1q_u8(gray + x), level));
+            }
+#endif
+            for (; x < width; x++) {
+                int level = std::max(mean[x] - offset, 0);
+                mask[x] = gray[x] < level ? 255 : 0;
+            }
+        }
+
+        //================================================
+        // Function: LabelBand
+        //  Note: 8-connected labeling of rows [y0, y1). Each pixel takes the label of
+        //        its left and upper neighbours, joining them when they differ, and
+        //        adds itself to that label's moments.
+        //================================================
+        void LabelBand(const Mat &mask, Mat &labels, Band &band)
+        {
+            const int cols = mask.cols;
+            band.parent.assign(1, 0);
+            band.stats.assign(1, BlobStats());
+            for (int y = band.y0; y < band.y1; y++) {
+                const uchar *row = mask.ptr<uchar>(y);
+                int *label_row = labels.ptr<int>(y);
+                const int *up = y > band.y0 ? labels.ptr<int>(y - 1) : nullptr;
+                for (int x = 0; x < cols; x++) {
+                    if (!row[x]) {
+                        label_row[x] = 0;
+                        continue;
+                    }
+                    int label = 0;
+                    auto join = [&](int neighbour) {
+                        if (neighbour != 0) {
+                            label = label != 0 ? Union(band.parent, label, neighbour) : neighbour;
+                        }
+                    };
+                    if (x > 0) {
+                        join(label_row[x - 1]);
+                    }
+                    if (up != nullptr) {
+                        if (x > 0) {
+                            join(up[x - 1]);
+                        }
+                        join(up[x]);
+                        if (x + 1 < cols) {
+                            join(up[x + 1]);
+                        }
+                    }
+                    if (label == 0) {
+                        label = static_cast<int>(band.parent.size());
+                        band.parent.push_back(label);
+                        band.stats.emplace_back();
+                    }
+                    label_row[x] = label;
+                    band.stats[label].Add(x, y);
+                }
+            }
+
+            // Fold every label into its root; roots come before their members
+            band.compact.assign(band.parent.size(), -1);
+            band.components = 0;
+            for (int label = 1; label < static_cast<int>(band.parent.size()); label++) {
+                int root = FindRoot(band.parent, label);
+                if (root == label) {
+                    band.compact[label] = band.components++;
+                } else {
+                    band.stats[root].Merge(band.stats[label]);
+                    band.compact[label] = band.compact[root];
+                }
+            }
+        }
+
+        //================================================
+        // Function: Describe
+        //  Note: Convexity uses the octagon bounded by x, y, x + y and x - y around
+        //        the pixel squares instead of the convex hull
+        //================================================
+        HoleRecord Describe(const BlobStats &stats)
+        {
+            const double n = stats.area;
+            const double mean_x = stats.sum_x / n;
+            const double mean_y = stats.sum_y / n;
+            const double cxx = stats.sum_xx / n - mean_x * mean_x;
+            const double cyy = stats.sum_yy / n - mean_y * mean_y;
+            const double cxy = stats.sum_xy / n - mean_x * mean_y;
+            const double half_trace = (cxx + cyy) / 2.0;
+            const double spread = std::sqrt((cxx - cyy) * (cxx - cyy) / 4.0 + cxy * cxy);
+            const double major = half_trace + spread;
+            const double minor = half_trace - spread;
+
+            const double width = stats.max_x - stats.min_x + 1;
+            const double height = stats.max_y - stats.min_y + 1;
+            double octagon = width * height;
+            const double corners[4] = {
+                static_cast<double>(stats.min_sum - stats.min_x - stats.min_y),
+                static_cast<double>(stats.max_x - stats.min_y - stats.max_diff),
+                static_cast<double>(stats.max_x + stats.max_y - stats.max_sum),
+                static_cast<double>(stats.min_diff - stats.min_x + stats.max_y)};
+            for (double leg : corners) {
+                leg = std::max(leg, 0.0);
+                octagon -= leg * leg / 2.0;
+            }
+            octagon = std::max(octagon, n);
+
+            HoleRecord record;
+            record.center = Point2f(static_cast<float>(mean_x), static_cast<float>(mean_y));
+            record.radius = static_cast<float>(std::sqrt(n / CV_PI));
+            record.area = stats.area;
+            record.inertia_ratio = major > 0.0 ? static_cast<float>(std::max(minor, 0.0) / major) : 1.0f;
+            record.convexity = static_cast<float>(n / octagon);
+            record.bounds = Rect(stats.min_x, stats.min_y, stats.max_x - stats.min_x + 1, stats.max_y - stats.min_y + 1);
+            return record;
+        }
+    }
+
+    //================================================
+    // Default constructor
+    //================================================
+    HoleDetector::HoleDetector(HoleDetectorOptions options)
+    {
+        options_ = options;
+        options_.block_size = std::max(options_.block_size, 3) | 1;
+        options_.offset = std::min(std::max(options_.offset, 0), 255);
+    }
+
+    //================================================
+    // Member Function: Detect
+    //================================================
+    std::vector<HoleRecord> HoleDetector::Detect(const Mat &image)
+    {
+        std::vector<HoleRecord> holes;
+        if (image.empty() || image.depth() != CV_8U) {
+            return holes;
+        }
+        if (image.channels() == 3) {
+            cvtColor(image, gray_, COLOR_BGR2GRAY);
+        } else {
+            image.copyTo(gray_);
+        }
+
+        const int rows = gray_.rows;
+        const int cols = gray_.cols;
+        boxFilter(gray_, mean_, CV_8U, Size(options_.block_size, options_.block_size), Point(-1, -1), true,
+                  BORDER_REPLICATE);
+        mask_.create(rows, cols, CV_8U);
+        labels_.create(rows, cols, CV_32S);
+
+        // Threshold and label each band on its own task
+        std::vector<Band> bands((rows + kBandRows - 1) / kBandRows);
+        const uchar offset = static_cast<uchar>(options_.offset);
+        parallel_for_(Range(0, static_cast<int>(bands.size())), [&](const Range &range) {
+            for (int b = range.start; b < range.end; b++) {
+                Band &band = bands[b];
+                band.y0 = b * kBandRows;
+                band.y1 = std::min(band.y0 + kBandRows, rows);
+                for (int y = band.y0; y < band.y1; y++) {
+                    ThresholdRow(gray_.ptr<uchar>(y), mean_.ptr<uchar>(y), mask_.ptr<uchar>(y), cols, offset);
+                }
+                LabelBand(mask_, labels_, band);
+            }
+        });
+
+        // Components numbered band after band, joined where they touch across a seam
+        std::vector<int> base(bands.size(), 0);
+        int total = 0;
+        for (size_t b = 0; b < bands.size(); b++) {
+            base[b] = total;
+            total += bands[b].components;
+        }
+        std::vector<int> parent(total);
+        std::vector<BlobStats> stats(total);
+        for (size_t b = 0; b < bands.size(); b++) {
+            const Band &band = bands[b];
+            for (int label = 1; label < static_cast<int>(band.parent.size()); label++) {
+                if (band.parent[label] == label) {
+                    int id = base[b] + band.compact[label];
+                    parent[id] = id;
+                    stats[id] = band.stats[label];
+                }
+            }
+        }
+        for (size_t b = 1; b < bands.size(); b++) {
+            const Band &band = bands[b];
+            const Band &above = bands[b - 1];
+            const int *row = labels_.ptr<int>(band.y0);
+            const int *up = labels_.ptr<int>(band.y0 - 1);
+            for (int x = 0; x < cols; x++) {
+                if (row[x] == 0) {
+                    continue;
+                }
+                int id = base[b] + band.compact[row[x]];
+                for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, cols - 1); nx++) {
+                    if (up[nx] != 0) {
+                        id = Union(parent, id, base[b - 1] + above.compact[up[nx]]);
+                    }
+                }
+            }
+        }
+        for (int id = 0; id < total; id++) {
+            int root = FindRoot(parent, id);
+            if (root != id) {
+                stats[root].Merge(stats[id]);
+            }
+        }
+
+        // Same filters as SimpleBlobDetector: area, inertia and convexity
+        for (int id = 0; id < total; id++) {
+            if (parent[id] != id || stats[id].area < options_.min_area || stats[id].area > options_.max_area) {
+                continue;
+            }
+            HoleRecord record = Describe(stats[id]);
+            if (record.inertia_ratio >= options_.min_inertia_ratio && record.convexity >= options_.min_convexity) {
+                holes.push_back(record);
+            }
+        }
+        return holes;
+    }
+
+} // TactNib
@@ -0,0 +1,66 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: hole_detector.h
+ * Purpose:	  Bullet hole detector for dark holes on light paper: one adaptive
+ *            threshold and one connected component pass that collects moments
+ *            while labeling, instead of SimpleBlobDetector's contour search at
+ *            many threshold levels. Row bands are labeled in parallel and joined
+ *            at their seams.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_HOLE_DETECTOR_H
+#define SYSTEM_API_HOLE_DETECTOR_H
+
+#include <vector>
+#include <opencv2/core.hpp>
+
+namespace TactNib {
+
+    // Defaults keep the filters FindBlob used with SimpleBlobDetector
+    struct HoleDetectorOptions
+    {
+        int block_size = 31;            // adaptive threshold window, odd
+        int offset = 20;                // hole pixels are darker than their window mean by more than this
+        int min_area = 200;             // pixels
+        int max_area = 350;
+        double min_inertia_ratio = 0.01;
+        double min_convexity = 0.2;
+    };
+
+    struct HoleRecord
+    {
+        cv::Point2f center;
+        float radius;               // of a disc of the same area
+        int area;                   // pixels
+        float inertia_ratio;        // minor / major second moment, 1 for a disc
+        float convexity;            // area / bounding octagon area, about 0.95 for a disc
+        cv::Rect bounds;
+    };
+
+    // Keeps its buffers between calls; use one detector per thread.
+    class HoleDetector {
+        public:
+            explicit HoleDetector(HoleDetectorOptions options = HoleDetectorOptions());
+
+            // image is BGR or gray; holes in raster order of their first pixel
+            std::vector<HoleRecord> Detect(const cv::Mat &image);
+
+            // Threshold mask of the last call, 255 on hole candidates
+            const cv::Mat &mask() const { return mask_; }
+
+        private:
+            HoleDetectorOptions options_;
+            cv::Mat gray_;
+            cv::Mat mean_;
+            cv::Mat mask_;
+            cv::Mat labels_;
+    };
+
+} // TactNib
+
+#endif //SYSTEM_API_HOLE_DETECTOR_H
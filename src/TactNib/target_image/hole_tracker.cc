@@ -0,0 +1,175 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: hole_tracker.cc
+ * Purpose:	  Incremental bullet hole detection over a string of shots at the
+ *            same target. Each dewarped frame is compared with the previous one
+ *            tile by tile and only regions that changed are searched for holes,
+ *            so a new shot costs about as much as the area it disturbed.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <opencv2/imgproc.hpp>
+
+#include "hole_tracker.h"
+
+using namespace cv;
+
+namespace TactNib {
+
+    //================================================
+    // Default constructor
+    //================================================
+    HoleTracker::HoleTracker(HoleTrackerOptions options) : detector_(options.detector)
+    {
+        options_ = options;
+        options_.tile_size = std::max(options_.tile_size, 8);
+        changed_tiles_ = 0;
+    }
+
+    //================================================
+    // Member Function: Reset
+    //================================================
+    void HoleTracker::Reset()
+    {
+        previous_.release();
+        holes_.clear();
+        changed_tiles_ = 0;
+    }
+
+    //================================================
+    // Member Function: IsKnown
+    //================================================
+    bool HoleTracker::IsKnown(const BulletHole &hole) const
+    {
+        for (const BulletHole &known : holes_) {
+            Point2f offset = hole.center - known.center;
+            float reach = std::max(hole.radius, known.radius);
+            if (offset.dot(offset) < reach * reach) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //================================================
+    // Member Function: ChangedRegions
+    //  Note: 8-connected groups on the tile grid, so a hole across a tile corner
+    //        is searched in one piece
+    //================================================
+    std::vector<Rect> HoleTracker::ChangedRegions(const std::vector<uchar> &changed, int tiles_x, int tiles_y)
+    {
+        std::vector<Rect> regions;
+        std::vector<uchar> visited(changed.size(), 0);
+        std::vector<int> stack;
+        const int tile = options_.tile_size;
+        const Rect frame(0, 0, gray_.cols, gray_.rows);
+
+        for (int start = 0; start < static_cast<int>(changed.size()); start++) {
+            if (!changed[start] || visited[start]) {
+                continue;
+            }
+            int x0 = tiles_x, y0 = tiles_y, x1 = -1, y1 = -1;
+            visited[start] = 1;
+            stack.push_back(start);
+            while (!stack.empty()) {
+                int current = stack.back();
+                stack.pop_back();
+                int tx = current % tiles_x;
+                int ty = current / tiles_x;
+                x0 = std::min(x0, tx);
+                y0 = std::min(y0, ty);
+                x1 = std::max(x1, tx);
+                y1 = std::max(y1, ty);
+                for (int ny = std::max(ty - 1, 0); ny <= std::min(ty + 1, tiles_y - 1); ny++) {
+                    for (int nx = std::max(tx - 1, 0); nx <= std::min(tx + 1, tiles_x - 1); nx++) {
+                        int neighbour = ny * tiles_x + nx;
+                        if (changed[neighbour] && !visited[neighbour]) {
+                            visited[neighbour] = 1;
+                            stack.push_back(neighbour);
+                        }
+                    }
+                }
+            }
+
+            // One tile of unchanged context around the group
+            Rect region((x0 - 1) * tile, (y0 - 1) * tile, (x1 - x0 + 3) * tile, (y1 - y0 + 3) * tile);
+            regions.push_back(region & frame);
+        }
+        return regions;
+    }
+
+    //================================================
+    // Member Function: Update
+    //================================================
+    std::vector<BulletHole> HoleTracker::Update(const Mat &dewarped)
+    {
+        std::vector<BulletHole> found;
+        changed_tiles_ = 0;
+        if (dewarped.empty()) {
+            return found;
+        }
+
+        // gray_ holds the frame before last, so its buffer is reused
+        if (dewarped.channels() == 3) {
+            cvtColor(dewarped, gray_, COLOR_BGR2GRAY);
+        } else {
+            dewarped.copyTo(gray_);
+        }
+
+        const int tile = options_.tile_size;
+        const int tiles_x = (gray_.cols + tile - 1) / tile;
+        const int tiles_y = (gray_.rows + tile - 1) / tile;
+        std::vector<uchar> changed(static_cast<size_t>(tiles_x) * tiles_y, 0);
+        if (previous_.size() != gray_.size() || previous_.type() != gray_.type()) {
+            holes_.clear();
+            std::fill(changed.begin(), changed.end(), 1);
+        } else {
+            const Rect frame(0, 0, gray_.cols, gray_.rows);
+            const int threshold = options_.pixel_threshold;
+            parallel_for_(Range(0, tiles_y), [&](const Range &range) {
+                for (int ty = range.start; ty < range.end; ty++) {
+                    for (int tx = 0; tx < tiles_x; tx++) {
+                        Rect area = Rect(tx * tile, ty * tile, tile, tile) & frame;
+                        int count = 0;
+                        for (int y = area.y; y < area.y + area.height; y++) {
+                            const uchar *current = gray_.ptr<uchar>(y) + area.x;
+                            const uchar *before = previous_.ptr<uchar>(y) + area.x;
+                            for (int x = 0; x < area.width; x++) {
+                                count += std::abs(current[x] - before[x]) > threshold;
+                            }
+                        }
+                        changed[ty * tiles_x + tx] = count > options_.tile_fraction * area.area();
+                    }
+                }
+            });
+        }
+        changed_tiles_ = static_cast<int>(std::count(changed.begin(), changed.end(), 1));
+
+        // A hole belongs to the tile of its center; context tiles only help detect it
+        for (const Rect &region : ChangedRegions(changed, tiles_x, tiles_y)) {
+            for (const HoleRecord &record : detector_.Detect(gray_(region))) {
+                BulletHole hole;
+                hole.center = record.center + Point2f(static_cast<float>(region.x), static_cast<float>(region.y));
+                hole.radius = record.radius;
+                int tx = std::min(static_cast<int>(hole.center.x) / tile, tiles_x - 1);
+                int ty = std::min(static_cast<int>(hole.center.y) / tile, tiles_y - 1);
+                if (!changed[ty * tiles_x + tx] || IsKnown(hole)) {
+                    continue;
+                }
+                holes_.push_back(hole);
+                found.push_back(hole);
+            }
+        }
+
+        std::swap(previous_, gray_);
+        return found;
+    }
+
+} // TactNib
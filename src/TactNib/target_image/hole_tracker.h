@@ -0,0 +1,64 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: hole_tracker.h
+ * Purpose:	  Incremental bullet hole detection over a string of shots at the
+ *            same target. Each dewarped frame is compared with the previous one
+ *            tile by tile and only regions that changed are searched for holes,
+ *            so a new shot costs about as much as the area it disturbed.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_HOLE_TRACKER_H
+#define SYSTEM_API_HOLE_TRACKER_H
+
+#include <vector>
+#include <opencv2/core.hpp>
+#include "hole_detector.h"
+#include "target_object_image.h"
+
+namespace TactNib {
+
+    struct HoleTrackerOptions
+    {
+        int tile_size = 64;             // pixels, square
+        int pixel_threshold = 40;       // gray level change for a pixel to count as changed
+        double tile_fraction = 0.02;    // changed share of a tile before it is searched again
+        HoleDetectorOptions detector;
+    };
+
+    // Frames must be aligned to the same template, e.g. TargetObjectImage::image_.
+    // Not thread safe; keep one tracker per stream.
+    class HoleTracker {
+        public:
+            explicit HoleTracker(HoleTrackerOptions options = HoleTrackerOptions());
+
+            // Holes in dewarped that were not in earlier frames. The first frame, or one
+            // of another size, is searched whole and reports every hole on it.
+            std::vector<BulletHole> Update(const cv::Mat &dewarped);
+
+            // Forget earlier frames, e.g. when a fresh target is hung
+            void Reset();
+
+            const std::vector<BulletHole> &holes() const { return holes_; }
+            int changed_tiles() const { return changed_tiles_; }    // in the last Update
+
+        private:
+            // Bounding boxes of connected changed tiles, grown by a tile for context
+            std::vector<cv::Rect> ChangedRegions(const std::vector<uchar> &changed, int tiles_x, int tiles_y);
+            bool IsKnown(const BulletHole &hole) const;
+
+            HoleTrackerOptions options_;
+            HoleDetector detector_;
+            cv::Mat previous_;
+            cv::Mat gray_;
+            std::vector<BulletHole> holes_;
+            int changed_tiles_;
+    };
+
+} // TactNib
+
+#endif //SYSTEM_API_HOLE_TRACKER_H
@@ -0,0 +1,284 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: image_source.cc
+ * Purpose:	  Input image for the finder: a file path, an encoded buffer (what the
+ *            phone uploads) or a raw camera Mat. Each source is decoded at most
+ *            once per resolution and the result is shared by every copy of the
+ *            source. JPEGs can be decoded directly at 1/2, 1/4 or 1/8 size when the
+ *            finder would scale them down anyway.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <opencv2/imgcodecs.hpp>
+
+#include "image_source.h"
+
+namespace TactNib {
+
+    struct ImageSource::State
+    {
+        std::string name;
+        std::string image_file;         // read on first decode
+        std::vector<uchar> encoded;
+        bool encoded_loaded = false;
+
+        // Decoded images by reduction: index 0 is full size, then 1/2, 1/4 and 1/8
+        cv::Mat decoded[4];
+        bool decode_failed = false;
+
+        std::mutex mutex;
+    };
+
+    namespace {
+        const int kReductionFlags[4] = {cv::IMREAD_COLOR, cv::IMREAD_REDUCED_COLOR_2, cv::IMREAD_REDUCED_COLOR_4,
+                                        cv::IMREAD_REDUCED_COLOR_8};
+
+        uint32_t ReadExifValue(const uchar *p, bool little_endian, int bytes)
+        {
+            uint32_t value = 0;
+            for (int k = 0; k < bytes; k++) {
+                int shift = little_endian ? 8 * k : 8 * (bytes - 1 - k);
+                value |= static_cast<uint32_t>(p[k]) << shift;
+            }
+            return value;
+        }
+
+        //================================================
+        // Function: ReadExifOrientation
+        //  Note: Orientation tag (0x0112) of IFD0 in an APP1 Exif segment, 1 if absent
+        //================================================
+        int ReadExifOrientation(const uchar *segment, size_t length)
+        {
+            static const uchar kExif[6] = {'E', 'x', 'i', 'f', 0, 0};
+            if (length < 14 || !std::equal(kExif, kExif + 6, segment)) {
+                return 1;
+            }
+            const uchar *tiff = segment + 6;
+            size_t tiff_length = length - 6;
+            bool little_endian = tiff[0] == 'I' && tiff[1] == 'I';
+            // Offsets come from an uploaded file; compare in size_t so they cannot wrap
+            size_t ifd = ReadExifValue(tiff + 4, little_endian, 4);
+            if (ifd > tiff_length || tiff_length - ifd < 2) {
+                return 1;
+            }
+            size_t entries = std::min<size_t>(ReadExifValue(tiff + ifd, little_endian, 2),
+                                              (tiff_length - ifd - 2) / 12);
+            for (size_t e = 0; e < entries; e++) {
+                const uchar *entry = tiff + ifd + 2 + 12 * e;
+                if (ReadExifValue(entry, little_endian, 2) == 0x0112) {
+                    return static_cast<int>(ReadExifValue(entry + 8, little_endian, 2));
+                }
+            }
+            return 1;
+        }
+
+        //================================================
+        // Function: ReadJpegSize
+        //  Note: Walks the JPEG markers up to the first start-of-frame segment. The size
+        //        is as displayed, i.e. after the EXIF orientation imdecode applies.
+        //================================================
+        bool ReadJpegSize(const std::vector<uchar> &data, cv::Size &size)
+        {
+            if (data.size() < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+                return false;
+            }
+
+            int orientation = 1;
+            size_t i = 2;
+            while (i + 9 < data.size()) {
+                if (data[i] != 0xFF) {
+                    return false;
+                }
+                uchar marker = data[i + 1];
+                if (marker == 0xFF) {           // fill byte
+                    i++;
+                    continue;
+                }
+                if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD9)) {    // no length
+                    i += 2;
+                    continue;
+                }
+
+                size_t length = (static_cast<size_t>(data[i + 2]) << 8) | data[i + 3];
+                if (length < 2 || i + 2 + length > data.size()) {
+                    return false;
+                }
+                if (marker == 0xE1) {
+                    orientation = ReadExifOrientation(&data[i + 4], length - 2);
+                }
+                bool start_of_frame = marker >= 0xC0 && marker <= 0xCF &&
+                                      marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+                if (start_of_frame) {
+                    size.height = (data[i + 5] << 8) | data[i + 6];
+                    size.width = (data[i + 7] << 8) | data[i + 8];
+
+                    // Orientations 5 to 8 rotate by 90 degrees
+                    if (orientation >= 5 && orientation <= 8) {
+                        std::swap(size.width, size.height);
+                    }
+                    return size.width > 0 && size.height > 0;
+                }
+                i += 2 + length;
+            }
+            return false;
+        }
+    }
+
+    //================================================
+    // Member Function: FromFile
+    //================================================
+    ImageSource ImageSource::FromFile(const std::string &image_file)
+    {
+        ImageSource source;
+        if (!image_file.empty()) {
+            source.state_ = std::make_shared<State>();
+            source.state_->name = image_file;
+            source.state_->image_file = image_file;
+        }
+        return source;
+    }
+
+    //================================================
+    // Member Function: FromBuffer
+    //================================================
+    ImageSource ImageSource::FromBuffer(std::vector<uchar> encoded, const std::string &name)
+    {
+        ImageSource source;
+        source.state_ = std::make_shared<State>();
+        source.state_->name = name;
+        source.state_->encoded = std::move(encoded);
+        source.state_->encoded_loaded = true;
+        return source;
+    }
+
+    //================================================
+    // Member Function: FromMat
+    //================================================
+    ImageSource ImageSource::FromMat(const cv::Mat &image, const std::string &name)
+    {
+        ImageSource source;
+        source.state_ = std::make_shared<State>();
+        source.state_->name = name;
+        source.state_->decoded[0] = image;
+        source.state_->encoded_loaded = true;
+        return source;
+    }
+
+    //================================================
+    // Member Function: name
+    //================================================
+    std::string ImageSource::name() const
+    {
+        return state_ ? state_->name : std::string();
+    }
+
+    //================================================
+    // Member Function: Decode
+    //================================================
+    cv::Mat ImageSource::Decode() const
+    {
+        if (!state_) {
+            return cv::Mat();
+        }
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        return DecodeReduced(*state_, 0);
+    }
+
+    //================================================
+    // Member Function: DecodeForHeight
+    //================================================
+    cv::Mat ImageSource::DecodeForHeight(int min_height) const
+    {
+        if (!state_) {
+            return cv::Mat();
+        }
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        State &state = *state_;
+
+        // Never decode again what is already decoded
+        for (int level = 0; level < 4; level++) {
+            const cv::Mat &decoded = state.decoded[level];
+            if (!decoded.empty() && decoded.rows >= min_height) {
+                return decoded;
+            }
+        }
+
+        int level = 0;
+        if (!state.encoded_loaded) {
+            DecodeReduced(state, -1);   // only loads the bytes
+        }
+        cv::Size size;
+        if (ReadJpegSize(state.encoded, size)) {
+            // libjpeg rounds the reduced size up, so this never undershoots min_height
+            while (level < 3 && size.height / (2 << level) >= min_height) {
+                level++;
+            }
+        }
+        return DecodeReduced(state, level);
+    }
+
+    //================================================
+    // Member Function: FullSize
+    //================================================
+    cv::Size ImageSource::FullSize() const
+    {
+        if (!state_) {
+            return cv::Size();
+        }
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        State &state = *state_;
+        if (!state.decoded[0].empty()) {
+            return state.decoded[0].size();
+        }
+
+        if (!state.encoded_loaded) {
+            DecodeReduced(state, -1);   // only loads the bytes
+        }
+        cv::Size size;
+        if (ReadJpegSize(state.encoded, size)) {
+            return size;
+        }
+        return DecodeReduced(state, 0).size();
+    }
+
+    //================================================
+    // Member Function: DecodeReduced
+    //  Note: level is log2 of the reduction; -1 only loads the encoded bytes
+    //================================================
+    cv::Mat ImageSource::DecodeReduced(State &state, int level) const
+    {
+        if (!state.encoded_loaded) {
+            state.encoded_loaded = true;
+            std::ifstream file(state.image_file, std::ios::binary);
+            if (!file) {
+                std::cout << "ImageSource: unable to read " << state.image_file << std::endl;
+                state.decode_failed = true;
+            } else {
+                state.encoded.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            }
+        }
+        if (level < 0) {
+            return cv::Mat();
+        }
+        if (!state.decoded[level].empty() || state.decode_failed || state.encoded.empty()) {
+            return state.decoded[level];
+        }
+
+        state.decoded[level] = cv::imdecode(state.encoded, kReductionFlags[level]);
+        if (state.decoded[level].empty()) {
+            std::cout << "ImageSource: unable to decode " << state.name << std::endl;
+            state.decode_failed = true;
+        }
+        return state.decoded[level];
+    }
+
+} // TactNib
@@ -0,0 +1,62 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: image_source.h
+ * Purpose:	  Input image for the finder: a file path, an encoded buffer (what the
+ *            phone uploads) or a raw camera Mat. Each source is decoded at most
+ *            once per resolution and the result is shared by every copy of the
+ *            source. JPEGs can be decoded directly at 1/2, 1/4 or 1/8 size when the
+ *            finder would scale them down anyway.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_IMAGE_SOURCE_H
+#define SYSTEM_API_IMAGE_SOURCE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+namespace TactNib {
+
+    class ImageSource {
+        public:
+            // An empty source; Decode() returns an empty Mat
+            ImageSource() = default;
+
+            static ImageSource FromFile(const std::string &image_file);
+            static ImageSource FromBuffer(std::vector<uchar> encoded, const std::string &name = "buffer");
+            static ImageSource FromMat(const cv::Mat &image, const std::string &name = "camera");
+
+            bool empty() const { return state_ == nullptr; }
+
+            // File path or the name given to FromBuffer/FromMat
+            std::string name() const;
+
+            // Full resolution BGR image; empty when the source cannot be decoded
+            cv::Mat Decode() const;
+
+            // BGR image at least min_height rows high. JPEGs are decoded with DCT scaling
+            // when the reduction allows it; everything else, or an image already decoded
+            // at full resolution, comes back at full resolution.
+            cv::Mat DecodeForHeight(int min_height) const;
+
+            // Size of the Decode() image, read from the header of a JPEG that has not been
+            // decoded at full resolution; empty when the source cannot be decoded
+            cv::Size FullSize() const;
+
+        private:
+            struct State;
+
+            cv::Mat DecodeReduced(State &, int level) const;
+
+            std::shared_ptr<State> state_;
+    };
+
+} // TactNib
+
+#endif //SYSTEM_API_IMAGE_SOURCE_H
@@ -0,0 +1,254 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: morphology.cc
+ * Purpose:	  Rectangular dilate, erode and closing with van Herk/Gil-Werman
+ *            running min/max filters: about three comparisons per pixel and pass
+ *            whatever the kernel size, so an iterated closing costs the same as
+ *            one with a 3x3 kernel.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <algorithm>
+#include <vector>
+#include <opencv2/imgproc.hpp>
+
+#include "morphology.h"
+
+using namespace cv;
+
+namespace TactNib {
+    namespace Morphology {
+
+        namespace {
+            // Elements per column strip of the vertical pass; 2 * k rows of a strip stay in L2
+            const int kStripWidth = 1024;
+
+            struct MaxOp
+            {
+                static const uchar kIdentity = 0;       // outside pixels never win
+                static uchar Apply(uchar a, uchar b) { return std::max(a, b); }
+            };
+
+            struct MinOp
+            {
+                static const uchar kIdentity = 255;
+                static uchar Apply(uchar a, uchar b) { return std::min(a, b); }
+            };
+
+            //================================================
+            // Function: FilterRows
+            //  Note: Horizontal pass over rows [y0, y1). The row padded by r identity
+            //        pixels each side is cut in blocks of k = 2r + 1 pixels; g holds
+            //        running results from each block start, h from each block end.
+            //        A window [x, x + 2r] of the padded row spans at most two blocks,
+            //        so its result is Op(h[x], g[x + 2r]).
+            //================================================
+            template<typename Op>
+            void FilterRows(const Mat &src, Mat &dst, int r, int y0, int y1)
+            {
+                const int cn = src.channels();
+                const int n = src.cols;
+                const int k = 2 * r + 1;
+                const int blocks = (n + 2 * r + k - 1) / k;
+                const int length = blocks * k * cn;
+
+                std::vector<uchar> padded(length, Op::kIdentity);
+                std::vector<uchar> g(length);
+                std::vector<uchar> h(length);
+                for (int y = y0; y < y1; y++) {
+                    std::copy(src.ptr<uchar>(y), src.ptr<uchar>(y) + n * cn, padded.begin() + r * cn);
+
+                    for (int start = 0; start < length; start += k * cn) {
+                        const int end = start + k * cn;
+                        std::copy(&padded[start], &padded[start] + cn, &g[start]);
+                        for (int e = start + cn; e < end; e++) {
+                            g[e] = Op::Apply(g[e - cn], padded[e]);
+                        }
+                        std::copy(&padded[end - cn], &padded[end], &h[end - cn]);
+                        for (int e = end - cn - 1; e >= start; e--) {
+                            h[e] = Op::Apply(h[e + cn], padded[e]);
+                        }
+                    }
+
+                    uchar *out = dst.ptr<uchar>(y);
+                    const int shift = 2 * r * cn;
+                    for (int e = 0; e < n * cn; e++) {
+                        out[e] = Op::Apply(h[e], g[e + shift]);
+                    }
+                }
+            }
+
+            //================================================
+            // Function: FilterColumns
+            //  Note: Vertical pass over elements [x0, x1) of every row, same blocks as
+            //        FilterRows but whole row segments at a time. Output rows of block b
+            //        only need h of block b and g of block b + 1, so two blocks of k
+            //        rows are kept instead of the whole padded image.
+            //================================================
+            template<typename Op>
+            void FilterColumns(const Mat &src, Mat &dst, int r, int x0, int x1)
+            {
+                const int rows = src.rows;
+                const int k = 2 * r + 1;
+                const int width = x1 - x0;
+                const int blocks = (rows + 2 * r + k - 1) / k;
+
+                std::vector<uchar> identity(width, Op::kIdentity);
+                std::vector<uchar> h(static_cast<size_t>(k) * width);
+                std::vector<uchar> g(static_cast<size_t>(k) * width);
+
+                // Row j of the padded image
+                auto padded_row = [&](int j) -> const uchar * {
+                    int y = j - r;
+                    return (y >= 0 && y < rows) ? src.ptr<uchar>(y) + x0 : identity.data();
+                };
+
+                for (int b = 0; b < blocks && b * k < rows; b++) {
+                    // Suffix results of block b
+                    const int start = b * k;
+                    std::copy(padded_row(start + k - 1), padded_row(start + k - 1) + width,
+                              &h[static_cast<size_t>(k - 1) * width]);
+                    for (int i = k - 2; i >= 0; i--) {
+                        const uchar *in = padded_row(start + i);
+                        const uchar *next = &h[static_cast<size_t>(i + 1) * width];
+                        uchar *out = &h[static_cast<size_t>(i) * width];
+                        for (int e = 0; e < width; e++) {
+                            out[e] = Op::Apply(next[e], in[e]);
+                        }
+                    }
+
+                    // Prefix results of block b + 1
+                    const int next_start = start + k;
+                    std::copy(padded_row(next_start), padded_row(next_start) + width, &g[0]);
+                    for (int i = 1; i < k; i++) {
+                        const uchar *in = padded_row(next_start + i);
+                        const uchar *prev = &g[static_cast<size_t>(i - 1) * width];
+                        uchar *out = &g[static_cast<size_t>(i) * width];
+                        for (int e = 0; e < width; e++) {
+                            out[e] = Op::Apply(prev[e], in[e]);
+                        }
+                    }
+
+                    // Output row y covers padded rows y .. y + 2r: all of block b when y
+                    // starts it, otherwise the tail of block b and the head of block b + 1
+                    for (int i = 0; i < k && start + i < rows; i++) {
+                        const uchar *tail = &h[static_cast<size_t>(i) * width];
+                        uchar *out = dst.ptr<uchar>(start + i) + x0;
+                        if (i == 0) {
+                            std::copy(tail, tail + width, out);
+                        } else {
+                            const uchar *head = &g[static_cast<size_t>(i - 1) * width];
+                            for (int e = 0; e < width; e++) {
+                                out[e] = Op::Apply(tail[e], head[e]);
+                            }
+                        }
+                    }
+                }
+            }
+
+            //================================================
+            // Function: FilterRect
+            //================================================
+            template<typename Op>
+            void FilterRect(const Mat &src, Mat &dst, Size ksize)
+            {
+                CV_Assert(src.depth() == CV_8U && ksize.width % 2 == 1 && ksize.height % 2 == 1);
+
+                // Both passes read a different image than they write, so dst may be src
+                Mat source = src;
+                Mat horizontal(src.size(), src.type());
+                const int rx = ksize.width / 2;
+                const int ry = ksize.height / 2;
+                if (rx > 0) {
+                    parallel_for_(Range(0, src.rows), [&](const Range &range) {
+                        FilterRows<Op>(source, horizontal, rx, range.start, range.end);
+                    });
+                } else {
+                    source.copyTo(horizontal);
+                }
+
+                dst.create(src.size(), src.type());
+                if (ry > 0) {
+                    const int elements = src.cols * src.channels();
+                    const int strips = (elements + kStripWidth - 1) / kStripWidth;
+                    parallel_for_(Range(0, strips), [&](const Range &range) {
+                        for (int s = range.start; s < range.end; s++) {
+                            int x0 = s * kStripWidth;
+                            FilterColumns<Op>(horizontal, dst, ry, x0, std::min(x0 + kStripWidth, elements));
+                        }
+                    });
+                } else {
+                    horizontal.copyTo(dst);
+                }
+            }
+        }
+
+        //================================================
+        // Function: DilateRect
+        //================================================
+        void DilateRect(const Mat &src, Mat &dst, Size ksize)
+        {
+            FilterRect<MaxOp>(src, dst, ksize);
+        }
+
+        //================================================
+        // Function: ErodeRect
+        //================================================
+        void ErodeRect(const Mat &src, Mat &dst, Size ksize)
+        {
+            FilterRect<MinOp>(src, dst, ksize);
+        }
+
+        //================================================
+        // Function: CloseRect
+        //================================================
+        void CloseRect(const Mat &src, Mat &dst, Size ksize)
+        {
+            Mat dilated;
+            DilateRect(src, dilated, ksize);
+            ErodeRect(dilated, dst, ksize);
+        }
+
+        //================================================
+        // Function: IteratedKernelSize
+        //  Note: Each further pass of a w x h rectangle grows the support by w - 1, h - 1
+        //================================================
+        Size IteratedKernelSize(Size element, int iterations)
+        {
+            iterations = std::max(iterations, 1);
+            return Size(element.width + (iterations - 1) * (element.width - 1),
+                        element.height + (iterations - 1) * (element.height - 1));
+        }
+
+        //================================================
+        // Function: BlankPaper
+        //================================================
+        void BlankPaper(const Mat &src, Mat &dst, Size element, int iterations, double scale, bool grayscale)
+        {
+            Mat image = src;
+            if (grayscale && image.channels() == 3) {
+                Mat gray;
+                cvtColor(image, gray, COLOR_BGR2GRAY);
+                image = gray;
+            }
+
+            Size ksize = IteratedKernelSize(element, iterations);
+            if (scale > 0.0 && scale < 1.0) {
+                Mat reduced;
+                resize(image, reduced, Size(), scale, scale, INTER_AREA);
+                image = reduced;
+
+                // Keep the kernel odd and at least 3 so the closing still happens
+                ksize.width = std::max(3, cvRound(ksize.width * scale) | 1);
+                ksize.height = std::max(3, cvRound(ksize.height * scale) | 1);
+            }
+
+            CloseRect(image, dst, ksize);
+        }
+
+    } // Morphology
+} // TactNib
@@ -0,0 +1,45 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: morphology.h
+ * Purpose:	  Rectangular dilate, erode and closing with van Herk/Gil-Werman
+ *            running min/max filters: about three comparisons per pixel and pass
+ *            whatever the kernel size, so an iterated closing costs the same as
+ *            one with a 3x3 kernel.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_MORPHOLOGY_H
+#define SYSTEM_API_MORPHOLOGY_H
+
+#include <opencv2/core.hpp>
+
+namespace TactNib {
+    namespace Morphology {
+
+        // 8-bit images of any channel count, odd kernel sizes, anchor at the center.
+        // Pixels outside the image are ignored, like OpenCV's default border value,
+        // so the results are identical to cv::dilate/cv::erode with a MORPH_RECT kernel.
+        void DilateRect(const cv::Mat &src, cv::Mat &dst, cv::Size ksize);
+        void ErodeRect(const cv::Mat &src, cv::Mat &dst, cv::Size ksize);
+        void CloseRect(const cv::Mat &src, cv::Mat &dst, cv::Size ksize);
+
+        // Kernel of one operation equal to iterating a rectangular element, which is
+        // what morphologyEx(MORPH_CLOSE, element, iterations) does per half
+        cv::Size IteratedKernelSize(cv::Size element, int iterations);
+
+        // Blank out the content of the paper target: closing with element applied
+        // iterations times. Scale < 1 closes a downscaled copy with the kernel scaled
+        // along, and grayscale a luminance copy; dst then has that size and type and
+        // only the paper outline is meaningful. With the defaults dst is identical to
+        // morphologyEx(src, dst, MORPH_CLOSE, element, Point(-1, -1), iterations).
+        void BlankPaper(const cv::Mat &src, cv::Mat &dst, cv::Size element, int iterations, double scale = 1.0,
+                        bool grayscale = false);
+
+    } // Morphology
+} // TactNib
+
+#endif //SYSTEM_API_MORPHOLOGY_H
@@ -12,8 +12,12 @@
  *
  * ============================================================================*/
 
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+
 #include "object_detect_strategy.h"
 #include "opencv_algo.h"
+#include "trace.h"
 
 namespace TactNib {
 
@@ -28,28 +32,126 @@ namespace TactNib {
     TargetObjectImage ObjectDetectStrategy::FindTarget() {
 
         // Convert jpg file to opencv matrix
-        Mat image_scene  = imread(image_scene_file_, IMREAD_COLOR);
-        Mat image_object = imread(image_target_file_, IMREAD_COLOR);
+        Mat image_scene = scene_source_.Decode();
+        if (image_scene.empty()) {
+            std::cout << "Unable to read scene image " << scene_source_.name() << std::endl;
+            return TargetObjectImage();
+        }
+
+        return FindTargets(std::vector<Mat>{image_scene})[0];
+    }
+
+    //================================================
+    // Member Function: FindTargets
+    //================================================
+    std::vector<TargetObjectImage> ObjectDetectStrategy::FindTargets(const std::vector<Mat> &scenes) {
+
+        std::vector<TargetObjectImage> targets(scenes.size());
+        PrepareTemplate();
 
-        // Todo: Process scene image with YOLO5 OBB object detection logic
+        // Step 1: Load the model once per thread
+        ObjectDetector &detector = ObjectDetector::ForThread(ObjectDetectOptions::FromConfig(config_));
+        if (!detector.loaded()) {
+            return targets;
+        }
 
-        // Step : Get target object corners from YOLO5 results
-            // TargetObject.corner
+        // Step 2: Oriented boxes, batch by batch
+        const size_t batch = static_cast<size_t>(std::max(config_.detect_batch, 1));
+        for (size_t first = 0; first < scenes.size(); first += batch) {
+            if (cancel_.StopRequested()) {
+                std::cout << "Stopped: " << scenes.size() - first << " scenes not detected" << std::endl;
+                for (size_t i = first; i < scenes.size(); i++) {
+                    targets[i].partial_ = true;
+                }
+                break;
+            }
+            std::vector<Mat> group(scenes.begin() + first, scenes.begin() + std::min(first + batch, scenes.size()));
+            TraceScope trace_detect("detect");
+            std::vector<std::vector<OrientedDetection>> detections = detector.Detect(group);
+            std::cout << "Step 2: Detect " << group.size() << " scenes: " << trace_detect.End() << " s" << std::endl;
 
-        // Step : Get target object image from YOLO5 results
-            // TargetObject.image
+            // Step 3: Dewarp and score each scene's best box
+            for (size_t i = 0; i < group.size(); i++) {
+                targets[first + i] = MakeResult(group[i], detections[i]);
+            }
+        }
+        return targets;
+    }
 
-        // Step : Dewarp  target object image
-        Mat image_dewarp;
-            // TargetObject.image
+    //================================================
+    // Member Function: PrepareTemplate
+    //================================================
+    void ObjectDetectStrategy::PrepareTemplate() {
 
-        // Step : Get alignment score of target object image
-        std::cout << "Step Z: Score the alignment of scene's target and template target" << std::endl;
-        Scalar results = OpencvAlgo::GetMSSIM(image_object, image_dewarp);
-            // TargetObject.score
+        if (template_prepared_) {
+            return;
+        }
+        template_prepared_ = true;
+
+        SsimOptions ssim_options;
+        ssim_options.scale = config_.ssim_scale;
+        ssim_options.grayscale = config_.ssim_grayscale;
+        if (template_pack_ != nullptr) {
+            image_object_ = template_pack_->image();
+            ssim_engine_ = template_pack_->GetSsimEngine(ssim_options);
+            return;
+        }
+
+        image_object_ = target_source_.Decode();
+        if (image_object_.empty()) {
+            std::cout << "ObjectDetect: no template image, targets are not scored" << std::endl;
+            return;
+        }
+        auto engine = std::make_shared<SsimEngine>(ssim_options);
+        engine->SetReference(image_object_);
+        ssim_engine_ = engine;
+    }
+
+    //================================================
+    // Member Function: MakeResult
+    //================================================
+    TargetObjectImage ObjectDetectStrategy::MakeResult(const Mat &scene,
+                                                       const std::vector<OrientedDetection> &detections) const {
 
-        // TODO: Clean up return code
         TargetObjectImage target_object;
+        if (detections.empty()) {
+            std::cout << "ObjectDetect: no target found" << std::endl;
+            return target_object;
+        }
+
+        // Step 3a: Corners of the best box
+        Point2f box_points[4];
+        detections[0].box.points(box_points);
+        std::vector<Point2f> corners = OpencvAlgo::OrderCorners(std::vector<Point2f>(box_points, box_points + 4));
+        for (int i = 0; i < 4; i++) {
+            target_object.corner_points_[i].x = cvRound(corners[i].x);
+            target_object.corner_points_[i].y = cvRound(corners[i].y);
+        }
+
+        // Step 3b: Dewarp to the template, or to the box size without one
+        Size dewarp_size = image_object_.size();
+        if (image_object_.empty()) {
+            dewarp_size = Size(cvRound(std::max(norm(corners[1] - corners[0]), norm(corners[2] - corners[3]))),
+                               cvRound(std::max(norm(corners[3] - corners[0]), norm(corners[2] - corners[1]))));
+        }
+        std::vector<Point2f> dewarp_corners = {Point2f(0, 0), Point2f(static_cast<float>(dewarp_size.width), 0),
+                                               Point2f(static_cast<float>(dewarp_size.width),
+                                                       static_cast<float>(dewarp_size.height)),
+                                               Point2f(0, static_cast<float>(dewarp_size.height))};
+        Mat h_scene_to_obj = getPerspectiveTransform(corners, dewarp_corners);
+        warpPerspective(scene, target_object.image_, h_scene_to_obj, dewarp_size);
+
+        // Step 3c: Score the alignment of scene's target and template target
+        if (ssim_engine_ != nullptr) {
+            Scalar results = ssim_engine_->Score(target_object.image_, nullptr, &cancel_);
+            if (cancel_.StopRequested()) {
+                target_object.partial_ = true;
+                return target_object;
+            }
+            target_object.score_ = ((results.val[0] + results.val[1] + results.val[2]) / 3) * 100;
+        }
+        std::cout << "Image Similarity: " << target_object.score_ << " (box score " << detections[0].score << ")"
+                  << std::endl;
         return target_object;
     }
 
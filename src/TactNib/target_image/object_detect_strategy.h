@@ -15,7 +15,12 @@
 #ifndef SYSTEM_API_OBJECT_DETECT_STRATEGY_H
 #define SYSTEM_API_OBJECT_DETECT_STRATEGY_H
 
+#include <memory>
 #include <string>
+#include <vector>
+#include "finder_config.h"
+#include "object_detector.h"
+#include "ssim_engine.h"
 #include "target_finder_strategy.h"
 
 namespace TactNib {
@@ -24,9 +29,26 @@ namespace TactNib {
         public:
             ObjectDetectStrategy(std::string, std::string);
 
+            void SetConfig(const FinderConfig &config) { config_ = config; }
+
+            // Locate the target in every scene, detect_batch scenes per forward pass.
+            // Results are in the order of scenes; a scene without a detection gets an
+            // empty TargetObjectImage.
+            std::vector<TargetObjectImage> FindTargets(const std::vector<cv::Mat> &scenes);
+
         private:
         TargetObjectImage FindTarget() override;
 
+        // Template for the dewarp size and SSIM score; without one the box is dewarped
+        // at its own size and not scored
+        void PrepareTemplate();
+        TargetObjectImage MakeResult(const cv::Mat &scene, const std::vector<OrientedDetection> &detections) const;
+
+        FinderConfig config_;
+        bool template_prepared_ = false;
+        cv::Mat image_object_;
+        std::shared_ptr<const SsimEngine> ssim_engine_;
+
         protected:
     };
 
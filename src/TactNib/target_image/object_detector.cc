@@ -0,0 +1,246 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: object_detector.cc
+ * Purpose:	  Oriented box detector for the paper target, an ONNX model run on
+ *            the CPU with OpenCV DNN. The network is loaded and warmed up once
+ *            per thread, and the letterbox images and input blob are reused from
+ *            batch to batch.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <algorithm>
+#include <iostream>
+#include <opencv2/imgproc.hpp>
+
+#include "object_detector.h"
+
+using namespace cv;
+
+namespace TactNib {
+
+    namespace {
+        // Ultralytics letterbox fill and input scaling
+        const Scalar kPadColor = Scalar::all(114);
+        const double kPixelScale = 1.0 / 255.0;
+
+        void MakeBlob(const std::vector<Mat> &images, Mat &blob)
+        {
+            dnn::blobFromImages(images, blob, kPixelScale, Size(), Scalar(), true, false);
+        }
+    }
+
+    //================================================
+    // Function: FromConfig
+    //================================================
+    ObjectDetectOptions ObjectDetectOptions::FromConfig(const FinderConfig &config)
+    {
+        ObjectDetectOptions options;
+        options.model = config.detect_model;
+        options.model_int8 = config.detect_model_int8;
+        options.input_size = config.detect_input_size;
+        options.score_threshold = config.detect_score_threshold;
+        return options;
+    }
+
+    //================================================
+    // Member Function: ForThread
+    //================================================
+    ObjectDetector &ObjectDetector::ForThread(const ObjectDetectOptions &options)
+    {
+        thread_local ObjectDetector detector;
+        bool same = detector.attempted_ && options.model == detector.options_.model &&
+                    options.model_int8 == detector.options_.model_int8 &&
+                    options.input_size == detector.options_.input_size;
+        if (same) {
+            // Thresholds only apply to parsing
+            detector.options_ = options;
+        } else {
+            detector.Load(options);
+        }
+        return detector;
+    }
+
+    //================================================
+    // Member Function: Load
+    //================================================
+    bool ObjectDetector::Load(const ObjectDetectOptions &options)
+    {
+        options_ = options;
+        attempted_ = true;
+        loaded_ = false;
+        single_batch_ = false;
+
+        // The int8 model is smaller and faster on the board; fall back to fp32 when it fails
+        for (const std::string &model : {options.model_int8, options.model}) {
+            if (model.empty()) {
+                continue;
+            }
+            try {
+                net_ = dnn::readNetFromONNX(model);
+                net_.setPreferableBackend(dnn::DNN_BACKEND_OPENCV);
+                net_.setPreferableTarget(dnn::DNN_TARGET_CPU);
+                output_names_ = net_.getUnconnectedOutLayersNames();
+
+                // The first forward pass allocates and initializes the layers
+                letterboxed_.assign(1, Mat(options.input_size, options.input_size, CV_8UC3, kPadColor));
+                MakeBlob(letterboxed_, blob_);
+                net_.setInput(blob_);
+                net_.forward(outputs_, output_names_);
+                loaded_ = true;
+                std::cout << "ObjectDetector: loaded " << model << std::endl;
+                return true;
+            } catch (const cv::Exception &e) {
+                std::cout << "ObjectDetector: unable to load " << model << ": " << e.what() << std::endl;
+            }
+        }
+        if (options.model.empty() && options.model_int8.empty()) {
+            std::cout << "ObjectDetector: no model configured, see FinderConfig::detect_model" << std::endl;
+        }
+        return false;
+    }
+
+    //================================================
+    // Member Function: Detect
+    //================================================
+    std::vector<std::vector<OrientedDetection>> ObjectDetector::Detect(const std::vector<Mat> &scenes)
+    {
+        std::vector<std::vector<OrientedDetection>> detections(scenes.size());
+        if (!loaded_ || scenes.empty()) {
+            return detections;
+        }
+
+        // Letterbox every scene into the square input, keeping the aspect ratio
+        const int size = options_.input_size;
+        std::vector<Letterbox> letterboxes(scenes.size());
+        letterboxed_.resize(scenes.size());
+        for (size_t i = 0; i < scenes.size(); i++) {
+            Mat &canvas = letterboxed_[i];
+            canvas.create(size, size, CV_8UC3);
+            canvas.setTo(kPadColor);
+            if (scenes[i].empty() || scenes[i].type() != CV_8UC3) {
+                continue;
+            }
+            Letterbox &letterbox = letterboxes[i];
+            letterbox.scale = std::min(static_cast<double>(size) / scenes[i].cols,
+                                       static_cast<double>(size) / scenes[i].rows);
+            Size resized(std::max(1, cvRound(scenes[i].cols * letterbox.scale)),
+                         std::max(1, cvRound(scenes[i].rows * letterbox.scale)));
+            letterbox.pad = Point2f(static_cast<float>((size - resized.width) / 2),
+                                    static_cast<float>((size - resized.height) / 2));
+            Mat inset = canvas(Rect(cvRound(letterbox.pad.x), cvRound(letterbox.pad.y), resized.width, resized.height));
+            resize(scenes[i], inset, resized, 0, 0, INTER_LINEAR);
+        }
+
+        if (!single_batch_) {
+            try {
+                MakeBlob(letterboxed_, blob_);
+                net_.setInput(blob_);
+                net_.forward(outputs_, output_names_);
+                for (size_t i = 0; i < scenes.size(); i++) {
+                    if (!scenes[i].empty()) {
+                        detections[i] = Parse(outputs_[0], static_cast<int>(i), letterboxes[i]);
+                    }
+                }
+                return detections;
+            } catch (const cv::Exception &e) {
+                if (scenes.size() == 1) {
+                    std::cout << "ObjectDetector: forward failed: " << e.what() << std::endl;
+                    return detections;
+                }
+                // Exported with a fixed batch of one
+                std::cout << "ObjectDetector: model takes one scene per pass" << std::endl;
+                single_batch_ = true;
+            }
+        }
+
+        std::vector<Mat> single(1);
+        for (size_t i = 0; i < scenes.size(); i++) {
+            if (scenes[i].empty()) {
+                continue;
+            }
+            single[0] = letterboxed_[i];
+            try {
+                MakeBlob(single, blob_);
+                net_.setInput(blob_);
+                net_.forward(outputs_, output_names_);
+                detections[i] = Parse(outputs_[0], 0, letterboxes[i]);
+            } catch (const cv::Exception &e) {
+                std::cout << "ObjectDetector: forward failed: " << e.what() << std::endl;
+            }
+        }
+        return detections;
+    }
+
+    //================================================
+    // Member Function: Parse
+    //================================================
+    std::vector<OrientedDetection> ObjectDetector::Parse(const Mat &output, int batch_index,
+                                                         const Letterbox &letterbox) const
+    {
+        std::vector<OrientedDetection> detections;
+        if (output.dims != 3 || output.depth() != CV_32F || batch_index >= output.size[0]) {
+            std::cout << "ObjectDetector: unexpected output layout" << std::endl;
+            return detections;
+        }
+
+        // There are always more boxes than attributes per box
+        const bool attributes_first = output.size[1] < output.size[2];
+        const int attributes = attributes_first ? output.size[1] : output.size[2];
+        const int boxes = attributes_first ? output.size[2] : output.size[1];
+        const int classes = attributes - 5;
+        if (classes < 1) {
+            std::cout << "ObjectDetector: unexpected output layout" << std::endl;
+            return detections;
+        }
+        const float *data = output.ptr<float>(batch_index);
+        auto value = [&](int box, int attribute) {
+            return attributes_first ? data[attribute * boxes + box] : data[box * attributes + attribute];
+        };
+
+        std::vector<RotatedRect> rects;
+        std::vector<float> scores;
+        std::vector<int> class_ids;
+        for (int box = 0; box < boxes; box++) {
+            int class_id = 0;
+            float score = value(box, 4);
+            for (int c = 1; c < classes; c++) {
+                if (value(box, 4 + c) > score) {
+                    score = value(box, 4 + c);
+                    class_id = c;
+                }
+            }
+            if (score < options_.score_threshold) {
+                continue;
+            }
+
+            // Back from the letterbox to scene pixels
+            const double scale = letterbox.scale;
+            Point2f center(static_cast<float>((value(box, 0) - letterbox.pad.x) / scale),
+                           static_cast<float>((value(box, 1) - letterbox.pad.y) / scale));
+            Size2f extent(static_cast<float>(value(box, 2) / scale), static_cast<float>(value(box, 3) / scale));
+            float angle = static_cast<float>(value(box, 4 + classes) * 180.0 / CV_PI);
+            rects.emplace_back(center, extent, angle);
+            scores.push_back(score);
+            class_ids.push_back(class_id);
+        }
+
+        std::vector<int> keep;
+        dnn::NMSBoxes(rects, scores, static_cast<float>(options_.score_threshold),
+                      static_cast<float>(options_.nms_threshold), keep);
+        for (int index : keep) {
+            OrientedDetection detection;
+            detection.box = rects[index];
+            detection.score = scores[index];
+            detection.class_id = class_ids[index];
+            detections.push_back(detection);
+        }
+        std::sort(detections.begin(), detections.end(),
+                  [](const OrientedDetection &a, const OrientedDetection &b) { return a.score > b.score; });
+        return detections;
+    }
+
+} // TactNib
@@ -0,0 +1,92 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: object_detector.h
+ * Purpose:	  Oriented box detector for the paper target, an ONNX model run on
+ *            the CPU with OpenCV DNN. The network is loaded and warmed up once
+ *            per thread, and the letterbox images and input blob are reused from
+ *            batch to batch.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_OBJECT_DETECTOR_H
+#define SYSTEM_API_OBJECT_DETECTOR_H
+
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/dnn.hpp>
+
+#include "finder_config.h"
+
+namespace TactNib {
+
+    struct ObjectDetectOptions
+    {
+        std::string model;              // ONNX file, fp32
+        std::string model_int8;         // quantized ONNX file; used instead when set and it loads
+        int input_size = 640;           // square network input
+        double score_threshold = 0.25;
+        double nms_threshold = 0.45;
+
+        static ObjectDetectOptions FromConfig(const FinderConfig &config);
+    };
+
+    struct OrientedDetection
+    {
+        cv::RotatedRect box;            // scene pixels; angle in degrees
+        float score = 0.0f;
+        int class_id = 0;
+    };
+
+    // Output layout of YOLOv8-OBB exports: per box cx, cy, w, h, one score per class,
+    // then the angle in radians, as [batch, attributes, boxes] or [batch, boxes, attributes].
+    class ObjectDetector {
+        public:
+            // The calling thread's detector with options loaded; cv::dnn::Net is not safe to
+            // run from several threads. A failed load is not retried until the model
+            // options change.
+            static ObjectDetector &ForThread(const ObjectDetectOptions &options);
+
+
+            ObjectDetector() = default;
+            ObjectDetector(const ObjectDetector &) = delete;
+            ObjectDetector &operator=(const ObjectDetector &) = delete;
+
+            // Load and warm up the model; false when neither model file loads
+            bool Load(const ObjectDetectOptions &options);
+            bool loaded() const { return loaded_; }
+
+            // Detections per scene, best first, after non-maximum suppression. Scenes go
+            // through the network together unless the model only takes a batch of one.
+            std::vector<std::vector<OrientedDetection>> Detect(const std::vector<cv::Mat> &scenes);
+
+        private:
+            friend class ObjectDetectorTest;   // tests/object_detector_test.cc drives Parse
+
+            struct Letterbox
+            {
+                double scale = 1.0;
+                cv::Point2f pad;
+            };
+
+            std::vector<OrientedDetection> Parse(const cv::Mat &output, int batch_index, const Letterbox &letterbox) const;
+
+            ObjectDetectOptions options_;
+            bool attempted_ = false;        // Load() ran with options_, successfully or not
+            bool loaded_ = false;
+            bool single_batch_ = false;     // the model rejected a batched input once
+
+            cv::dnn::Net net_;
+            std::vector<cv::String> output_names_;
+            std::vector<cv::Mat> letterboxed_;
+            cv::Mat blob_;
+            std::vector<cv::Mat> outputs_;
+    };
+
+} // TactNib
+
+#endif //SYSTEM_API_OBJECT_DETECTOR_H
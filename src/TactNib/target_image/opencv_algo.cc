@@ -8,19 +8,96 @@
  *
  * ============================================================================*/
 
+#include <algorithm>
+#include <iostream>
+
+#include "hole_detector.h"
 #include "opencv_algo.h"
+#include "ssim_engine.h"
 
 using namespace cv;
 
 namespace TactNib {
 
+    namespace {
+        // Object to scene warp for pyramid level, from or to full resolution:
+        // W_l = S W S^-1 with S = diag(s, s, 1), s = 2^-level
+        Mat WarpAtLevel(const Mat &warp, int level)
+        {
+            Mat scaled;
+            warp.convertTo(scaled, CV_64F);
+            double down = static_cast<double>(1 << level);
+            scaled.at<double>(0, 2) /= down;
+            scaled.at<double>(1, 2) /= down;
+            scaled.at<double>(2, 0) *= down;
+            scaled.at<double>(2, 1) *= down;
+            return scaled;
+        }
+
+        Mat WarpFromLevel(const Mat &warp, int level)
+        {
+            Mat scaled;
+            warp.convertTo(scaled, CV_64F);
+            double up = static_cast<double>(1 << level);
+            scaled.at<double>(0, 2) *= up;
+            scaled.at<double>(1, 2) *= up;
+            scaled.at<double>(2, 0) /= up;
+            scaled.at<double>(2, 1) /= up;
+            return scaled;
+        }
+
+        // ECC correlation of the object and the scene pulled back through h_obj_to_scene,
+        // both smoothed like findTransformECC does and only where the scene is visible
+        double WarpCorrelation(const Mat &object_gray, const Mat &scene_gray, const Mat &h_obj_to_scene,
+                               int gauss_filt_size)
+        {
+            Mat warped, visible;
+            warpPerspective(scene_gray, warped, h_obj_to_scene, object_gray.size(), INTER_LINEAR + WARP_INVERSE_MAP);
+            warpPerspective(Mat(scene_gray.size(), CV_8U, Scalar(255)), visible, h_obj_to_scene, object_gray.size(),
+                            INTER_NEAREST + WARP_INVERSE_MAP);
+            Mat object_smooth, warped_smooth;
+            GaussianBlur(object_gray, object_smooth, Size(gauss_filt_size, gauss_filt_size), 0, 0);
+            GaussianBlur(warped, warped_smooth, Size(gauss_filt_size, gauss_filt_size), 0, 0);
+            return computeECC(object_smooth, warped_smooth, visible);
+        }
+
+        // Largest distance between the object's image corners under two warps
+        double CornerShift(Size object_size, const Mat &h_a, const Mat &h_b)
+        {
+            std::vector<Point2f> corners = {Point2f(0, 0), Point2f(static_cast<float>(object_size.width), 0),
+                                            Point2f(static_cast<float>(object_size.width),
+                                                    static_cast<float>(object_size.height)),
+                                            Point2f(0, static_cast<float>(object_size.height))};
+            std::vector<Point2f> a, b;
+            perspectiveTransform(corners, a, h_a);
+            perspectiveTransform(corners, b, h_b);
+            double shift = 0.0;
+            for (size_t i = 0; i < corners.size(); i++) {
+                shift = std::max(shift, static_cast<double>(norm(a[i] - b[i])));
+            }
+            return shift;
+        }
+    }
+
     namespace OpencvAlgo {
         //================================================
         // Member Function: GetMSSIM
+        //  Note: Fused, tiled implementation; see SsimEngine for the accuracy
+        //================================================
+        Scalar GetMSSIM(const Mat &i1, const Mat &i2) {
+
+            if (i1.depth() != CV_8U || i2.depth() != CV_8U) {
+                return GetMSSIMReference(i1, i2);
+            }
+            return SsimEngine::Compute(i1, i2);
+        }
+
+        //================================================
+        // Member Function: GetMSSIMReference
         //  Note: Found this on the internet
         // https://docs.opencv.org/3.4/d5/dc4/tutorial_video_input_psnr_ssim.html
         //================================================
-        Scalar GetMSSIM(const Mat &i1, const Mat &i2) {
+        Scalar GetMSSIMReference(const Mat &i1, const Mat &i2) {
 
             const double C1 = 6.5025, C2 = 58.5225;
             /***************************** INITS **********************************/
@@ -115,93 +192,206 @@ namespace TactNib {
         }
 
         //================================================
-        // Member Function: FindBlob
+        // Member Function: RefineHomographyECC
+        //  Note: Starts ECC from the feature homography instead of the identity and
+        //        works from the coarsest pyramid level down, so each level only has
+        //        to correct a pixel or two. ECC over the whole template can settle on
+        //        scene background, so the refined warp is only returned when it
+        //        correlates better than the seed at the finest level reached and moves
+        //        no corner more than max_corner_shift; otherwise h_obj_to_scene is.
         //================================================
-        Mat FindBlob(const cv::Mat &source) {
+        Mat RefineHomographyECC(const Mat &image_object, const Mat &image_scene, const Mat &h_obj_to_scene,
+                                const EccOptions &options) {
 
-            // Initialize parameter setting using cv2.SimpleBlobDetector
-            cv::SimpleBlobDetector::Params params;
-
-            // Set inertia filtering parameters
-            params.filterByInertia = true;
-            params.minInertiaRatio = 0.01;
-
-            // Set Convexity filtering parameters
-            params.filterByConvexity = true;
-            params.minConvexity = 0.2;
-
-            params.filterByColor = false;
-
-            // Set Area filtering parameters
-            params.filterByArea = true;
-            params.minArea = 200.0f;
-            params.maxArea = 350.0f;
+            // Convert images to gray scale;
+            Mat object_gray, scene_gray;
+            cvtColor(image_object, object_gray, COLOR_BGR2GRAY);
+            cvtColor(image_scene, scene_gray, COLOR_BGR2GRAY);
+
+            // Build the pyramids, index 0 is full resolution
+            int levels = std::max(1, options.levels);
+            std::vector<Mat> object_pyramid, scene_pyramid;
+            buildPyramid(object_gray, object_pyramid, levels - 1);
+            buildPyramid(scene_gray, scene_pyramid, levels - 1);
+
+            // ECC warps map template (object) coordinates to input (scene) coordinates;
+            // the seed is scaled to the coarsest level
+            Mat warp_matrix;
+            WarpAtLevel(h_obj_to_scene, levels - 1).convertTo(warp_matrix, CV_32F);
+
+            // Few iterations per level; the seed is already close
+            TermCriteria criteria(TermCriteria::COUNT + TermCriteria::EPS, options.iterations, options.termination_eps);
+            int last_level = options.refine_full_resolution ? 0 : std::min(1, levels - 1);
+            int warp_level = levels - 1;
+            bool refined = false;
+            for (int level = levels - 1; level >= last_level; level--) {
+                Mat level_warp = warp_matrix.clone();
+                try {
+                    findTransformECC(object_pyramid[level], scene_pyramid[level], level_warp, MOTION_HOMOGRAPHY,
+                                     criteria, noArray(), options.gauss_filt_size);
+                } catch (const cv::Exception &e) {
+                    // ECC diverged; keep the estimate from the previous level
+                    std::cout << "RefineHomographyECC: stopped at level " << level << ": " << e.what() << std::endl;
+                    break;
+                }
+                warp_matrix = level_warp;
+                refined = true;
+
+                // Carry the warp to the next finer level
+                if (level > last_level) {
+                    warp_matrix.at<float>(0, 2) *= 2.0f;
+                    warp_matrix.at<float>(1, 2) *= 2.0f;
+                    warp_matrix.at<float>(2, 0) /= 2.0f;
+                    warp_matrix.at<float>(2, 1) /= 2.0f;
+                    warp_level = level - 1;
+                }
+            }
+
+            if (!refined) {
+                return h_obj_to_scene.clone();
+            }
+
+            // Compare with the seed where the warp ended up, on the same smoothed images
+            Mat level_seed = WarpAtLevel(h_obj_to_scene, warp_level);
+            Mat level_refined;
+            warp_matrix.convertTo(level_refined, CV_64F);
+            double seed_correlation = WarpCorrelation(object_pyramid[warp_level], scene_pyramid[warp_level],
+                                                      level_seed, options.gauss_filt_size);
+            double refined_correlation = WarpCorrelation(object_pyramid[warp_level], scene_pyramid[warp_level],
+                                                         level_refined, options.gauss_filt_size);
+
+            // Bring the warp back to full resolution
+            Mat result = WarpFromLevel(warp_matrix, warp_level);
+            double shift = CornerShift(image_object.size(), h_obj_to_scene, result);
+            if (refined_correlation < seed_correlation || shift > options.max_corner_shift) {
+                std::cout << "RefineHomographyECC: kept the seed, correlation " << refined_correlation << " vs "
+                          << seed_correlation << ", corners moved " << shift << " px" << std::endl;
+                return h_obj_to_scene.clone();
+            }
+            return result;
+        }
 
-            // Set Circularity filtering parameters
-            params.filterByCircularity = false;
-            params.minCircularity = 0.2;
+        //================================================
+        // Member Function: FindBlob
+        //  Note: Draws the holes found by HoleDetector
+        //================================================
+        Mat FindBlob(const cv::Mat &source) {
 
-            cv::Ptr<cv::SimpleBlobDetector> detector = cv::SimpleBlobDetector::create(params);
-            std::vector<KeyPoint> keypoints;
-            detector->detect(source, keypoints);
+            HoleDetector detector;
+            std::vector<HoleRecord> holes = detector.Detect(source);
 
-            Mat source_keypoint;
-            drawKeypoints(source, keypoints, source_keypoint, Scalar(0, 0, 255), DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
+            Mat source_keypoint = source.clone();
+            for (const HoleRecord &hole : holes) {
+                circle(source_keypoint, hole.center, cvRound(hole.radius), Scalar(0, 0, 255), 1, LINE_AA);
+                circle(source_keypoint, hole.center, 1, Scalar(0, 0, 255), FILLED);
+            }
 
             return source_keypoint;
         }
 
         //================================================
         // Member Function: AdjustBrightness
+        //  Note: Matches the HSV saturation statistics of target to source, see
+        //        ColorTransfer. Finders keep the template side in TemplatePack.
         //================================================
         Mat AdjustBrightness(const cv::Mat &source, const cv::Mat &target) {
 
-            // Convert to HSV image
-            Mat source_hsv, target_hsv;
-            cvtColor(source, source_hsv, COLOR_BGR2HSV);
-            cvtColor(target, target_hsv, COLOR_BGR2HSV);
-
-            // compute color statistics for the source and target images
-            Image_Stat stat_source = GetStat(source_hsv);
-            Image_Stat stat_target = GetStat(target_hsv);
-
-            // subtract the means from the target image
-            target_hsv -= Scalar(0, stat_target.mean->at<float>(1), 0); // less red.
-
-            // scale by the standard deviations
-            float scale_ratio = stat_target.stddev->at<float>(1) / stat_source.stddev->at<float>(1);
-            target_hsv = target_hsv.mul(cv::Scalar(1, scale_ratio, 1));
-
-            // add in the source mean
-            target_hsv += Scalar(0, stat_source.mean->at<float>(1), 0);
-
-            // clip the pixel intensities to [0, 255] if they fall outside
-            target_hsv.setTo(255, target > 255);
-
-            // Convert back to BGR image file
-            Mat  target_bgr;
-            cvtColor(target_hsv, target_bgr, COLOR_HSV2BGR);
-
+            ColorTransfer color_transfer;
+            color_transfer.SetReference(source);
+            Mat target_bgr;
+            color_transfer.Apply(target, target_bgr);
             return target_bgr;
         }
 
         //================================================
-        // Member Function: GetStat
+        // Member Function: CreateMarkerMask
+        //  Note: Non-zero over the location markers: the top band right of left_margin
+        //        and the bottom band left of the "made in USA" logo. The center scoring
+        //        area is left out, its features never help the homography.
         //================================================
-        Image_Stat GetStat(const Mat &src) {
+        Mat CreateMarkerMask(Size template_size, double top_margin, double left_margin) {
+
+            int width = template_size.width;
+            int height = template_size.height;
+            int band = cvRound(height * top_margin);
+            int left = cvRound(width * left_margin);
+            int right = cvRound(width * (1.0 - left_margin));
+
+            Mat mask = Mat::zeros(template_size, CV_8U);
+            mask(Rect(left, 0, width - left, band)).setTo(255);
+            mask(Rect(0, height - band, right, band)).setTo(255);
+            return mask;
+        }
 
-            // Split the image into 3 channels (RGB)
-            Mat channels[3];
-            split(src, channels);
+        //================================================
+        // Member Function: OrderCorners
+        //  Note: Four corners of a quad in the order of TemplatePack::corners(): top left,
+        //        top right, bottom right, bottom left. Assumes a rotation under 45 degrees.
+        //================================================
+        std::vector<Point2f> OrderCorners(const std::vector<Point2f> &corners) {
+
+            auto extreme = [&corners](auto key) {
+                return *std::min_element(corners.begin(), corners.end(), [&key](const Point2f &a, const Point2f &b) {
+                    return key(a) < key(b);
+                });
+            };
+            return {extreme([](const Point2f &p) { return p.x + p.y; }),
+                    extreme([](const Point2f &p) { return p.y - p.x; }),
+                    extreme([](const Point2f &p) { return -(p.x + p.y); }),
+                    extreme([](const Point2f &p) { return p.x - p.y; })};
+        }
+
+        //================================================
+        // Member Function: CreateFeatureDetector
+        //================================================
+        Ptr<Feature2D> CreateFeatureDetector(FeatureDetectorType detector_type, int max_features) {
+
+            switch (detector_type) {
+                case FeatureDetectorType::Detect_FAST:
+                    return FastFeatureDetector::create();
+                case FeatureDetectorType::Detect_ORB:
+                    return ORB::create(max_features);
+                case FeatureDetectorType::Detect_SIFT:
+                default:
+                    return SIFT::create();
+            }
+        }
 
-            // Get the mean and standard deviation of each channel
-            Image_Stat stat;
-            meanStdDev(channels[0], stat.mean[0], stat.stddev[0]);
-            meanStdDev(channels[1], stat.mean[1], stat.stddev[1]);
-            meanStdDev(channels[2], stat.mean[2], stat.stddev[2]);
+        //================================================
+        // Member Function: CreateFeatureExtractor
+        //================================================
+        Ptr<Feature2D> CreateFeatureExtractor(FeatureExtractType extract_type, int max_features) {
+
+            switch (extract_type) {
+                case FeatureExtractType::Extract_FAST:
+                    return FastFeatureDetector::create();
+                case FeatureExtractType::Extract_ORB:
+                    return ORB::create(max_features);
+                case FeatureExtractType::Extract_SIFT:
+                default:
+                    return SIFT::create();
+            }
+        }
 
-            // return the color statistics
-            return stat;
+        //================================================
+        // Member Function: CreateDescriptorMatcher
+        //  Note: SIFT descriptors are floating point (FLANN KD-tree); ORB/FAST are binary
+        //        (FLANN LSH or brute force Hamming)
+        //================================================
+        Ptr<DescriptorMatcher> CreateDescriptorMatcher(MatchType match_type, FeatureExtractType extract_type) {
+
+            switch (match_type) {
+                case MatchType::Match_FLANN:
+                    if (extract_type == FeatureExtractType::Extract_SIFT) {
+                        return DescriptorMatcher::create(DescriptorMatcher::FLANNBASED);
+                    }
+                    return cv::makePtr<cv::FlannBasedMatcher>(cv::makePtr<cv::flann::LshIndexParams>(12, 20, 2));
+                case MatchType::Match_BRUTEFORCE:
+                case MatchType::Match_HAMMING:      // OpenCV stand-ins; the finder uses HammingMatcher
+                case MatchType::Match_ROOTSIFT:     // and RootSiftMatcher
+                default:
+                    return DescriptorMatcher::create("BruteForce-Hamming");
+            }
         }
     }
 } // TactNib
\ No newline at end of file
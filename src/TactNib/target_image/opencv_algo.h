@@ -18,20 +18,35 @@
 #include <opencv2/features2d.hpp>
 #include <opencv2/opencv.hpp>
 
+#include "color_transfer.h"
+#include "finder_config.h"
+
 using namespace cv;
 
 namespace TactNib {
     namespace OpencvAlgo {
-        struct Image_Stat {
-            cv::Mat mean[3];
-            cv::Mat stddev[3];
+        // Coarse-to-fine ECC refinement settings, see RefineHomographyECC
+        struct EccOptions {
+            int levels = 3;                     // pyramid levels, level 0 is full resolution
+            bool refine_full_resolution = false; // also run ECC on level 0
+            int iterations = 30;                // per level
+            double termination_eps = 1e-4;      // per level
+            int gauss_filt_size = 5;
+            double max_corner_shift = 8.0;      // scene pixels; a larger correction is rejected
         };
 
         Mat FindBlob(const Mat &);
         Mat AlignImageMotion(const Mat &im1, const Mat &im2);
+        Mat RefineHomographyECC(const Mat &image_object, const Mat &image_scene, const Mat &h_obj_to_scene,
+                                const EccOptions &options = EccOptions());
         Scalar GetMSSIM(const Mat &, const Mat &);
+        Scalar GetMSSIMReference(const Mat &, const Mat &);
         Mat AdjustBrightness(const Mat &, const Mat &);
-        Image_Stat GetStat(const Mat &);
+        Mat CreateMarkerMask(Size template_size, double top_margin, double left_margin);
+        std::vector<Point2f> OrderCorners(const std::vector<Point2f> &corners);
+        Ptr<Feature2D> CreateFeatureDetector(FeatureDetectorType, int max_features = 500);
+        Ptr<Feature2D> CreateFeatureExtractor(FeatureExtractType, int max_features = 500);
+        Ptr<DescriptorMatcher> CreateDescriptorMatcher(MatchType, FeatureExtractType);
 
     }// OpencvAlgo
 } // TactNib
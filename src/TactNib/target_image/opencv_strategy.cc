@@ -12,16 +12,58 @@
  *
  * ============================================================================*/
 
-#include <chrono>
 #include "opencv_algo.h"
 #include "opencv_strategy.h"
 #include "target_object_image.h"
 #include "enum_support.h"
-
-using namespace std::chrono;
+#include "finder_workspace.h"
+#include "hamming_matcher.h"
+#include "root_sift_matcher.h"
+#include "trace.h"
 
 namespace TactNib {
 
+    namespace {
+        // Query rows matched per call to an OpenCV matcher, between cancel checks
+        const int kMatchChunk = 1024;
+
+        // Matches of scene queries against the template index, as template -> scene
+        void FlipMatches(std::vector<DMatch> &matches)
+        {
+            for (DMatch &match : matches) {
+                std::swap(match.queryIdx, match.trainIdx);
+            }
+        }
+
+        void ShiftQueries(DMatch &match, int offset)
+        {
+            match.queryIdx += offset;
+        }
+
+        void ShiftQueries(std::vector<DMatch> &neighbours, int offset)
+        {
+            for (DMatch &match : neighbours) {
+                match.queryIdx += offset;
+            }
+        }
+
+        // match(rows, results) on kMatchChunk query rows at a time until cancel fires;
+        // queryIdx is shifted back to rows of query
+        template<typename Result, typename Match>
+        void MatchInChunks(const Mat &query, const CancelToken &cancel, std::vector<Result> &results, Match match)
+        {
+            results.clear();
+            std::vector<Result> chunk;
+            for (int first = 0; first < query.rows && !cancel.StopRequested(); first += kMatchChunk) {
+                match(query.rowRange(first, std::min(first + kMatchChunk, query.rows)), chunk);
+                for (Result &result : chunk) {
+                    ShiftQueries(result, first);
+                    results.push_back(std::move(result));
+                }
+            }
+        }
+    }
+
 
     //================================================
     // Default constructor
@@ -44,155 +86,284 @@ namespace TactNib {
         //     3) Detect_ORB,  Extract_ORB,  Match_BRUTEFORCE, Filter_SCORE # Score: 63.3  Time 4.8s
         //     4) Detect_ORB,  Extract_ORB,  Match_FLANN,      Filter_SCORE # Score: 63.3  Time 3.7s
 
-
-        // Move this configuration logic into a config file
-        FeatureDetectorType detector_type = TactNib::FeatureDetectorType::Detect_SIFT;
-        FeatureExtractType extract_type = TactNib::FeatureExtractType::Extract_SIFT;
-        MatchType match_type = TactNib::MatchType::Match_FLANN;
-        FilterType filter_type = TactNib::FilterType::Filter_LOWES;
+        TargetObjectImage target_object;
+        if (!PrepareTemplate()) {
+            return target_object;
+        }
 
         // Convert jpg file to opencv matrix
-        Mat image_scene = imread(image_scene_file_, IMREAD_COLOR);
-        Mat image_object = imread(image_target_file_, IMREAD_COLOR);
+        SceneContext context;
+        context.cancel = cancel_;
+        std::string scene_name = scene_source_.name();
+        context.label = scene_name.substr(scene_name.find_last_of('/') + 1);
+        context.label = context.label.substr(0, context.label.find_last_of('.'));
+
+        // PrepareScene scales the scene to the template height, so a JPEG only needs to be
+        // decoded that large
+        TraceScope trace_load("scene_load");
+        context.image_scene = scene_source_.DecodeForHeight(active_template_->image().rows);
+        trace_load.End();
+        if (context.image_scene.empty()) {
+            std::cout << "Unable to read scene image " << scene_name << std::endl;
+            return target_object;
+        }
+        Size source_size = scene_source_.FullSize();
+        context.source_scale = Point2d(static_cast<double>(source_size.width) / context.image_scene.cols,
+                                       static_cast<double>(source_size.height) / context.image_scene.rows);
+
+        PrepareScene(context);
+
+        TraceScope trace_total("find_target");
+        DetectFeatures(context);
+        MatchFeatures(context);
+        EstimateHomography(context);
+        RefineAlignment(context);
+        WarpAndScore(context);
+
+        std::cout << "Total : Summary compute time is  " << trace_total.End() << " s" << std::endl;
+        std::cout << "Image Similarity: " << context.score << std::endl;
+
+        return MakeResult(context);
+    }
+
+    //================================================
+    // Member Function: PrepareTemplate
+    //================================================
+    bool OpenCvStrategy::PrepareTemplate() {
+
+        // A template pack replaces decoding and analyzing the template; its keypoints and
+        // descriptors are only usable when they were built with the configured algorithms
+        if (template_pack_ && template_pack_->Supports(config_.detector_type, config_.extract_type)) {
+            active_template_ = template_pack_;
+            return true;
+        }
+        // Otherwise the pack's own analysis for config_ is shared by every strategy using
+        // the pack, as long as it was built for the same ROI setting
+        if (template_pack_ && config_.template_roi == !template_pack_->roi_mask().empty()) {
+            active_template_ = template_pack_->GetVariant(config_.detector_type, config_.extract_type,
+                                                          config_.max_features);
+            return active_template_ != nullptr;
+        }
+        // An analysis of template_pack_'s image shares its pixels; the pack changes when a
+        // library routes the next scene to another template
+        if (active_template_ && active_template_->Supports(config_.detector_type, config_.extract_type) &&
+            (!template_pack_ || active_template_->image().data == template_pack_->image().data)) {
+            return true;
+        }
+
+        Mat image_object = template_pack_ ? template_pack_->image() : target_source_.Decode();
+        if (image_object.empty()) {
+            std::cout << "Unable to read template image " << target_source_.name() << std::endl;
+            return false;
+        }
+
+        // Only the location markers are worth detecting, see Step 6
+        Mat roi_mask;
+        if (config_.template_roi) {
+            roi_mask = OpencvAlgo::CreateMarkerMask(image_object.size(), config_.marker_top_margin,
+                                                    config_.marker_left_margin);
+        }
+        active_template_ = TemplatePack::Create(image_object, config_.detector_type, config_.extract_type,
+                                                config_.max_features, roi_mask);
+        return active_template_ != nullptr;
+    }
+
+    //================================================
+    // Member Function: PrepareScene
+    //================================================
+    void OpenCvStrategy::PrepareScene(SceneContext &context) const {
+
+        if (Stopped(context)) {
+            return;
+        }
+        const Mat &image_object = active_template_->image();
+        const ColorTransfer &color_transfer = active_template_->color_transfer();
+        FinderWorkspace &workspace = FinderWorkspace::ForThread(config_);
 
         // Adjust the brightness of scene image to match the object image
-        image_scene = OpencvAlgo::AdjustBrightness(image_object, image_scene);
+        Mat image_bright = context.image_scene;
+        if (!config_.brightness_scaled) {
+            TraceScope trace_brightness("brightness");
+            Mat &buffer = workspace.brightness_buffer();
+            color_transfer.Apply(context.image_scene, buffer);
+            image_bright = buffer;
+            trace_brightness.End();
+        }
 
         // Get image template size
         cv::Size sz = image_object.size();
         int template_height = sz.height;
         int template_width = sz.width;
         std::cout << "Object Image: width - " << template_width << " height - " << template_height << std::endl;
-        sz = image_scene.size();
+        sz = image_bright.size();
         int scene_height = sz.height;
         int scene_width = sz.width;
         std::cout << "Scene Image: width - " << scene_width << " height - " << scene_height << std::endl;
 
         // Scale scene image to match size of template; for comparison purposes
-        Mat scale_image;
+        TraceScope trace_scale("scale");
+        // into a pooled buffer of the size resize computes, so it is not reallocated
         double scale = static_cast< double > (template_height) / scene_height;
-        resize(image_scene, scale_image, Size(), scale, scale, INTER_LINEAR);
-        image_scene = scale_image.clone();
+        Size scale_size(saturate_cast<int>(scene_width * scale), saturate_cast<int>(scene_height * scale));
+        Mat scale_image = workspace.scene_pool().Acquire(scale_size, image_bright.type());
+        resize(image_bright, scale_image, Size(), scale, scale, INTER_LINEAR);
+        context.image_scene = scale_image;
+        context.source_scale.x *= static_cast<double>(scene_width) / scale_size.width;
+        context.source_scale.y *= static_cast<double>(scene_height) / scale_size.height;
+        trace_scale.End();
+
+        // The pooled buffer is ours, so normalize it in place
+        if (config_.brightness_scaled) {
+            TraceScope trace_brightness("brightness");
+            color_transfer.Apply(context.image_scene, context.image_scene);
+        }
+    }
+
+    //================================================
+    // Member Function: DetectFeatures
+    //================================================
+    void OpenCvStrategy::DetectFeatures(SceneContext &context) const {
 
-        // Variables to store keypoints and descriptors
-        std::vector<KeyPoint> keypoints_scene, keypoints_object;
-        Mat descriptors_scene, descriptors_object;
-        std::vector<Point2f> points_scene, points_object;
-        std::vector<DMatch> matches;
-        std::vector<std::vector<DMatch> > knn_matches;
+        // Template keypoints and descriptors come from active_template_
+        FeatureDetectorType detector_type = config_.detector_type;
+        FeatureExtractType extract_type = config_.extract_type;
+        if (!context.valid || Stopped(context)) {
+            return;
+        }
+        FinderWorkspace &workspace = FinderWorkspace::ForThread(config_);
 
         // Step 1: Detect features in scene and object image
-        auto start_time = time_point_cast<milliseconds>(system_clock::now());
-        auto start_time_summary = time_point_cast<milliseconds>(system_clock::now());
+        TraceScope trace_detect("detect");
         std::cout << "Step 1: Detect features in image: " << detector_type << std::endl;
-        const int MAX_FEATURES = 500;
-        switch (detector_type) {
-            case FeatureDetectorType::Detect_FAST: {
-                Ptr<FastFeatureDetector> detector_ff = FastFeatureDetector::create();
-                detector_ff->detect(image_scene, keypoints_scene);
-                detector_ff->detect(image_object, keypoints_object);
-                break;
-            }
-            case FeatureDetectorType::Detect_SIFT: {
-                Ptr<cv::SIFT> detector_sift = SIFT::create();
-                detector_sift->detect(image_scene, keypoints_scene);
-                detector_sift->detect(image_object, keypoints_object);
-                break;
-            }
-            case FeatureDetectorType::Detect_ORB: {
-                Ptr<Feature2D> detector_orb = ORB::create(MAX_FEATURES);
-                detector_orb->detect(image_scene, keypoints_scene);
-                detector_orb->detect(image_object, keypoints_object);
-                break;
-            }
-            default: {
-                Ptr<cv::SIFT> detector_sift2 = SIFT::create();
-                detector_sift2->detect(image_scene, keypoints_scene);
-                detector_sift2->detect(image_object, keypoints_object);
-                break;
-            }
+        Mat scene_mask = SceneRoiMask(context, workspace.mask_buffer());
+        workspace.detector().detect(context.image_scene, context.keypoints_scene, scene_mask);
+        std::cout << "Step 1: Compute time is  " << trace_detect.End() << " s" << std::endl;
+        if (Stopped(context)) {
+            return;
         }
-        auto end_time = time_point_cast<milliseconds>(system_clock::now());
-        std::cout << "Step 1: Compute time is  " << (end_time - start_time).count() / 1000.0 << " s" << std::endl;
 
         // Step 2: Extract features in images
         std::cout << "Step 2: Extract features in image: " << extract_type << std::endl;
-        start_time = time_point_cast<milliseconds>(system_clock::now());
-        switch (extract_type) {
-            case FeatureExtractType::Extract_FAST: {
-                Ptr<FastFeatureDetector> detector_ff = FastFeatureDetector::create();
-                detector_ff->compute(image_scene, keypoints_scene, descriptors_scene);
-                detector_ff->compute(image_object, keypoints_object, descriptors_object);
-                break;
-            }
-            case FeatureExtractType::Extract_SIFT: {
-                Ptr<SIFT> detector_sift = SIFT::create();
-                detector_sift->compute(image_scene, keypoints_scene, descriptors_scene);
-                detector_sift->compute(image_object, keypoints_object, descriptors_object);
-                break;
-            }
-            case FeatureExtractType::Extract_ORB: {
-                Ptr<Feature2D> detector_orb = ORB::create(MAX_FEATURES);
-                detector_orb->compute(image_scene, keypoints_scene, descriptors_scene);
-                detector_orb->compute(image_object, keypoints_object, descriptors_object);
-                break;
-            }
-            default: {
-                Ptr<cv::SIFT> detector_sift2 = SIFT::create();
-                detector_sift2->compute(image_scene, keypoints_scene, descriptors_scene);
-                detector_sift2->compute(image_object, keypoints_object, descriptors_object);
-                break;
-            }
+        TraceScope trace_extract("extract");
+        workspace.extractor().compute(context.image_scene, context.keypoints_scene, context.descriptors_scene);
+        std::cout << "Step 2: Compute time is  " << trace_extract.End() << " s" << std::endl;
+    }
+
+    //================================================
+    // Member Function: MatchFeatures
+    //================================================
+    void OpenCvStrategy::MatchFeatures(SceneContext &context) const {
+
+        FeatureExtractType extract_type = config_.extract_type;
+        MatchType match_type = config_.match_type;
+        FilterType filter_type = config_.filter_type;
+
+        const Mat &image_object = active_template_->image();
+        const std::vector<KeyPoint> &keypoints_object = active_template_->keypoints();
+        const Mat &descriptors_object = active_template_->descriptors();
+        const Mat &image_scene = context.image_scene;
+        const std::vector<KeyPoint> &keypoints_scene = context.keypoints_scene;
+        const Mat &descriptors_scene = context.descriptors_scene;
+        std::vector<DMatch> &matches = context.matches;
+        std::vector<std::vector<DMatch> > &knn_matches = context.knn_matches;
+        Mat &image_matches = context.image_matches;
+
+        if (!context.valid || Stopped(context)) {
+            return;
+        }
+        if (descriptors_scene.empty() || descriptors_object.empty()) {
+            std::cout << "Step 3: No descriptors to match" << std::endl;
+            context.valid = false;
+            return;
         }
-        end_time = time_point_cast<milliseconds>(system_clock::now());
-        std::cout << "Step 2: Compute time is  " << (end_time - start_time).count() / 1000.0 << " s" << std::endl;
 
         // Step 3: Match descriptors together
         std::cout << "Step 3: Match descriptors together: " << match_type << std::endl;
-        start_time = time_point_cast<milliseconds>(system_clock::now());
-        switch (match_type) {
-            case MatchType::Match_BRUTEFORCE: {
-                Ptr<DescriptorMatcher> matcher = DescriptorMatcher::create("BruteForce-Hamming");
-                if (extract_type == FeatureExtractType::Extract_SIFT) {
-                    matcher->knnMatch(descriptors_object, descriptors_scene, knn_matches, 2);
-                } else {
-                    matcher->match(descriptors_object, descriptors_scene, matches, Mat());
+        TraceScope trace_match("match");
+
+        // SIFT, and ORB with the Hamming matcher, keep two neighbours for Lowe's ratio test;
+        // the other matchers only the nearest one
+        bool knn = extract_type == FeatureExtractType::Extract_SIFT ||
+                   (match_type == MatchType::Match_HAMMING && filter_type == FilterType::Filter_LOWES);
+        if (match_type == MatchType::Match_HAMMING) {
+            HammingMatchOptions hamming_options;
+            hamming_options.cross_check = config_.cross_check;
+            hamming_options.cancel = context.cancel;
+            HammingMatcher matcher(hamming_options);
+            if (knn) {
+                matcher.KnnMatch2(descriptors_object, descriptors_scene, knn_matches);
+            } else {
+                matcher.Match(descriptors_object, descriptors_scene, matches);
+            }
+        } else if (match_type == MatchType::Match_ROOTSIFT) {
+            // Like FLANN, the template side is quantized and indexed once, in the pack,
+            // and the scene descriptors are the queries
+            std::shared_ptr<const RootSiftIndex> index = active_template_->GetRootSiftIndex();
+            if (index == nullptr) {
+                context.valid = false;
+                return;
+            }
+            RootSiftMatchOptions rootsift_options;
+            rootsift_options.probes = config_.rootsift_probes;
+            rootsift_options.cancel = context.cancel;
+            RootSiftMatcher matcher(rootsift_options);
+            if (knn) {
+                matcher.KnnMatch2(descriptors_scene, *index, knn_matches);
+                for (std::vector<DMatch> &neighbours : knn_matches) {
+                    FlipMatches(neighbours);
                 }
-                break;
+            } else {
+                matcher.Match(descriptors_scene, *index, matches);
+                FlipMatches(matches);
             }
-            case MatchType::Match_FLANN: {
-                if (extract_type == FeatureExtractType::Extract_SIFT) {
-                    Ptr<DescriptorMatcher> matcher = DescriptorMatcher::create(DescriptorMatcher::FLANNBASED);
-                    // matcher->knnMatch(descriptors_scene, descriptors_object, knn_matches, 2);
-                    matcher->knnMatch(descriptors_object, descriptors_scene, knn_matches, 2);
-                } else {
-                    Ptr<DescriptorMatcher> matcher = cv::makePtr<cv::FlannBasedMatcher>(
-                            cv::makePtr<cv::flann::LshIndexParams>(12, 20, 2));
-                    matcher->match(descriptors_object, descriptors_scene, matches, Mat());
+        } else if (match_type == MatchType::Match_FLANN) {
+            // The FLANN index is built once over the template descriptors, which stay the
+            // same from frame to frame, and the scene descriptors are the queries
+            DescriptorMatcher &matcher = FinderWorkspace::ForThread(config_).TemplateMatcher(active_template_);
+            if (knn) {
+                MatchInChunks(descriptors_scene, context.cancel, knn_matches,
+                              [&matcher](const Mat &rows, std::vector<std::vector<DMatch>> &chunk) {
+                                  matcher.knnMatch(rows, chunk, 2);
+                              });
+                for (std::vector<DMatch> &neighbours : knn_matches) {
+                    FlipMatches(neighbours);
                 }
-
-                break;
+            } else {
+                MatchInChunks(descriptors_scene, context.cancel, matches,
+                              [&matcher](const Mat &rows, std::vector<DMatch> &chunk) { matcher.match(rows, chunk); });
+                FlipMatches(matches);
             }
-            default: {
-                Ptr<DescriptorMatcher> matcher = DescriptorMatcher::create("BruteForce-Hamming");
-                matcher->match(descriptors_object, descriptors_scene, matches, Mat());
-                break;
+        } else {
+            // The workspace matcher was built for match_type and extract_type, see CreateDescriptorMatcher
+            DescriptorMatcher &matcher = FinderWorkspace::ForThread(config_).matcher();
+            if (knn) {
+                // matcher->knnMatch(descriptors_scene, descriptors_object, knn_matches, 2);
+                MatchInChunks(descriptors_object, context.cancel, knn_matches,
+                              [&](const Mat &rows, std::vector<std::vector<DMatch>> &chunk) {
+                                  matcher.knnMatch(rows, descriptors_scene, chunk, 2);
+                              });
+            } else {
+                MatchInChunks(descriptors_object, context.cancel, matches,
+                              [&](const Mat &rows, std::vector<DMatch> &chunk) {
+                                  matcher.match(rows, descriptors_scene, chunk, Mat());
+                              });
             }
         }
-        end_time = time_point_cast<milliseconds>(system_clock::now());
-        std::cout << "Step 3: Compute time is  " << (end_time - start_time).count() / 1000.0 << " s" << std::endl;
+        std::cout << "Step 3: Compute time is  " << trace_match.End() << " s" << std::endl;
+        if (Stopped(context)) {
+            return;
+        }
 
         // Step 4: Filter descriptors to improve results
         std::cout << "Step 4: Filter descriptors to improve results: " << filter_type << std::endl;
-        start_time = time_point_cast<milliseconds>(system_clock::now());
-        Mat image_matches;
+        TraceScope trace_filter("filter");
         switch (filter_type) {
             case FilterType::Filter_SCORE: {
-                if (extract_type == FeatureExtractType::Extract_SIFT) {
+                if (knn) {
                     std::cout << "NOT SUPPORTED: FILTER type SCORE does not support SIFT " << matches.size()
                               << std::endl;
                 } else {
-                    const float GOOD_MATCH_PERCENT = 0.15f;
+                    const double GOOD_MATCH_PERCENT = config_.good_match_percent;
                     // Sort matches by score
                     std::cout << "Step 4a: Filter the matches: size = " << matches.size() << std::endl;
                     std::sort(matches.begin(), matches.end());
@@ -202,20 +373,23 @@ namespace TactNib {
                     matches.erase(matches.begin() + numGoodMatches, matches.end());
 
                     // Draw top matches
-                    drawMatches(image_object, keypoints_object, image_scene, keypoints_scene, matches, image_matches);
-                    imwrite("matches.jpg", image_matches);
+                    if (display_images_) {
+                        drawMatches(image_object, keypoints_object, image_scene, keypoints_scene, matches, image_matches);
+                        imwrite("matches.jpg", image_matches);
+                    }
                     break;
                 }
             }
             case FilterType::Filter_LOWES: {
-                if (extract_type == FeatureExtractType::Extract_SIFT) {
+                if (knn) {
 
                     //-- Filter matches using the Lowe's ratio test
                     std::cout << "Step 4a: Filter matches using Lowe's ratio test: size - " << knn_matches.size()
                               << std::endl;
-                    const float ratio_thresh = 0.55f;
+                    const float ratio_thresh = static_cast<float>(config_.lowes_ratio);
                     for (size_t i = 0; i < knn_matches.size(); i++) {
-                        if (knn_matches[i][0].distance < ratio_thresh * knn_matches[i][1].distance) {
+                        if (knn_matches[i].size() > 1 &&
+                            knn_matches[i][0].distance < ratio_thresh * knn_matches[i][1].distance) {
                             matches.push_back(knn_matches[i][0]);
                         }
                     }
@@ -224,14 +398,16 @@ namespace TactNib {
 
                     //drawMatches(image_scene, keypoints_scene, image_object, keypoints_object, matches, image_matches, Scalar::all(-1),
                     //            Scalar::all(-1), std::vector<char>(), DrawMatchesFlags::NOT_DRAW_SINGLE_POINTS);
-                    drawMatches(image_object, keypoints_object, image_scene, keypoints_scene, matches, image_matches,
-                                Scalar::all(-1),
-                                Scalar::all(-1), std::vector<char>(), DrawMatchesFlags::NOT_DRAW_SINGLE_POINTS);
-                    //-- Show detected matches
-                    imshow("Good Matches", image_matches);
+                    if (display_images_) {
+                        drawMatches(image_object, keypoints_object, image_scene, keypoints_scene, matches, image_matches,
+                                    Scalar::all(-1),
+                                    Scalar::all(-1), std::vector<char>(), DrawMatchesFlags::NOT_DRAW_SINGLE_POINTS);
+                        //-- Show detected matches
+                        imshow("Good Matches", image_matches);
+                    }
                 } else {
-                    std::cout << "NOT SUPPORTED: FILTER type LOWES does not support ORB/FAST " << matches.size()
-                              << std::endl;
+                    std::cout << "NOT SUPPORTED: FILTER type LOWES needs SIFT or the HAMMING matcher "
+                              << matches.size() << std::endl;
                 }
                 break;
             }
@@ -240,12 +416,45 @@ namespace TactNib {
                 break;
             }
         }
-        end_time = time_point_cast<milliseconds>(system_clock::now());
-        std::cout << "Step 4: Compute time is  " << (end_time - start_time).count() / 1000.0 << " s" << std::endl;
+        std::cout << "Step 4: Compute time is  " << trace_filter.End() << " s" << std::endl;
+
+        // Draw the matches on the debug writer thread, not here
+        if (debug_sink_ != nullptr) {
+            std::shared_ptr<const TemplatePack> object = active_template_;
+            Mat scene = context.image_scene;
+            std::vector<KeyPoint> scene_keypoints = keypoints_scene;
+            std::vector<DMatch> good_matches = matches;
+            debug_sink_->Submit(DebugLabel(context), "matches", [object, scene, scene_keypoints, good_matches]() {
+                Mat image;
+                drawMatches(object->image(), object->keypoints(), scene, scene_keypoints, good_matches, image,
+                            Scalar::all(-1), Scalar::all(-1), std::vector<char>(),
+                            DrawMatchesFlags::NOT_DRAW_SINGLE_POINTS);
+                return image;
+            });
+        }
+    }
+
+    //================================================
+    // Member Function: EstimateHomography
+    //================================================
+    void OpenCvStrategy::EstimateHomography(SceneContext &context) const {
+
+        const Mat &image_object = active_template_->image();
+        const std::vector<KeyPoint> &keypoints_object = active_template_->keypoints();
+        const std::vector<KeyPoint> &keypoints_scene = context.keypoints_scene;
+        const std::vector<DMatch> &matches = context.matches;
+        std::vector<Point2f> &points_scene = context.points_scene;
+        std::vector<Point2f> &points_object = context.points_object;
+        int template_height = image_object.rows;
+        int template_width = image_object.cols;
+
+        if (!context.valid || Stopped(context)) {
+            return;
+        }
 
         // Step 5: Convert matches to points array
         std::cout << "Step 5: Convert matches to points array: size = " << matches.size() << std::endl;
-        start_time = time_point_cast<milliseconds>(system_clock::now());
+        TraceScope trace_points("points");
         for (size_t i = 0; i < matches.size(); i++) {
             //    points_scene.push_back(keypoints_scene[matches[i].queryIdx].pt);
             //    points_object.push_back(keypoints_object[matches[i].trainIdx].pt);
@@ -253,111 +462,259 @@ namespace TactNib {
             points_scene.push_back(keypoints_scene[matches[i].trainIdx].pt);
             points_object.push_back(keypoints_object[matches[i].queryIdx].pt);
         }
-        end_time = time_point_cast<milliseconds>(system_clock::now());
-        std::cout << "Step 5: Compute time is  " << (end_time - start_time).count() / 1000.0 << " s" << std::endl;
+        std::cout << "Step 5: Compute time is  " << trace_points.End() << " s" << std::endl;
 
         // Step 6: Remove matches that are not in the top/bottom location of markers
         std::cout << "Step 6: Remove matches located where the location markers do not exist" << std::endl;
         std::cout << "        points1 size: " << points_scene.size() << "; points2 size: " << points_object.size()
                   << std::endl;
-        start_time = time_point_cast<milliseconds>(system_clock::now());
-        const double TOP_MARGIN = 0.14; // 14 percent
+        TraceScope trace_marker_filter("marker_filter");
+        const double TOP_MARGIN = config_.marker_top_margin; // 14 percent by default
         const double BOTTOM_MARGIN = 1.0 - TOP_MARGIN;
-        const double LEFT_MARGIN = 0.25;
+        const double LEFT_MARGIN = config_.marker_left_margin;
         const double RIGHT_MARGIN = 1.0 - LEFT_MARGIN;
-        for (unsigned short i = 0; auto point: points_object) {
-            // Filter out the center are of target and lower right hand corner (made in USA logo)
-            //    - for some reason, this step only improves the alignment by 2% instead of the expected
-            //      6%
-            if (((point.y > (template_height * TOP_MARGIN)) && (point.y < (template_height * BOTTOM_MARGIN))) ||
-                // center target
-                ((point.y > (template_height * BOTTOM_MARGIN)) && (point.x > (template_width * RIGHT_MARGIN))) ||
-                // lower right corner
-                ((point.y < (template_height * TOP_MARGIN)) &&
-                 (point.x < (template_width * LEFT_MARGIN))))     // upper right corner
-            {
-                points_object.erase(points_object.begin() + i);
-                points_scene.erase(points_scene.begin() + i);
-                i--;
+        const Mat &roi_mask = active_template_->roi_mask();
+        size_t kept = 0;
+        for (size_t i = 0; i < points_object.size(); i++) {
+            Point2f point = points_object[i];
+            bool discard;
+            if (!roi_mask.empty()) {
+                // Template keypoints were only detected inside the mask; this is a no-op
+                // unless the pack was built with other margins
+                int x = std::min(std::max(cvRound(point.x), 0), roi_mask.cols - 1);
+                int y = std::min(std::max(cvRound(point.y), 0), roi_mask.rows - 1);
+                discard = roi_mask.at<uchar>(y, x) == 0;
+            } else {
+                // Filter out the center are of target and lower right hand corner (made in USA logo)
+                //    - for some reason, this step only improves the alignment by 2% instead of the expected
+                //      6%
+                discard = ((point.y > (template_height * TOP_MARGIN)) &&
+                           (point.y < (template_height * BOTTOM_MARGIN))) ||
+                          // center target
+                          ((point.y > (template_height * BOTTOM_MARGIN)) &&
+                           (point.x > (template_width * RIGHT_MARGIN))) ||
+                          // lower right corner
+                          ((point.y < (template_height * TOP_MARGIN)) &&
+                           (point.x < (template_width * LEFT_MARGIN)));     // upper right corner
             }
-            i++;
+
+            // Compact both arrays in place instead of erasing, which was quadratic
+            if (!discard) {
+                points_object[kept] = point;
+                points_scene[kept] = points_scene[i];
+                kept++;
+            }
+        }
+        points_object.resize(kept);
+        points_scene.resize(kept);
+        std::cout << "Step 6: Compute time is  " << trace_marker_filter.End() << " s" << std::endl;
+
+        // A homography needs at least four correspondences
+        if (points_object.size() < 4) {
+            std::cout << "Step 7: Not enough matches for a homography: " << points_object.size() << std::endl;
+            context.valid = false;
+            return;
         }
-        end_time = time_point_cast<milliseconds>(system_clock::now());
-        std::cout << "Step 6: Compute time is  " << (end_time - start_time).count() / 1000.0 << " s" << std::endl;
 
         // Step 7: Find homography
         std::cout << "Step 7: findHomography" << std::endl;
-        start_time = time_point_cast<milliseconds>(system_clock::now());
-        Mat h_scene_to_obj, h_obj_to_scene;
-        h_scene_to_obj = findHomography(points_scene, points_object, RANSAC);
-        h_obj_to_scene = findHomography(points_object, points_scene, RANSAC);
-        end_time = time_point_cast<milliseconds>(system_clock::now());
-        std::cout << "Step 7: Compute time is  " << (end_time - start_time).count() / 1000.0 << " s" << std::endl;
+        TraceScope trace_homography("homography");
+        Mat inlier_mask;
+        context.h_scene_to_obj = findHomography(points_scene, points_object, RANSAC, 3, inlier_mask);
+        if (Stopped(context) && !context.h_scene_to_obj.empty()) {
+            // Corners for the partial result without the second RANSAC run
+            context.h_obj_to_scene = context.h_scene_to_obj.inv();
+        } else {
+            context.h_obj_to_scene = findHomography(points_object, points_scene, RANSAC);
+        }
+        std::cout << "Step 7: Compute time is  " << trace_homography.End() << " s" << std::endl;
 
-        // Get the corners from the object image ( the object to be "detected" )
-        std::vector<Point2f> obj_corners(4);
-        obj_corners[0] = Point2f(0, 0);
-        obj_corners[1] = Point2f((float) image_object.cols, 0);
-        obj_corners[2] = Point2f((float) image_object.cols, (float) image_object.rows);
-        obj_corners[3] = Point2f(0, (float) image_object.rows);
-        std::vector<Point2f> scene_corners(4);
+        if (context.h_scene_to_obj.empty() || context.h_obj_to_scene.empty()) {
+            std::cout << "Step 7: Homography not found" << std::endl;
+            context.valid = false;
+            return;
+        }
+        context.inliers = countNonZero(inlier_mask);
+        std::cout << "Step 7: Inliers " << context.inliers << " of " << points_scene.size() << std::endl;
 
-        perspectiveTransform(obj_corners, scene_corners, h_obj_to_scene);
+        // Get the corners from the object image ( the object to be "detected" )
+        context.scene_corners.resize(4);
+        perspectiveTransform(active_template_->corners(), context.scene_corners, context.h_obj_to_scene);
 
         // Draw lines between the corners (the mapped object in the scene - image_2 )
-        line(image_matches, scene_corners[0] + Point2f((float) image_object.cols, 0),
-             scene_corners[1] + Point2f((float) image_object.cols, 0), Scalar(0, 255, 0), 16);
-        line(image_matches, scene_corners[1] + Point2f((float) image_object.cols, 0),
-             scene_corners[2] + Point2f((float) image_object.cols, 0), Scalar(0, 255, 0), 16);
-        line(image_matches, scene_corners[2] + Point2f((float) image_object.cols, 0),
-             scene_corners[3] + Point2f((float) image_object.cols, 0), Scalar(0, 255, 0), 16);
-        line(image_matches, scene_corners[3] + Point2f((float) image_object.cols, 0),
-             scene_corners[0] + Point2f((float) image_object.cols, 0), Scalar(0, 255, 0), 16);
-
-        //-- Show detected matches
-        imshow("Good Matches & Object detection", image_matches);
+        Mat &image_matches = context.image_matches;
+        const std::vector<Point2f> &scene_corners = context.scene_corners;
+        if (display_images_ && !image_matches.empty()) {
+            line(image_matches, scene_corners[0] + Point2f((float) image_object.cols, 0),
+                 scene_corners[1] + Point2f((float) image_object.cols, 0), Scalar(0, 255, 0), 16);
+            line(image_matches, scene_corners[1] + Point2f((float) image_object.cols, 0),
+                 scene_corners[2] + Point2f((float) image_object.cols, 0), Scalar(0, 255, 0), 16);
+            line(image_matches, scene_corners[2] + Point2f((float) image_object.cols, 0),
+                 scene_corners[3] + Point2f((float) image_object.cols, 0), Scalar(0, 255, 0), 16);
+            line(image_matches, scene_corners[3] + Point2f((float) image_object.cols, 0),
+                 scene_corners[0] + Point2f((float) image_object.cols, 0), Scalar(0, 255, 0), 16);
+
+            //-- Show detected matches
+            imshow("Good Matches & Object detection", image_matches);
+        }
+    }
+
+    //================================================
+    // Member Function: RefineAlignment
+    //================================================
+    void OpenCvStrategy::RefineAlignment(SceneContext &context) const {
+
+        if (!context.valid || !config_.ecc_refine || Stopped(context)) {
+            return;
+        }
+
+        // Step 7b: Refine the homography with coarse-to-fine ECC seeded by Step 7
+        std::cout << "Step 7b: Refine homography with ECC" << std::endl;
+        TraceScope trace_ecc_refine("ecc_refine");
+        OpencvAlgo::EccOptions ecc_options;
+        ecc_options.levels = config_.ecc_levels;
+        ecc_options.refine_full_resolution = config_.ecc_full_resolution;
+        context.h_obj_to_scene = OpencvAlgo::RefineHomographyECC(active_template_->image(), context.image_scene,
+                                                                 context.h_obj_to_scene, ecc_options);
+        context.h_scene_to_obj = context.h_obj_to_scene.inv();
+        perspectiveTransform(active_template_->corners(), context.scene_corners, context.h_obj_to_scene);
+        std::cout << "Step 7b: Compute time is  " << trace_ecc_refine.End() << " s" << std::endl;
+    }
+
+    //================================================
+    // Member Function: WarpAndScore
+    //================================================
+    void OpenCvStrategy::WarpAndScore(SceneContext &context) const {
+
+        const Mat &image_object = active_template_->image();
+
+        if (!context.valid || Stopped(context)) {
+            return;
+        }
+        FinderWorkspace &workspace = FinderWorkspace::ForThread(config_);
 
         // Step 8 - Use homography to warp image
         std::cout << "Step 8: Warp" << std::endl;
-        start_time = time_point_cast<milliseconds>(system_clock::now());
-        Mat image_dewarp;
-        warpPerspective(image_scene, image_dewarp, h_scene_to_obj, image_object.size());
-        end_time = time_point_cast<milliseconds>(system_clock::now());
-        std::cout << "Step 8: Compute time is  " << (end_time - start_time).count() / 1000.0 << " s" << std::endl;
-        imshow("align", image_dewarp);
+        TraceScope trace_warp("warp");
+        context.image_dewarp = workspace.dewarp_pool().Acquire(image_object.size(), context.image_scene.type());
+        warpPerspective(context.image_scene, context.image_dewarp, context.h_scene_to_obj, image_object.size());
+        std::cout << "Step 8: Compute time is  " << trace_warp.End() << " s" << std::endl;
+        if (display_images_) {
+            imshow("align", context.image_dewarp);
+        }
 
         // Print estimated homography
-        std::cout << "Estimated homography : \n" << h_scene_to_obj << std::endl;
+        std::cout << "Estimated homography : \n" << context.h_scene_to_obj << std::endl;
 
         // Overlay the target and aligned image
-        double alpha = 0.5; // 50% transparency
-        double beta = (1.0 - alpha);
-        Mat image_align;
-        addWeighted(image_object, alpha, image_dewarp, beta, 0.0, image_align);
-        imshow("overlay", image_align);
-        imwrite("align.jpg", image_dewarp);
+        if (display_images_) {
+            double alpha = 0.5; // 50% transparency
+            double beta = (1.0 - alpha);
+            Mat image_align;
+            addWeighted(image_object, alpha, context.image_dewarp, beta, 0.0, image_align);
+            imshow("overlay", image_align);
+            imwrite("align.jpg", context.image_dewarp);
+        }
+        if (debug_sink_ != nullptr) {
+            std::shared_ptr<const TemplatePack> object = active_template_;
+            Mat dewarp = context.image_dewarp;
+            debug_sink_->Submit(DebugLabel(context), "align", dewarp);
+            debug_sink_->Submit(DebugLabel(context), "overlay", [object, dewarp]() {
+                Mat image;
+                addWeighted(object->image(), 0.5, dewarp, 0.5, 0.0, image);
+                return image;
+            });
+        }
 
         // Step 9: Score the alignment of scene's target to template target
         std::cout << "Step 9: Score the alignment of scene's target and template target" << std::endl;
-        start_time = time_point_cast<milliseconds>(system_clock::now());
-        Scalar results = OpencvAlgo::GetMSSIM(image_object, image_dewarp);
-        double result = ((results.val[0] + results.val[1] + results.val[2]) / 3) * 100;
-        end_time = time_point_cast<milliseconds>(system_clock::now());
-        auto end_time_summary = time_point_cast<milliseconds>(system_clock::now());
+        TraceScope trace_ssim("ssim");
+        SsimOptions ssim_options;
+        ssim_options.scale = config_.ssim_scale;
+        ssim_options.grayscale = config_.ssim_grayscale;
+        if (Stopped(context)) {
+            return;
+        }
+        Scalar results = active_template_->GetSsimEngine(ssim_options)->Score(context.image_dewarp,
+                                                                              &workspace.ssim_scratch(),
+                                                                              &context.cancel);
+        if (Stopped(context)) {
+            return;
+        }
+        context.score = ((results.val[0] + results.val[1] + results.val[2]) / 3) * 100;
+        std::cout << "Step 9: Compute time is  " << trace_ssim.End() << " s" << std::endl;
+    }
+
+    //================================================
+    // Member Function: Stopped
+    //================================================
+    bool OpenCvStrategy::Stopped(SceneContext &context) const {
+
+        if (!context.stopped && context.cancel.StopRequested()) {
+            std::cout << "Stopped: " << (context.cancel.cancelled() ? "cancelled" : "deadline passed") << std::endl;
+            context.stopped = true;
+        }
+        return context.stopped;
+    }
+
+    //================================================
+    // Member Function: SceneRoiMask
+    //  Note: The template ROI projected with the coarse location of an earlier frame,
+    //        grown by scene_roi_margin. Empty (detect everywhere) without a hint.
+    //================================================
+    Mat OpenCvStrategy::SceneRoiMask(const SceneContext &context, Mat &scene_mask) const {
+
+        const Mat &roi_mask = active_template_->roi_mask();
+        if (!config_.scene_roi || roi_mask.empty() || context.h_obj_to_scene_hint.empty()) {
+            return Mat();
+        }
+
+        warpPerspective(roi_mask, scene_mask, context.h_obj_to_scene_hint, context.image_scene.size(), INTER_NEAREST,
+                        BORDER_CONSTANT, Scalar(0));
+        if (config_.scene_roi_margin > 0) {
+            // scene_roi_margin passes of 3x3 grow the mask like one square of 2 * margin + 1
+            dilate(scene_mask, scene_mask, Mat(), Point(-1, -1), config_.scene_roi_margin);
+        }
+
+        // The target has left the projected area; search the whole scene
+        if (countNonZero(scene_mask) == 0) {
+            return Mat();
+        }
+        return scene_mask;
+    }
+
+    //================================================
+    // Member Function: DebugLabel
+    //================================================
+    std::string OpenCvStrategy::DebugLabel(const SceneContext &context) const {
 
-        std::cout << "Step 9: Compute time is  " << (end_time - start_time).count() / 1000.0 << " s" << std::endl;
-        std::cout << "Total : Summary compute time is  " << (end_time_summary - start_time_summary).count() / 1000.0
-                  << " s" << std::endl;
-        std::cout << "Image Similarity: " << result << std::endl;
+        if (!context.label.empty()) {
+            return context.label;
+        }
+        return "frame_" + std::to_string(context.frame_index);
+    }
+
+    //================================================
+    // Member Function: MakeResult
+    //================================================
+    TargetObjectImage OpenCvStrategy::MakeResult(const SceneContext &context) const {
 
         // TODO: Clean up return code by adding additional constructor for TargetObjectImage
         TargetObjectImage target_object;
-        target_object.image_ = image_dewarp.clone();
-        target_object.score_ = result;
-        if (scene_corners.size() > 0){
-            for (int i; i < 4; i++) {
-                target_object.corner_points_[i].x = scene_corners[i].x;
-                target_object.corner_points_[i].y = scene_corners[i].y;
+        if (!context.valid) {
+            return target_object;
+        }
+
+        target_object.partial_ = context.stopped;
+        target_object.image_ = context.image_dewarp;
+        target_object.score_ = context.score;
+        // scene_corners are in the template scaled scene; report them in the source scene
+        // like the other strategies do, pixel centers mapped as resize maps them
+        if (context.scene_corners.size() == 4) {
+            for (int i = 0; i < 4; i++) {
+                const Point2f &corner = context.scene_corners[i];
+                target_object.corner_points_[i].x = cvRound((corner.x + 0.5) * context.source_scale.x - 0.5);
+                target_object.corner_points_[i].y = cvRound((corner.y + 0.5) * context.source_scale.y - 0.5);
             }
         }
 
@@ -15,40 +15,51 @@
 #ifndef SYSTEM_API_OPENCV_STRATEGY_H
 #define SYSTEM_API_OPENCV_STRATEGY_H
 
+#include <memory>
 #include <string>
+#include "finder_config.h"
+#include "scene_context.h"
 #include "target_finder_strategy.h"
 
 namespace TactNib {
 
-    // Enumerations used for the feature detection algorithm
-    enum class FeatureDetectorType
+    class OpenCvStrategy: public TargetFinderStrategy
     {
-        Detect_FAST, Detect_SIFT, Detect_ORB
-    };
+        public:
+            OpenCvStrategy(std::string, std::string);
 
-    enum class FeatureExtractType
-    {
-        Extract_FAST, Extract_SIFT, Extract_ORB
-    };
+            void SetConfig(const FinderConfig &config) { config_ = config; }
 
-    enum class MatchType
-    {
-        Match_FLANN, Match_BRUTEFORCE
-    };
+            // Make the template keypoints/descriptors for the current configuration
+            // available. Must be called before the stage functions below.
+            bool PrepareTemplate();
+            std::shared_ptr<const TemplatePack> active_template() const { return active_template_; }
 
-    enum class FilterType
-    {
-        Filter_LOWES, Filter_SCORE
-    };
+            // Pipeline stages in the order FindTarget runs them. Stages only read the
+            // strategy, so different frames may be in different stages concurrently.
+            void PrepareScene(SceneContext &) const;
+            void DetectFeatures(SceneContext &) const;
+            void MatchFeatures(SceneContext &) const;
+            void EstimateHomography(SceneContext &) const;
+            void RefineAlignment(SceneContext &) const;
+            void WarpAndScore(SceneContext &) const;
+            TargetObjectImage MakeResult(const SceneContext &) const;
 
-    class OpenCvStrategy: public TargetFinderStrategy
-    {
-        public:
-            OpenCvStrategy(std::string, std::string);
+            // True once the frame's cancel token fired; the frame then stays stopped
+            bool Stopped(SceneContext &) const;
 
         private:
         TargetObjectImage FindTarget() override;
 
+        // Writes into scene_mask, a workspace buffer; returns it, or an empty Mat
+        cv::Mat SceneRoiMask(const SceneContext &, cv::Mat &scene_mask) const;
+        std::string DebugLabel(const SceneContext &) const;
+
+        FinderConfig config_;
+
+        // Template analyzed for config_; template_pack_ itself when it supports config_
+        std::shared_ptr<const TemplatePack> active_template_;
+
         protected:
     };
 
@@ -0,0 +1,438 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: root_sift_matcher.cc
+ * Purpose:	  Matcher for SIFT descriptors in quantized RootSIFT form: each
+ *            descriptor is L1 normalized, square rooted and stored as 128 bytes
+ *            (a quarter of the float size). Distances come from SIMD integer dot
+ *            products, exact or over a few probed cells of a coarse index.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+
+#include "root_sift_matcher.h"
+#include "simd_support.h"
+
+using namespace cv;
+
+namespace TactNib {
+
+    struct RootSiftMatcher::Nearest
+    {
+        int distance_sq[2] = {INT_MAX, INT_MAX};
+        int index[2] = {-1, -1};
+
+        // Ties keep the lower train index, whatever order the candidates arrive in
+        void Update(int candidate_sq, int candidate)
+        {
+            auto closer = [](int a_sq, int a, int b_sq, int b) { return a_sq < b_sq || (a_sq == b_sq && a < b); };
+            if (!closer(candidate_sq, candidate, distance_sq[1], index[1])) {
+                return;
+            }
+            if (closer(candidate_sq, candidate, distance_sq[0], index[0])) {
+                distance_sq[1] = distance_sq[0];
+                index[1] = index[0];
+                distance_sq[0] = candidate_sq;
+                index[0] = candidate;
+            } else {
+                distance_sq[1] = candidate_sq;
+                index[1] = candidate;
+            }
+        }
+    };
+
+    namespace {
+        // Same tiling as HammingMatcher; 128 quantized descriptors are 16 KB
+        const int kQueryTile = 32;
+        const int kTrainTile = 128;
+
+        // Lloyd iterations of the coarse index used with probes
+        const int kIndexIterations = 3;
+
+        std::vector<int> SquaredNorms(const Mat &quantized)
+        {
+            std::vector<int> norms(quantized.rows);
+            for (int i = 0; i < quantized.rows; i++) {
+                const uchar *row = quantized.ptr<uchar>(i);
+                norms[i] = RootSiftMatcher::Dot(row, row, quantized.cols);
+            }
+            return norms;
+        }
+
+        int NearestCentroid(const uchar *descriptor, const Mat &centroids)
+        {
+            int best = 0;
+            int best_dot = -1;
+            for (int c = 0; c < centroids.rows; c++) {
+                int dot = RootSiftMatcher::Dot(descriptor, centroids.ptr<uchar>(c), centroids.cols);
+                if (dot > best_dot) {
+                    best_dot = dot;
+                    best = c;
+                }
+            }
+            return best;
+        }
+
+        float UnitDistance(int distance_sq)
+        {
+            return std::sqrt(static_cast<float>(distance_sq)) / RootSiftMatcher::kQuantizedNorm;
+        }
+    }
+
+    //================================================
+    // Default constructor
+    //================================================
+    RootSiftMatcher::RootSiftMatcher(RootSiftMatchOptions options)
+    {
+        options_ = options;
+    }
+
+    //================================================
+    // Member Function: Quantize
+    //  Note: sqrt of the L1 normalized descriptor has unit L2 norm, so the Euclidean
+    //        distance of RootSIFT vectors is the Hellinger distance of the descriptors
+    //================================================
+    void RootSiftMatcher::Quantize(const Mat &descriptors, Mat &quantized)
+    {
+        CV_Assert(descriptors.type() == CV_32F);
+        quantized.create(descriptors.rows, descriptors.cols, CV_8U);
+        for (int i = 0; i < descriptors.rows; i++) {
+            const float *in = descriptors.ptr<float>(i);
+            uchar *out = quantized.ptr<uchar>(i);
+            double sum = 0.0;
+            for (int d = 0; d < descriptors.cols; d++) {
+                sum += std::abs(in[d]);
+            }
+            const double scale = sum > 0.0 ? 1.0 / sum : 0.0;
+            for (int d = 0; d < descriptors.cols; d++) {
+                out[d] = saturate_cast<uchar>(std::sqrt(std::abs(in[d]) * scale) * kQuantizedNorm);
+            }
+        }
+    }
+
+    //================================================
+    // Member Function: Dot
+    //  Note: AVX2 vpmaddubsw + vpmaddwd, SSE2 vpmaddwd on widened bytes, NEON udot
+    //        when the core has the dot product extension
+    //================================================
+    int RootSiftMatcher::Dot(const uchar *a, const uchar *b, int width)
+    {
+        int dot = 0;
+        int i = 0;
+#if defined(TACTNIB_SIMD_AVX2)
+        if (width >= 32) {
+            const __m256i ones = _mm256_set1_epi16(1);
+            __m256i sums = _mm256_setzero_si256();
+            for (; i + 32 <= width; i += 32) {
+                __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+                __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+                // Values are at most 127: pairs of products stay below the int16 limit
+                sums = _mm256_add_epi32(sums, _mm256_madd_epi16(_mm256_maddubs_epi16(va, vb), ones));
+            }
+            __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+            half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+            half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+            dot = _mm_cvtsi128_si32(half);
+        }
+#elif defined(TACTNIB_SIMD_SSE2)
+        if (width >= 16) {
+            const __m128i zero = _mm_setzero_si128();
+            __m128i sums = zero;
+            for (; i + 16 <= width; i += 16) {
+                __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+                __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+                sums = _mm_add_epi32(sums, _mm_madd_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero)));
+                sums = _mm_add_epi32(sums, _mm_madd_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero)));
+            }
+            sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(1, 0, 3, 2)));
+            sums = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, _MM_SHUFFLE(2, 3, 0, 1)));
+            dot = _mm_cvtsi128_si32(sums);
+        }
+#elif defined(TACTNIB_SIMD_NEON)
+        if (width >= 16) {
+            uint32x4_t sums = vdupq_n_u32(0);
+            for (; i + 16 <= width; i += 16) {
+                uint8x16_t va = vld1q_u8(a + i);
+                uint8x16_t vb = vld1q_u8(b + i);
+#if defined(__ARM_FEATURE_DOTPROD)
+                sums = vdotq_u32(sums, va, vb);
+#else
+                uint16x8_t products = vmull_u8(vget_low_u8(va), vget_low_u8(vb));
+                products = vmlal_u8(products, vget_high_u8(va), vget_high_u8(vb));
+                sums = vpadalq_u16(sums, products);
+#endif
+            }
+            dot = static_cast<int>(vaddvq_u32(sums));
+        }
+#endif
+        for (; i < width; i++) {
+            dot += a[i] * b[i];
+        }
+        return dot;
+    }
+
+    //================================================
+    // Member Function: Prepare
+    //  Note: Only 128 wide rows pass, so binary descriptors such as ORB's are
+    //        refused instead of being read as quantized RootSIFT
+    //================================================
+    bool RootSiftMatcher::Prepare(const Mat &descriptors, Mat &quantized)
+    {
+        if (descriptors.cols == kDescriptorWidth && descriptors.type() == CV_32F) {
+            Quantize(descriptors, quantized);
+            return true;
+        }
+        if (descriptors.cols == kDescriptorWidth && descriptors.type() == CV_8U) {
+            quantized = descriptors;
+            return true;
+        }
+        std::cout << "RootSiftMatcher: descriptors must be CV_32F SIFT or quantized CV_8U with "
+                  << kDescriptorWidth << " columns" << std::endl;
+        return false;
+    }
+
+    //================================================
+    // Member Function: BuildIndex
+    //================================================
+    std::shared_ptr<const RootSiftIndex> RootSiftMatcher::BuildIndex(const Mat &train)
+    {
+        auto index = std::make_shared<RootSiftIndex>();
+        if (train.empty() || !Prepare(train, index->quantized)) {
+            return nullptr;
+        }
+        index->norms = SquaredNorms(index->quantized);
+        BuildCoarseIndex(*index);
+        return index;
+    }
+
+    //================================================
+    // Member Function: BuildCoarseIndex
+    //  Note: A few Lloyd iterations group the train rows around sqrt(rows)
+    //        centroids kept at the quantized norm
+    //================================================
+    void RootSiftMatcher::BuildCoarseIndex(RootSiftIndex &index)
+    {
+        const Mat &train = index.quantized;
+        const int width = train.cols;
+        const int cells = std::max(1, cvRound(std::sqrt(static_cast<double>(train.rows))));
+        Mat centroids(cells, width, CV_8U);
+        for (int c = 0; c < cells; c++) {
+            train.row(static_cast<int>(static_cast<int64_t>(c) * train.rows / cells)).copyTo(centroids.row(c));
+        }
+
+        std::vector<int> assignment(train.rows);
+        for (int iteration = 0; iteration <= kIndexIterations; iteration++) {
+            parallel_for_(Range(0, train.rows), [&](const Range &range) {
+                for (int t = range.start; t < range.end; t++) {
+                    assignment[t] = NearestCentroid(train.ptr<uchar>(t), centroids);
+                }
+            });
+            if (iteration == kIndexIterations) {
+                break;
+            }
+
+            // Mean of the members scaled back to the quantized norm; empty cells stay put
+            Mat sums = Mat::zeros(cells, width, CV_32F);
+            std::vector<int> counts(cells, 0);
+            for (int t = 0; t < train.rows; t++) {
+                float *sum = sums.ptr<float>(assignment[t]);
+                const uchar *row = train.ptr<uchar>(t);
+                for (int d = 0; d < width; d++) {
+                    sum[d] += row[d];
+                }
+                counts[assignment[t]]++;
+            }
+            for (int c = 0; c < cells; c++) {
+                double norm = cv::norm(sums.row(c));
+                if (counts[c] == 0 || norm <= 0.0) {
+                    continue;
+                }
+                sums.row(c).convertTo(centroids.row(c), CV_8U, kQuantizedNorm / norm);
+            }
+        }
+
+        index.members.assign(cells, std::vector<int>());
+        for (int t = 0; t < train.rows; t++) {
+            index.members[assignment[t]].push_back(t);
+        }
+        index.centroids = centroids;
+    }
+
+    //================================================
+    // Member Function: FindNearest
+    //================================================
+    bool RootSiftMatcher::FindNearest(const Mat &query, const RootSiftIndex &train, std::vector<Nearest> &nearest) const
+    {
+        Mat query_quantized;
+        if (query.empty() || train.quantized.empty() || !Prepare(query, query_quantized)) {
+            return false;
+        }
+
+        nearest.assign(query_quantized.rows, Nearest());
+
+        // The index only pays off when probing skips most of the cells
+        if (options_.probes <= 0 || options_.probes >= train.centroids.rows) {
+            FindNearestExact(query_quantized, train, nearest);
+        } else {
+            FindNearestProbed(query_quantized, train, nearest);
+        }
+        return true;
+    }
+
+    //================================================
+    // Member Function: FindNearestExact
+    //================================================
+    void RootSiftMatcher::FindNearestExact(const Mat &query, const RootSiftIndex &train,
+                                           std::vector<Nearest> &nearest) const
+    {
+        const Mat &rows = train.quantized;
+        const int width = query.cols;
+        const int query_tiles = (query.rows + kQueryTile - 1) / kQueryTile;
+        parallel_for_(Range(0, query_tiles), [&](const Range &range) {
+            for (int tile = range.start; tile < range.end; tile++) {
+                if (options_.cancel.StopRequested()) {
+                    return;
+                }
+                const int q0 = tile * kQueryTile;
+                const int q1 = std::min(q0 + kQueryTile, query.rows);
+                for (int t0 = 0; t0 < rows.rows; t0 += kTrainTile) {
+                    const int t1 = std::min(t0 + kTrainTile, rows.rows);
+                    for (int q = q0; q < q1; q++) {
+                        const uchar *descriptor = query.ptr<uchar>(q);
+                        const int query_norm = Dot(descriptor, descriptor, width);
+                        for (int t = t0; t < t1; t++) {
+                            int dot = Dot(descriptor, rows.ptr<uchar>(t), width);
+                            nearest[q].Update(query_norm + train.norms[t] - 2 * dot, t);
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    //================================================
+    // Member Function: FindNearestProbed
+    //  Note: Every query scans the members of its `probes` nearest centroids
+    //================================================
+    void RootSiftMatcher::FindNearestProbed(const Mat &query, const RootSiftIndex &train,
+                                            std::vector<Nearest> &nearest) const
+    {
+        const int width = query.cols;
+        const int cells = train.centroids.rows;
+        const int probes = std::min(options_.probes, cells);
+        parallel_for_(Range(0, query.rows), [&](const Range &range) {
+            std::vector<std::pair<int, int>> scores(cells);
+            for (int q = range.start; q < range.end; q++) {
+                if ((q - range.start) % kQueryTile == 0 && options_.cancel.StopRequested()) {
+                    return;
+                }
+                const uchar *descriptor = query.ptr<uchar>(q);
+                for (int c = 0; c < cells; c++) {
+                    scores[c] = std::make_pair(-Dot(descriptor, train.centroids.ptr<uchar>(c), width), c);
+                }
+                std::partial_sort(scores.begin(), scores.begin() + probes, scores.end());
+
+                const int query_norm = Dot(descriptor, descriptor, width);
+                for (int p = 0; p < probes; p++) {
+                    for (int t : train.members[scores[p].second]) {
+                        int dot = Dot(descriptor, train.quantized.ptr<uchar>(t), width);
+                        nearest[q].Update(query_norm + train.norms[t] - 2 * dot, t);
+                    }
+                }
+            }
+        });
+    }
+
+    //================================================
+    // Member Function: Match
+    //  Note: One-off train side; the coarse index is only built when probing
+    //================================================
+    void RootSiftMatcher::Match(const Mat &query, const Mat &train, std::vector<DMatch> &matches) const
+    {
+        matches.clear();
+        RootSiftIndex index;
+        if (!PrepareTrain(train, index)) {
+            return;
+        }
+        Match(query, index, matches);
+    }
+
+    //================================================
+    // Member Function: Match
+    //================================================
+    void RootSiftMatcher::Match(const Mat &query, const RootSiftIndex &train, std::vector<DMatch> &matches) const
+    {
+        matches.clear();
+        std::vector<Nearest> nearest;
+        if (!FindNearest(query, train, nearest)) {
+            return;
+        }
+
+        matches.reserve(nearest.size());
+        for (int q = 0; q < static_cast<int>(nearest.size()); q++) {
+            if (nearest[q].index[0] >= 0) {
+                matches.emplace_back(q, nearest[q].index[0], UnitDistance(nearest[q].distance_sq[0]));
+            }
+        }
+    }
+
+    //================================================
+    // Member Function: KnnMatch2
+    //================================================
+    void RootSiftMatcher::KnnMatch2(const Mat &query, const Mat &train,
+                                    std::vector<std::vector<DMatch>> &knn_matches) const
+    {
+        knn_matches.clear();
+        RootSiftIndex index;
+        if (!PrepareTrain(train, index)) {
+            return;
+        }
+        KnnMatch2(query, index, knn_matches);
+    }
+
+    //================================================
+    // Member Function: KnnMatch2
+    //================================================
+    void RootSiftMatcher::KnnMatch2(const Mat &query, const RootSiftIndex &train,
+                                    std::vector<std::vector<DMatch>> &knn_matches) const
+    {
+        knn_matches.clear();
+        std::vector<Nearest> nearest;
+        if (!FindNearest(query, train, nearest)) {
+            return;
+        }
+
+        // One entry per query row, like cv::DescriptorMatcher::knnMatch
+        knn_matches.resize(nearest.size());
+        for (int q = 0; q < static_cast<int>(nearest.size()); q++) {
+            for (int k = 0; k < 2 && nearest[q].index[k] >= 0; k++) {
+                knn_matches[q].emplace_back(q, nearest[q].index[k], UnitDistance(nearest[q].distance_sq[k]));
+            }
+        }
+    }
+
+    //================================================
+    // Member Function: PrepareTrain
+    //================================================
+    bool RootSiftMatcher::PrepareTrain(const Mat &train, RootSiftIndex &index) const
+    {
+        if (train.empty() || !Prepare(train, index.quantized)) {
+            return false;
+        }
+        index.norms = SquaredNorms(index.quantized);
+        int cells = std::max(1, cvRound(std::sqrt(static_cast<double>(train.rows))));
+        if (options_.probes > 0 && options_.probes < cells) {
+            BuildCoarseIndex(index);
+        }
+        return true;
+    }
+
+} // TactNib
@@ -0,0 +1,74 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: scene_context.h
+ * Purpose:	  Per-scene working state passed between the stages of the OpenCV
+ *            target finder. One context travels through the pipeline per frame
+ *            so stages can run on different threads.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_SCENE_CONTEXT_H
+#define SYSTEM_API_SCENE_CONTEXT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "cancel_token.h"
+
+namespace TactNib {
+
+    struct SceneContext
+    {
+        int64_t frame_index = 0;
+
+        // Names debug artifacts; when empty the frame index is used
+        std::string label;
+
+        // Set by a stage that cannot continue; later stages skip the frame
+        bool valid = true;
+
+        // Checked between and inside stages; once it fires the frame is stopped, later
+        // stages skip it and the result is whatever was found so far
+        CancelToken cancel;
+        bool stopped = false;
+
+        // Decoded scene; replaced by the brightness adjusted, template scaled scene
+        cv::Mat image_scene;
+
+        // Source scene pixels per image_scene pixel along x and y: a reduced JPEG decode
+        // times the template scaling. Result corners are mapped back with it.
+        cv::Point2d source_scale = cv::Point2d(1.0, 1.0);
+
+        // Coarse template location from an earlier frame (template to scaled scene);
+        // when set, scene features are only detected near the projected template ROI
+        cv::Mat h_obj_to_scene_hint;
+
+        std::vector<cv::KeyPoint> keypoints_scene;
+        cv::Mat descriptors_scene;
+
+        // queryIdx indexes the template keypoints, trainIdx the scene keypoints
+        std::vector<cv::DMatch> matches;
+        std::vector<std::vector<cv::DMatch>> knn_matches;
+        cv::Mat image_matches;
+
+        std::vector<cv::Point2f> points_scene;
+        std::vector<cv::Point2f> points_object;
+        cv::Mat h_scene_to_obj;
+        cv::Mat h_obj_to_scene;
+
+        // RANSAC inliers of h_scene_to_obj among points_scene
+        int inliers = 0;
+        std::vector<cv::Point2f> scene_corners;
+
+        cv::Mat image_dewarp;
+        double score = 0.0;
+    };
+
+} // TactNib
+
+#endif //SYSTEM_API_SCENE_CONTEXT_H
@@ -0,0 +1,80 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: simd_support.h
+ * Purpose:	  Thin wrappers over the float SIMD instructions of the boards we
+ *            build for: AVX2/FMA (x86_64 with TACTNIB_ENABLE_AVX2), SSE2 (any
+ *            x86_64) and NEON (aarch64/arm64). Kernels use these when
+ *            TACTNIB_SIMD_FLOAT is defined and keep a scalar tail loop.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_SIMD_SUPPORT_H
+#define SYSTEM_API_SIMD_SUPPORT_H
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define TACTNIB_SIMD_AVX2 1
+#define TACTNIB_SIMD_FLOAT 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TACTNIB_SIMD_SSE2 1
+#define TACTNIB_SIMD_FLOAT 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define TACTNIB_SIMD_NEON 1
+#define TACTNIB_SIMD_FLOAT 1
+#endif
+
+namespace TactNib {
+    namespace Simd {
+
+#if defined(TACTNIB_SIMD_AVX2)
+        typedef __m256 FloatVec;
+        const int kFloatLanes = 8;
+        inline FloatVec Load(const float *p) { return _mm256_loadu_ps(p); }
+        inline void Store(float *p, FloatVec v) { _mm256_storeu_ps(p, v); }
+        inline FloatVec Set(float x) { return _mm256_set1_ps(x); }
+        inline FloatVec Add(FloatVec a, FloatVec b) { return _mm256_add_ps(a, b); }
+        inline FloatVec Sub(FloatVec a, FloatVec b) { return _mm256_sub_ps(a, b); }
+        inline FloatVec Mul(FloatVec a, FloatVec b) { return _mm256_mul_ps(a, b); }
+        inline FloatVec Div(FloatVec a, FloatVec b) { return _mm256_div_ps(a, b); }
+        inline FloatVec Min(FloatVec a, FloatVec b) { return _mm256_min_ps(a, b); }
+        inline FloatVec Max(FloatVec a, FloatVec b) { return _mm256_max_ps(a, b); }
+        // a * b + c
+        inline FloatVec MulAdd(FloatVec a, FloatVec b, FloatVec c) { return _mm256_fmadd_ps(a, b, c); }
+#elif defined(TACTNIB_SIMD_SSE2)
+        typedef __m128 FloatVec;
+        const int kFloatLanes = 4;
+        inline FloatVec Load(const float *p) { return _mm_loadu_ps(p); }
+        inline void Store(float *p, FloatVec v) { _mm_storeu_ps(p, v); }
+        inline FloatVec Set(float x) { return _mm_set1_ps(x); }
+        inline FloatVec Add(FloatVec a, FloatVec b) { return _mm_add_ps(a, b); }
+        inline FloatVec Sub(FloatVec a, FloatVec b) { return _mm_sub_ps(a, b); }
+        inline FloatVec Mul(FloatVec a, FloatVec b) { return _mm_mul_ps(a, b); }
+        inline FloatVec Div(FloatVec a, FloatVec b) { return _mm_div_ps(a, b); }
+        inline FloatVec Min(FloatVec a, FloatVec b) { return _mm_min_ps(a, b); }
+        inline FloatVec Max(FloatVec a, FloatVec b) { return _mm_max_ps(a, b); }
+        inline FloatVec MulAdd(FloatVec a, FloatVec b, FloatVec c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+#elif defined(TACTNIB_SIMD_NEON)
+        typedef float32x4_t FloatVec;
+        const int kFloatLanes = 4;
+        inline FloatVec Load(const float *p) { return vld1q_f32(p); }
+        inline void Store(float *p, FloatVec v) { vst1q_f32(p, v); }
+        inline FloatVec Set(float x) { return vdupq_n_f32(x); }
+        inline FloatVec Add(FloatVec a, FloatVec b) { return vaddq_f32(a, b); }
+        inline FloatVec Sub(FloatVec a, FloatVec b) { return vsubq_f32(a, b); }
+        inline FloatVec Mul(FloatVec a, FloatVec b) { return vmulq_f32(a, b); }
+        inline FloatVec Div(FloatVec a, FloatVec b) { return vdivq_f32(a, b); }
+        inline FloatVec Min(FloatVec a, FloatVec b) { return vminq_f32(a, b); }
+        inline FloatVec Max(FloatVec a, FloatVec b) { return vmaxq_f32(a, b); }
+        inline FloatVec MulAdd(FloatVec a, FloatVec b, FloatVec c) { return vfmaq_f32(c, a, b); }
+#endif
+
+    } // Simd
+} // TactNib
+
+#endif //SYSTEM_API_SIMD_SUPPORT_H
@@ -0,0 +1,430 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: ssim_engine.cc
+ * Purpose:	  Mean structural similarity (SSIM) scoring. The products, the 11x11
+ *            Gaussian blurs and the SSIM ratio are fused into one pass over
+ *            column strips so the working set stays in cache, instead of the
+ *            fifteen full-size float images of OpencvAlgo::GetMSSIMReference.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <algorithm>
+#include <vector>
+#include <opencv2/imgproc.hpp>
+
+#include "simd_support.h"
+#include "ssim_engine.h"
+
+using namespace cv;
+
+namespace TactNib {
+
+    namespace {
+        // Same window and constants as the OpenCV tutorial implementation
+        const int kRadius = 5;
+        const int kTaps = 2 * kRadius + 1;
+        const double kSigma = 1.5;
+        const float kC1 = 6.5025f;
+        const float kC2 = 58.5225f;
+
+        // Pixels per column strip; 11 filtered rows of a strip stay in L2 on the board
+        const int kStripWidth = 128;
+
+        // Output rows accumulated in float before the sums are moved to double
+        const int kFlushRows = 64;
+
+        struct SsimInputs
+        {
+            const Mat *image1;   // reference, 8-bit
+            const Mat *image2;   // scored image, 8-bit, same size and channels
+            const Mat *mu1;      // cached reference mean, or nullptr
+            const Mat *sigma1;   // cached reference variance, or nullptr
+            const float *kernel; // kTaps Gaussian weights
+        };
+
+        //================================================
+        // Function: FilterRow
+        //  Note: Horizontal pass over interleaved channels, src starts kRadius pixels
+        //        left of the first output element
+        //================================================
+        void FilterRow(const float *src, float *dst, int count, int cn, const float *g)
+        {
+            int e = 0;
+#if defined(TACTNIB_SIMD_FLOAT)
+            Simd::FloatVec weights[kTaps];
+            for (int k = 0; k < kTaps; k++) {
+                weights[k] = Simd::Set(g[k]);
+            }
+            for (; e <= count - Simd::kFloatLanes; e += Simd::kFloatLanes) {
+                Simd::FloatVec sum = Simd::Mul(Simd::Load(src + e), weights[0]);
+                for (int k = 1; k < kTaps; k++) {
+                    sum = Simd::MulAdd(Simd::Load(src + e + k * cn), weights[k], sum);
+                }
+                Simd::Store(dst + e, sum);
+            }
+#endif
+            for (; e < count; e++) {
+                float sum = src[e] * g[0];
+                for (int k = 1; k < kTaps; k++) {
+                    sum += src[e + k * cn] * g[k];
+                }
+                dst[e] = sum;
+            }
+        }
+
+        //================================================
+        // Function: FilterColumn
+        //  Note: Vertical pass over kTaps horizontally filtered rows
+        //================================================
+        void FilterColumn(const float *const *rows, float *dst, int count, const float *g)
+        {
+            int e = 0;
+#if defined(TACTNIB_SIMD_FLOAT)
+            Simd::FloatVec weights[kTaps];
+            for (int k = 0; k < kTaps; k++) {
+                weights[k] = Simd::Set(g[k]);
+            }
+            for (; e <= count - Simd::kFloatLanes; e += Simd::kFloatLanes) {
+                Simd::FloatVec sum = Simd::Mul(Simd::Load(rows[0] + e), weights[0]);
+                for (int k = 1; k < kTaps; k++) {
+                    sum = Simd::MulAdd(Simd::Load(rows[k] + e), weights[k], sum);
+                }
+                Simd::Store(dst + e, sum);
+            }
+#endif
+            for (; e < count; e++) {
+                float sum = rows[0][e] * g[0];
+                for (int k = 1; k < kTaps; k++) {
+                    sum += rows[k][e] * g[k];
+                }
+                dst[e] = sum;
+            }
+        }
+
+        //================================================
+        // Function: AccumulateSsim
+        //  Note: sigma1 is E[x^2] of the reference unless kCachedSigma, in which case
+        //        it already is the variance
+        //================================================
+        template<bool kCachedSigma>
+        void AccumulateSsim(const float *mu1, const float *sigma1, const float *mu2, const float *e22,
+                            const float *e12, float *acc, int count)
+        {
+            int e = 0;
+#if defined(TACTNIB_SIMD_FLOAT)
+            const Simd::FloatVec c1 = Simd::Set(kC1);
+            const Simd::FloatVec c2 = Simd::Set(kC2);
+            const Simd::FloatVec two = Simd::Set(2.0f);
+            for (; e <= count - Simd::kFloatLanes; e += Simd::kFloatLanes) {
+                Simd::FloatVec m1 = Simd::Load(mu1 + e);
+                Simd::FloatVec m2 = Simd::Load(mu2 + e);
+                Simd::FloatVec m11 = Simd::Mul(m1, m1);
+                Simd::FloatVec m22 = Simd::Mul(m2, m2);
+                Simd::FloatVec m12 = Simd::Mul(m1, m2);
+                Simd::FloatVec s11 = kCachedSigma ? Simd::Load(sigma1 + e) : Simd::Sub(Simd::Load(sigma1 + e), m11);
+                Simd::FloatVec s22 = Simd::Sub(Simd::Load(e22 + e), m22);
+                Simd::FloatVec s12 = Simd::Sub(Simd::Load(e12 + e), m12);
+                Simd::FloatVec numerator = Simd::Mul(Simd::MulAdd(two, m12, c1), Simd::MulAdd(two, s12, c2));
+                Simd::FloatVec denominator = Simd::Mul(Simd::Add(Simd::Add(m11, m22), c1),
+                                                       Simd::Add(Simd::Add(s11, s22), c2));
+                Simd::Store(acc + e, Simd::Add(Simd::Load(acc + e), Simd::Div(numerator, denominator)));
+            }
+#endif
+            for (; e < count; e++) {
+                float m11 = mu1[e] * mu1[e];
+                float m22 = mu2[e] * mu2[e];
+                float m12 = mu1[e] * mu2[e];
+                float s11 = kCachedSigma ? sigma1[e] : sigma1[e] - m11;
+                float s22 = e22[e] - m22;
+                float s12 = e12[e] - m12;
+                acc[e] += ((2.0f * m12 + kC1) * (2.0f * s12 + kC2)) / ((m11 + m22 + kC1) * (s11 + s22 + kC2));
+            }
+        }
+
+        //================================================
+        // Function: ScoreStrip
+        //  Note: Walks columns [x0, x1) from top to bottom keeping the last kTaps
+        //        horizontally filtered rows in a ring, so every input row is converted
+        //        and filtered once. Adds the per-channel SSIM sums to sums[].
+        //================================================
+        void ScoreStrip(const SsimInputs &in, int x0, int x1, double *sums, std::vector<int> &source_col,
+                        std::vector<float> &buffer)
+        {
+            const Mat &image1 = *in.image1;
+            const Mat &image2 = *in.image2;
+            const int rows = image2.rows;
+            const int cols = image2.cols;
+            const int cn = image2.channels();
+            const bool cached = in.mu1 != nullptr;
+
+            const int width = x1 - x0;
+            const int padded_width = width + 2 * kRadius;
+            const int count = width * cn;
+            const int padded_count = padded_width * cn;
+
+            // Quantities that are blurred: image2, image2^2, image1*image2 and, without a
+            // cached reference, image1 and image1^2
+            const int quantities = cached ? 3 : 5;
+            enum { kMu2 = 0, kE22 = 1, kE12 = 2, kMu1 = 3, kE11 = 4 };
+
+            // BORDER_REFLECT_101, the GaussianBlur default, for the padded strip columns
+            source_col.resize(padded_width);
+            for (int i = 0; i < padded_width; i++) {
+                source_col[i] = borderInterpolate(x0 - kRadius + i, cols, BORDER_REFLECT_101) * cn;
+            }
+
+            // One allocation for the strip, kept by the caller between frames
+            const size_t line_size = static_cast<size_t>(padded_count) * quantities;
+            const size_t ring_size = static_cast<size_t>(kTaps) * quantities * count;
+            const size_t blurred_size = static_cast<size_t>(quantities) * count;
+            buffer.resize(line_size + ring_size + blurred_size + count);
+            float *line = buffer.data();
+            float *ring = line + line_size;
+            float *blurred = ring + ring_size;
+            float *acc = blurred + blurred_size;
+            std::fill(acc, acc + count, 0.0f);
+            const float *ring_rows[kTaps];
+
+            auto flush = [&]() {
+                for (int e = 0; e < count; e++) {
+                    sums[e % cn] += acc[e];
+                    acc[e] = 0.0f;
+                }
+            };
+
+            int pending_rows = 0;
+            for (int yi = -kRadius; yi < rows + kRadius; yi++) {
+                const int source_row = borderInterpolate(yi, rows, BORDER_REFLECT_101);
+                const uchar *p1 = image1.ptr<uchar>(source_row);
+                const uchar *p2 = image2.ptr<uchar>(source_row);
+
+                // Convert the padded row and form the products
+                float *q_mu2 = &line[kMu2 * padded_count];
+                float *q_e22 = &line[kE22 * padded_count];
+                float *q_e12 = &line[kE12 * padded_count];
+                float *q_mu1 = cached ? nullptr : &line[kMu1 * padded_count];
+                float *q_e11 = cached ? nullptr : &line[kE11 * padded_count];
+                for (int i = 0; i < padded_width; i++) {
+                    const uchar *s1 = p1 + source_col[i];
+                    const uchar *s2 = p2 + source_col[i];
+                    for (int c = 0; c < cn; c++) {
+                        const int e = i * cn + c;
+                        const float v1 = s1[c];
+                        const float v2 = s2[c];
+                        q_mu2[e] = v2;
+                        q_e22[e] = v2 * v2;
+                        q_e12[e] = v1 * v2;
+                        if (!cached) {
+                            q_mu1[e] = v1;
+                            q_e11[e] = v1 * v1;
+                        }
+                    }
+                }
+
+                // Horizontal pass into the ring slot of this row
+                const int slot = (yi + kRadius) % kTaps;
+                for (int q = 0; q < quantities; q++) {
+                    FilterRow(&line[q * padded_count], &ring[(static_cast<size_t>(slot) * quantities + q) * count],
+                              count, cn, in.kernel);
+                }
+
+                // Output row y needs filtered rows y - kRadius .. y + kRadius
+                if (yi < kRadius) {
+                    continue;
+                }
+                const int y = yi - kRadius;
+                for (int q = 0; q < quantities; q++) {
+                    for (int k = 0; k < kTaps; k++) {
+                        ring_rows[k] = &ring[(static_cast<size_t>((y + k) % kTaps) * quantities + q) * count];
+                    }
+                    FilterColumn(ring_rows, &blurred[q * count], count, in.kernel);
+                }
+
+                const float *mu2 = &blurred[kMu2 * count];
+                const float *e22 = &blurred[kE22 * count];
+                const float *e12 = &blurred[kE12 * count];
+                if (cached) {
+                    const float *mu1 = in.mu1->ptr<float>(y) + x0 * cn;
+                    const float *sigma1 = in.sigma1->ptr<float>(y) + x0 * cn;
+                    AccumulateSsim<true>(mu1, sigma1, mu2, e22, e12, acc, count);
+                } else {
+                    const float *mu1 = &blurred[kMu1 * count];
+                    const float *e11 = &blurred[kE11 * count];
+                    AccumulateSsim<false>(mu1, e11, mu2, e22, e12, acc, count);
+                }
+
+                if (++pending_rows == kFlushRows) {
+                    flush();
+                    pending_rows = 0;
+                }
+            }
+            flush();
+        }
+
+        //================================================
+        // Function: MeanSsim
+        //================================================
+        Scalar MeanSsim(const Mat &image1, const Mat &image2, const Mat *mu1, const Mat *sigma1,
+                        SsimScratch &scratch, const CancelToken *cancel = nullptr)
+        {
+            CV_Assert(image1.size() == image2.size() && image1.type() == image2.type());
+            CV_Assert(image2.depth() == CV_8U && image2.channels() <= 4);
+
+            if (scratch.kernel.empty()) {
+                scratch.kernel = getGaussianKernel(kTaps, kSigma, CV_32F);
+            }
+            SsimInputs in = {&image1, &image2, mu1, sigma1, scratch.kernel.ptr<float>()};
+
+            // Strips are independent; each writes its own sums so the result is deterministic
+            const int cn = image2.channels();
+            const int strips = (image2.cols + kStripWidth - 1) / kStripWidth;
+            std::vector<double> &strip_sums = scratch.strip_sums;
+            strip_sums.assign(static_cast<size_t>(strips) * cn, 0.0);
+            if (scratch.strip_rows.size() < static_cast<size_t>(strips)) {
+                scratch.strip_rows.resize(strips);
+                scratch.strip_columns.resize(strips);
+            }
+            parallel_for_(Range(0, strips), [&](const Range &range) {
+                for (int s = range.start; s < range.end; s++) {
+                    if (cancel != nullptr && cancel->StopRequested()) {
+                        return;
+                    }
+                    int x0 = s * kStripWidth;
+                    int x1 = std::min(x0 + kStripWidth, image2.cols);
+                    ScoreStrip(in, x0, x1, &strip_sums[static_cast<size_t>(s) * cn], scratch.strip_columns[s],
+                               scratch.strip_rows[s]);
+                }
+            });
+
+            Scalar mssim;
+            const double pixels = static_cast<double>(image2.rows) * image2.cols;
+            for (int s = 0; s < strips; s++) {
+                for (int c = 0; c < cn; c++) {
+                    mssim.val[c] += strip_sums[static_cast<size_t>(s) * cn + c];
+                }
+            }
+            for (int c = 0; c < cn; c++) {
+                mssim.val[c] /= pixels;
+            }
+            return mssim;
+        }
+
+        //================================================
+        // Function: ExpandGray
+        //  Note: Repeat a single channel score so callers averaging channels 0..2 still work
+        //================================================
+        Scalar ExpandGray(const Scalar &score, int channels)
+        {
+            if (channels != 1) {
+                return score;
+            }
+            return Scalar(score.val[0], score.val[0], score.val[0], 0.0);
+        }
+    }
+
+    //================================================
+    // Default constructor
+    //================================================
+    SsimEngine::SsimEngine(SsimOptions options)
+    {
+        options_ = options;
+    }
+
+    //================================================
+    // Member Function: Prepare
+    //================================================
+    Mat SsimEngine::Prepare(const Mat &image, SsimScratch &scratch) const
+    {
+        // Never write into the caller's pixels
+        Mat prepared = image;
+        if (options_.scale > 0.0 && options_.scale < 1.0) {
+            resize(prepared, scratch.scaled, Size(), options_.scale, options_.scale, INTER_AREA);
+            prepared = scratch.scaled;
+        }
+        if (options_.grayscale && prepared.channels() == 3) {
+            cvtColor(prepared, scratch.gray, COLOR_BGR2GRAY);
+            prepared = scratch.gray;
+        }
+        return prepared;
+    }
+
+    //================================================
+    // Member Function: SetReference
+    //================================================
+    void SsimEngine::SetReference(const Mat &reference)
+    {
+        SsimScratch scratch;
+        reference_ = Prepare(reference, scratch);
+        reference_mu_.release();
+        reference_sigma_.release();
+        const double cached_bytes = static_cast<double>(reference_.total()) * reference_.channels() * 2 * sizeof(float);
+        if (cached_bytes > static_cast<double>(options_.max_cached_bytes)) {
+            return;
+        }
+
+        // Same arithmetic as the fused pass performs for the reference side
+        Mat reference_float;
+        reference_.convertTo(reference_float, CV_32F);
+        GaussianBlur(reference_float, reference_mu_, Size(kTaps, kTaps), kSigma);
+        GaussianBlur(reference_float.mul(reference_float), reference_sigma_, Size(kTaps, kTaps), kSigma);
+        reference_sigma_ -= reference_mu_.mul(reference_mu_);
+    }
+
+    //================================================
+    // Member Function: Score
+    //================================================
+    Scalar SsimEngine::Score(const Mat &image, SsimScratch *scratch, const CancelToken *cancel) const
+    {
+        CV_Assert(HasReference());
+        SsimScratch local_scratch;
+        SsimScratch &buffers = scratch != nullptr ? *scratch : local_scratch;
+        Mat prepared = Prepare(image, buffers);
+        // Without the cached planes the fused pass blurs the reference per strip
+        const bool cached = !reference_mu_.empty();
+        return ExpandGray(MeanSsim(reference_, prepared, cached ? &reference_mu_ : nullptr,
+                                   cached ? &reference_sigma_ : nullptr, buffers, cancel),
+                          prepared.channels());
+    }
+
+    //================================================
+    // Member Function: Compute
+    //================================================
+    Scalar SsimEngine::Compute(const Mat &image1, const Mat &image2, SsimOptions options)
+    {
+        SsimEngine engine(options);
+        SsimScratch scratch1;
+        SsimScratch scratch2;
+        Mat prepared1 = engine.Prepare(image1, scratch1);
+        Mat prepared2 = engine.Prepare(image2, scratch2);
+        return ExpandGray(MeanSsim(prepared1, prepared2, nullptr, nullptr, scratch2), prepared2.channels());
+    }
+
+    //================================================
+    // Member Function: Get
+    //  Note: Built under the lock, so concurrent callers wait for one reference
+    //================================================
+    std::shared_ptr<const SsimEngine> SsimEngineCache::Get(const void *owner, const Mat &reference,
+                                                           const SsimOptions &options)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto entry = entries_.begin(); entry != entries_.end(); ++entry) {
+            if (entry->owner == owner && entry->engine->options() == options) {
+                entries_.splice(entries_.begin(), entries_, entry);
+                return entries_.front().engine;
+            }
+        }
+
+        auto engine = std::make_shared<SsimEngine>(options);
+        engine->SetReference(reference);
+        entries_.push_front({owner, engine});
+        while (entries_.size() > std::max<size_t>(capacity_, 1)) {
+            entries_.pop_back();
+        }
+        return engine;
+    }
+
+} // TactNib
@@ -0,0 +1,116 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: ssim_engine.h
+ * Purpose:	  Mean structural similarity (SSIM) scoring. The products, the 11x11
+ *            Gaussian blurs and the SSIM ratio are fused into one pass over
+ *            column strips so the working set stays in cache, instead of the
+ *            fifteen full-size float images of OpencvAlgo::GetMSSIMReference.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_SSIM_ENGINE_H
+#define SYSTEM_API_SSIM_ENGINE_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "cancel_token.h"
+
+namespace TactNib {
+
+    struct SsimOptions
+    {
+        // Score a copy resized by this factor (INTER_AREA); 1.0 scores full resolution
+        double scale = 1.0;
+
+        // Score luminance only; the result is repeated in channels 0..2
+        bool grayscale = false;
+
+        // SetReference caches the blurred mean and variance of the reference, 8 bytes per
+        // pixel and channel at the scoring resolution: 35 MB for the bundled 992x1470
+        // template in color, 466 MB for a 3600x5400 one. A reference whose cache would
+        // exceed this many bytes is blurred again in every Score instead, about 1.6 times
+        // the work. The scaled reference costs 1 byte per pixel and channel either way.
+        size_t max_cached_bytes = 64 << 20;
+
+        bool operator==(const SsimOptions &) const = default;
+    };
+
+    // Buffers reused by SsimEngine::Score; give each thread its own. They are sized by
+    // the first call and not reallocated while the image size stays the same.
+    struct SsimScratch
+    {
+        cv::Mat scaled;
+        cv::Mat gray;
+        cv::Mat kernel;
+        std::vector<double> strip_sums;
+        std::vector<std::vector<int>> strip_columns;
+        std::vector<std::vector<float>> strip_rows;     // line, ring, blurred and acc of a strip
+    };
+
+    // Accuracy: at full resolution in color the score is within 1e-4 per channel of a
+    // double precision SSIM and within 1e-3 of GetMSSIMReference, whose float blurs
+    // lose more precision. Reduced resolution and grayscale scores are not comparable
+    // with full resolution scores; thresholds must be tuned per mode.
+    class SsimEngine {
+        public:
+            explicit SsimEngine(SsimOptions options = SsimOptions());
+
+            // Cache the reference (template) side: the blurred mean and variance planes at
+            // the scoring resolution, when they fit in options.max_cached_bytes
+            void SetReference(const cv::Mat &reference);
+            bool HasReference() const { return !reference_.empty(); }
+            const SsimOptions &options() const { return options_; }
+
+            // Mean SSIM of image against the cached reference, per channel. With scratch
+            // the call makes no allocations once the buffers are sized. Strips left when
+            // cancel fires are skipped and the score is meaningless.
+            cv::Scalar Score(const cv::Mat &image, SsimScratch *scratch = nullptr,
+                             const CancelToken *cancel = nullptr) const;
+
+            // Mean SSIM of two images without a cached reference
+            static cv::Scalar Compute(const cv::Mat &image1, const cv::Mat &image2,
+                                      SsimOptions options = SsimOptions());
+
+        private:
+            cv::Mat Prepare(const cv::Mat &, SsimScratch &) const;
+
+            SsimOptions options_;
+            cv::Mat reference_;
+            cv::Mat reference_mu_;
+            cv::Mat reference_sigma_;
+    };
+
+    // SSIM references of the most recently used templates, for callers that hold more
+    // templates than references fit in memory. Engines handed out stay valid after
+    // they are evicted. Thread safe.
+    class SsimEngineCache {
+        public:
+            explicit SsimEngineCache(size_t capacity) : capacity_(capacity) {}
+
+            // Engine for reference under options; owner tells references apart, e.g. the
+            // template pack the reference belongs to
+            std::shared_ptr<const SsimEngine> Get(const void *owner, const cv::Mat &reference,
+                                                  const SsimOptions &options);
+
+        private:
+            struct Entry
+            {
+                const void *owner;
+                std::shared_ptr<const SsimEngine> engine;
+            };
+
+            size_t capacity_;
+            std::mutex mutex_;
+            std::list<Entry> entries_;      // most recently used first
+    };
+
+} // TactNib
+
+#endif //SYSTEM_API_SSIM_ENGINE_H
@@ -15,6 +15,7 @@
 #include <opencv2/imgcodecs.hpp>
 
 #include "target_finder_strategy.h"
+#include "morphology.h"
 #include "opencv_algo.h"
 
 using namespace cv;
@@ -27,39 +28,47 @@ namespace TactNib {
     //================================================
     TargetFinderStrategy::TargetFinderStrategy(std::string image_scene_file, std::string image_target_file)
     {
-        image_scene_file_  = image_scene_file;
-        image_target_file_ = image_target_file;
+        scene_source_  = ImageSource::FromFile(image_scene_file);
+        target_source_ = ImageSource::FromFile(image_target_file);
+        display_images_ = true;
     }
 
     //================================================
     // Member Function: ProcessImage
     //================================================
-    void TargetFinderStrategy::ProcessImage()
+    TargetObjectImage TargetFinderStrategy::ProcessImage()
     {
 
-        // Convert jpeg image to opencv matrix
-        Mat image_scene  = imread(image_scene_file_, IMREAD_COLOR);
-        Mat image_target = imread(image_target_file_, IMREAD_COLOR);
-
         //////////////////////////////////////////
         // Draw a box around paper target edge
         // https://learnopencv.com/automatic-document-scanner-using-opencv/
         //////////////////////////////////////////
 
-        // Step (1) Start with morphological operations to get a blank paper target.
-        // Create 5x5 kernel aka structuring element, anchor is at center
-        int morph_size = 2;
-        Mat element = getStructuringElement(MORPH_RECT,Size(2 * morph_size + 1,2 * morph_size + 1),Point(morph_size, morph_size));
+        // Step (1) is only displayed so far, skip it when nothing is shown
+        if (display_images_) {
+            // Shares the decode with FindTarget when it needs full resolution
+            Mat image_scene  = scene_source_.Decode();
+
+            // Step (1) Start with morphological operations to get a blank paper target.
+            // 5x5 rectangle aka structuring element, anchor is at center
+            int morph_size = 2;
+            Size element(2 * morph_size + 1, 2 * morph_size + 1);
 
-        // Repeated Closing operation to remove content from paper target.
-        Mat image_step1;
-        morphologyEx(image_scene, image_step1, MORPH_CLOSE, element, Point(-1, -1), 10);
-        imshow("morphologyEx", image_step1);
+            // Repeated Closing operation to remove content from paper target; done as one
+            // 41x41 closing whose cost does not depend on the kernel size
+            Mat image_step1;
+            Morphology::BlankPaper(image_scene, image_step1, element, 10);
+            imshow("morphologyEx", image_step1);
+        }
 
         // Step (2) Find the paper target in the image
         TargetObjectImage target = FindTarget();
 
-        imshow("LAST IMAGE", target.image_);
-        int k = waitKey(0); // Wait for a keystroke in the window
+        if (display_images_) {
+            imshow("LAST IMAGE", target.image_);
+            int k = waitKey(0); // Wait for a keystroke in the window
+        }
+
+        return target;
     }
 } // Image
\ No newline at end of file
@@ -17,7 +17,12 @@
 #include <string>
 #include <vector>
 #include <iostream>
+#include <memory>
+#include "cancel_token.h"
+#include "debug_sink.h"
+#include "image_source.h"
 #include "target_object_image.h"
+#include "template_pack.h"
 
 namespace TactNib {
 
@@ -27,11 +32,31 @@ namespace TactNib {
             virtual ~TargetFinderStrategy() {
                 std::cout << "Base destructor called." << std::endl;
             }
-            void ProcessImage();
+            TargetObjectImage ProcessImage();
+
+            // Replace the files given to the constructor, e.g. with an uploaded buffer
+            void SetSceneSource(const ImageSource &scene_source) { scene_source_ = scene_source; }
+            void SetTargetSource(const ImageSource &target_source) { target_source_ = target_source; }
+
+            // Use a pre-analyzed template instead of decoding the target image per scene
+            void SetTemplatePack(std::shared_ptr<const TemplatePack> template_pack) { template_pack_ = template_pack; }
+
+            // Show intermediate images in HighGUI windows; must be off when run from worker threads
+            void SetDisplayImages(bool display_images) { display_images_ = display_images; }
+
+            // Hand intermediate images to a background writer; nullptr disables captures
+            void SetDebugSink(std::shared_ptr<DebugSink> debug_sink) { debug_sink_ = debug_sink; }
+
+            // Give up once cancel fires and return what was found so far, see TargetObjectImage::partial_
+            void SetCancelToken(const CancelToken &cancel) { cancel_ = cancel; }
 
         protected:
-            std::string image_scene_file_;
-            std::string image_target_file_;
+            ImageSource scene_source_;
+            ImageSource target_source_;
+            std::shared_ptr<const TemplatePack> template_pack_;
+            bool display_images_;
+            std::shared_ptr<DebugSink> debug_sink_;
+            CancelToken cancel_;
 
         private:
             virtual TargetObjectImage FindTarget() = 0;
@@ -17,7 +17,12 @@ namespace TactNib {
     // Default constructor
     //================================================
     TargetObjectImage::TargetObjectImage() {
-
+        score_ = 0.0;
+        partial_ = false;
+        for (CornerPoint &corner : corner_points_) {
+            corner.x = 0;
+            corner.y = 0;
+        }
     }
 
     // TODO: Convert to class to structure if no method functions required
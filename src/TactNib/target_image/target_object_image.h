@@ -12,6 +12,8 @@
 #ifndef SYSTEM_API_TARGET_OBJECT_IMAGE_H
 #define SYSTEM_API_TARGET_OBJECT_IMAGE_H
 
+#include <string>
+#include <vector>
 #include <opencv2/core.hpp>
 
 namespace TactNib {
@@ -21,6 +23,13 @@ namespace TactNib {
         int x, y;
     };
 
+    // In dewarped (template) pixels
+    struct BulletHole
+    {
+        cv::Point2f center;
+        float radius;
+    };
+
     class TargetObjectImage {
         public:
             // Initialize functions
@@ -28,8 +37,11 @@ namespace TactNib {
 
             // TODO: Create set/get functions for these member variables
             cv::Mat image_;
-            CornerPoint corner_points_[4];
+            CornerPoint corner_points_[4];  // source scene pixels: TL, TR, BR, BL
             double score_;
+            std::string template_name_;     // library template the scene was routed to
+            std::vector<BulletHole> new_holes_;     // holes since the previous frame, see HoleTracker
+            bool partial_;                  // cancelled or out of time: corners may be set without image_ or score_
         private:
 
         protected:
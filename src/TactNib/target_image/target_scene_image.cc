@@ -13,11 +13,18 @@
  *
  * ============================================================================*/
 
+#include <algorithm>
+#include <future>
+#include <memory>
 #include <string>
+#include <thread>
 
 #include "target_scene_image.h"
+#include "cascade_strategy.h"
+#include "contour_strategy.h"
 #include "object_detect_strategy.h"
 #include "opencv_strategy.h"
+#include "thread_pool.h"
 
 namespace TactNib {
 
@@ -27,6 +34,18 @@ namespace TactNib {
     TargetSceneImage::TargetSceneImage()
     {
         target_finder_strategy_ = nullptr;
+        target_finder_strategy_type_ = TargetFinderStrategyType::OpenCvRect;
+        headless_ = false;
+    }
+
+    //================================================
+    // Destructor
+    //  Note: Pending asynchronous requests finish first
+    //================================================
+    TargetSceneImage::~TargetSceneImage()
+    {
+        async_pool_.reset();
+        batch_pool_.reset();
     }
 
     //================================================
@@ -36,17 +55,129 @@ namespace TactNib {
     {
         delete target_finder_strategy_;
 
-        switch(id)
+        target_finder_strategy_type_ = id;
+        target_finder_strategy_ = CreateTargetFinderStrategy(scene_source_, TemplateFor(RouteScene(scene_source_)));
+    }
+
+    //================================================
+    // Member Function: SetFinderConfig
+    //================================================
+    void TargetSceneImage::SetFinderConfig(const FinderConfig &config)
+    {
+        finder_config_ = config;
+        prepared_pack_.reset();
+
+        // Rebuild the current strategy so it picks up the new configuration
+        if (target_finder_strategy_ != nullptr) {
+            SetTargetFinderStrategy(target_finder_strategy_type_);
+        }
+    }
+
+    //================================================
+    // Member Function: SetFinderConfigFile
+    //  Note: Missing or unreadable files keep the current configuration
+    //================================================
+    bool TargetSceneImage::SetFinderConfigFile(std::string config_file)
+    {
+        FinderConfig config = finder_config_;
+        if (!LoadFinderConfig(config_file, config)) {
+            return false;
+        }
+        SetFinderConfig(config);
+        return true;
+    }
+
+    //================================================
+    // Member Function: Snapshot
+    //================================================
+    TargetSceneImage::FinderSettings TargetSceneImage::Snapshot() const
+    {
+        FinderSettings settings;
+        settings.strategy_type = target_finder_strategy_type_;
+        settings.config = finder_config_;
+        settings.target_source = target_source_;
+        settings.template_pack = template_pack_ != nullptr ? template_pack_ : prepared_pack_;
+        settings.template_library = template_library_;
+        settings.headless = headless_;
+        settings.debug_sink = debug_sink_;
+        return settings;
+    }
+
+    //================================================
+    // Member Function: CreateTargetFinderStrategy
+    //================================================
+    TargetFinderStrategy *TargetSceneImage::CreateTargetFinderStrategy(const FinderSettings &settings,
+                                                                       const ImageSource &scene_source,
+                                                                       std::shared_ptr<const TemplatePack> template_pack)
+    {
+        TargetFinderStrategy *strategy = nullptr;
+
+        switch(settings.strategy_type)
         {
-            case TargetFinderStrategyType::ObjectDetect:
-                target_finder_strategy_ = new ObjectDetectStrategy(image_scene_file_, image_target_file_);
+            case TargetFinderStrategyType::ObjectDetect: {
+                auto *detect_strategy = new ObjectDetectStrategy(std::string(), std::string());
+                detect_strategy->SetConfig(settings.config);
+                strategy = detect_strategy;
+                break;
+            }
+            case TargetFinderStrategyType::OpenCvRect: {
+                auto *opencv_strategy = new OpenCvStrategy(std::string(), std::string());
+                opencv_strategy->SetConfig(settings.config);
+                strategy = opencv_strategy;
                 break;
-            case TargetFinderStrategyType::OpenCvRect:
-                target_finder_strategy_ = new OpenCvStrategy(image_scene_file_, image_target_file_);
+            }
+            case TargetFinderStrategyType::Cascade: {
+                auto *cascade_strategy = new CascadeStrategy(std::string(), std::string());
+                cascade_strategy->SetConfig(settings.config);
+                strategy = cascade_strategy;
                 break;
+            }
+            case TargetFinderStrategyType::ContourQuad: {
+                auto *contour_strategy = new ContourStrategy(std::string(), std::string());
+                contour_strategy->SetConfig(settings.config);
+                strategy = contour_strategy;
+                break;
+            }
             default:
                 break;
         }
+
+        if (strategy != nullptr) {
+            strategy->SetSceneSource(scene_source);
+            strategy->SetTargetSource(settings.target_source);
+            strategy->SetTemplatePack(template_pack);
+            strategy->SetDisplayImages(!settings.headless);
+            strategy->SetDebugSink(settings.debug_sink);
+        }
+        return strategy;
+    }
+
+    TargetFinderStrategy *TargetSceneImage::CreateTargetFinderStrategy(const ImageSource &scene_source,
+                                                                       std::shared_ptr<const TemplatePack> template_pack) const
+    {
+        return CreateTargetFinderStrategy(Snapshot(), scene_source, template_pack);
+    }
+
+    //================================================
+    // Member Function: SetHeadless
+    //================================================
+    void TargetSceneImage::SetHeadless(bool headless)
+    {
+        headless_ = headless;
+        if (target_finder_strategy_ != nullptr) {
+            target_finder_strategy_->SetDisplayImages(!headless_);
+        }
+    }
+
+    //================================================
+    // Member Function: SetDebugSink
+    //================================================
+    void TargetSceneImage::SetDebugSink(std::shared_ptr<DebugSink> debug_sink)
+    {
+        debug_sink_ = debug_sink;
+        if (target_finder_strategy_ != nullptr) {
+            target_finder_strategy_->SetDebugSink(debug_sink_);
+        }
     }
 
     //================================================
@@ -54,7 +185,18 @@ namespace TactNib {
     //================================================
     void TargetSceneImage::SetSceneImage(std::string image_file)
     {
-        image_scene_file_ = image_file;
+        SetSceneImage(ImageSource::FromFile(image_file));
+    }
+
+    void TargetSceneImage::SetSceneImage(const ImageSource &scene_source)
+    {
+        scene_source_ = scene_source;
+        if (target_finder_strategy_ != nullptr) {
+            target_finder_strategy_->SetSceneSource(scene_source_);
+            if (template_library_ != nullptr) {
+                target_finder_strategy_->SetTemplatePack(TemplateFor(RouteScene(scene_source_)));
+            }
+        }
     }
 
     //================================================
@@ -62,7 +204,81 @@ namespace TactNib {
     //================================================
     void TargetSceneImage::SetTargetImage(std::string image_file)
     {
-        image_target_file_ = image_file;
+        SetTargetImage(ImageSource::FromFile(image_file));
+    }
+
+    void TargetSceneImage::SetTargetImage(const ImageSource &target_source)
+    {
+        target_source_ = target_source;
+        prepared_pack_.reset();
+
+        // A new strategy, since the current one keeps its analysis of the old target
+        if (target_finder_strategy_ != nullptr) {
+            SetTargetFinderStrategy(target_finder_strategy_type_);
+        }
+    }
+
+    //================================================
+    // Member Function: SetTemplatePack
+    //  Note: Memory maps a pack built by template_pack_tool
+    //================================================
+    bool TargetSceneImage::SetTemplatePack(std::string pack_file)
+    {
+        template_pack_ = TemplatePack::Load(pack_file);
+        prepared_pack_.reset();
+
+        // A new strategy, since the current one keeps its analysis of the old template
+        if (target_finder_strategy_ != nullptr) {
+            SetTargetFinderStrategy(target_finder_strategy_type_);
+        }
+        return template_pack_ != nullptr;
+    }
+
+    //================================================
+    // Member Function: SetTemplateLibrary
+    //================================================
+    void TargetSceneImage::SetTemplateLibrary(std::shared_ptr<const TemplateLibrary> template_library)
+    {
+        template_library_ = template_library;
+        if (target_finder_strategy_ != nullptr) {
+            target_finder_strategy_->SetTemplatePack(TemplateFor(RouteScene(scene_source_)));
+        }
+    }
+
+    //================================================
+    // Member Function: RouteScene
+    //================================================
+    int TargetSceneImage::RouteScene(const FinderSettings &settings, const ImageSource &scene_source)
+    {
+        const TemplateLibrary *library = settings.template_library.get();
+        if (library == nullptr || library->size() == 0 || scene_source.empty()) {
+            return -1;
+        }
+        return library->Retrieve(scene_source);
+    }
+
+    int TargetSceneImage::RouteScene(const ImageSource &scene_source) const
+    {
+        return RouteScene(Snapshot(), scene_source);
+    }
+
+    //================================================
+    // Member Function: TemplateFor
+    //  Note: Falls back to the single template when the scene was not routed: the
+    //        loaded pack, else the analysis of the target image if there is one
+    //================================================
+    std::shared_ptr<const TemplatePack> TargetSceneImage::TemplateFor(const FinderSettings &settings,
+                                                                      int library_index)
+    {
+        if (library_index < 0) {
+            return settings.template_pack;
+        }
+        return settings.template_library->pack(library_index);
+    }
+
+    std::shared_ptr<const TemplatePack> TargetSceneImage::TemplateFor(int library_index) const
+    {
+        return TemplateFor(Snapshot(), library_index);
     }
 
     //================================================
@@ -74,4 +290,192 @@ namespace TactNib {
         target_finder_strategy_->ProcessImage();
     }
 
+    //================================================
+    // Member Function: ProcessScenes
+    //================================================
+    std::vector<TargetObjectImage> TargetSceneImage::ProcessScenes(const std::vector<std::string> &scene_files,
+                                                                   unsigned int num_threads)
+    {
+        std::vector<ImageSource> scenes;
+        scenes.reserve(scene_files.size());
+        for (const std::string &scene_file : scene_files) {
+            scenes.push_back(ImageSource::FromFile(scene_file));
+        }
+        return ProcessScenes(scenes, num_threads);
+    }
+
+    std::vector<TargetObjectImage> TargetSceneImage::ProcessScenes(const std::vector<ImageSource> &scenes,
+                                                                   unsigned int num_threads)
+    {
+        PrepareTemplatePack();
+
+        // The workers are kept for the next batch; only a different count replaces them
+        if (num_threads == 0) {
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        if (batch_pool_ == nullptr || batch_pool_->size() != num_threads) {
+            batch_pool_.reset();
+            batch_pool_ = std::make_unique<ThreadPool>(num_threads);
+        }
+        ThreadPool &pool = *batch_pool_;
+
+        if (target_finder_strategy_type_ == TargetFinderStrategyType::ObjectDetect) {
+            return DetectScenes(scenes, pool);
+        }
+
+        auto settings = std::make_shared<const FinderSettings>(Snapshot());
+        std::vector<std::future<TargetObjectImage>> pending;
+        pending.reserve(scenes.size());
+        for (const ImageSource &scene : scenes) {
+            pending.push_back(pool.Submit([settings, scene]() { return FindInScene(*settings, scene, CancelToken()); }));
+        }
+
+        std::vector<TargetObjectImage> results;
+        results.reserve(scenes.size());
+        for (size_t i = 0; i < pending.size(); i++) {
+            try {
+                results.push_back(pending[i].get());
+            } catch (const std::exception &e) {
+                std::cout << "ProcessScenes: " << scenes[i].name() << " failed: " << e.what() << std::endl;
+                results.emplace_back();
+            }
+        }
+        return results;
+    }
+
+    //================================================
+    // Member Function: ProcessSceneAsync
+    //================================================
+    std::future<TargetObjectImage> TargetSceneImage::ProcessSceneAsync(const ImageSource &scene, CancelToken cancel)
+    {
+        // On the caller's thread, so a request does not spend its time budget on the
+        // template; the worker only reads the settings copied here
+        PrepareTemplatePack();
+        if (async_pool_ == nullptr) {
+            async_pool_ = std::make_unique<ThreadPool>(1);
+        }
+        FinderSettings settings = Snapshot();
+        return async_pool_->Submit([settings, scene, cancel]() { return FindInScene(settings, scene, cancel); });
+    }
+
+    //================================================
+    // Member Function: PrepareTemplatePack
+    //================================================
+    void TargetSceneImage::PrepareTemplatePack()
+    {
+        // Analyze the template once; every worker shares the read-only pack, and the
+        // cascade's other stage is analyzed once into the pack as well
+        if (template_pack_ == nullptr && prepared_pack_ == nullptr && template_library_ == nullptr &&
+            (target_finder_strategy_type_ == TargetFinderStrategyType::OpenCvRect ||
+             target_finder_strategy_type_ == TargetFinderStrategyType::Cascade)) {
+            OpenCvStrategy prototype(std::string(), std::string());
+            prototype.SetTargetSource(target_source_);
+            prototype.SetConfig(finder_config_);
+            if (prototype.PrepareTemplate()) {
+                prepared_pack_ = prototype.active_template();
+            }
+            if (target_finder_strategy_ != nullptr) {
+                target_finder_strategy_->SetTemplatePack(prepared_pack_);
+            }
+        }
+    }
+
+    //================================================
+    // Member Function: FindInScene
+    //================================================
+    TargetObjectImage TargetSceneImage::FindInScene(const FinderSettings &settings, const ImageSource &scene,
+                                                    const CancelToken &cancel)
+    {
+        // Abandoned while it waited for the worker
+        if (cancel.StopRequested()) {
+            TargetObjectImage result;
+            result.partial_ = true;
+            return result;
+        }
+
+        // Routing runs on the worker too; it is cheap next to the finder
+        int library_index = RouteScene(settings, scene);
+        std::unique_ptr<TargetFinderStrategy> strategy(
+                CreateTargetFinderStrategy(settings, scene, TemplateFor(settings, library_index)));
+        if (strategy == nullptr) {
+            return TargetObjectImage();
+        }
+        strategy->SetDisplayImages(false);
+        strategy->SetCancelToken(cancel);
+        TargetObjectImage result = strategy->ProcessImage();
+        if (library_index >= 0) {
+            result.template_name_ = settings.template_library->name(library_index);
+        }
+        return result;
+    }
+
+    //================================================
+    // Member Function: DetectScenes
+    //  Note: Each worker runs detect_batch scenes through the network in one pass.
+    //        Scenes are not routed; the single template scores every batch.
+    //================================================
+    std::vector<TargetObjectImage> TargetSceneImage::DetectScenes(const std::vector<ImageSource> &scenes,
+                                                                  ThreadPool &pool)
+    {
+        const size_t batch = static_cast<size_t>(std::max(finder_config_.detect_batch, 1));
+        std::vector<std::future<std::vector<TargetObjectImage>>> pending;
+        for (size_t first = 0; first < scenes.size(); first += batch) {
+            std::vector<ImageSource> group(scenes.begin() + first,
+                                           scenes.begin() + std::min(first + batch, scenes.size()));
+            pending.push_back(pool.Submit([this, group]() {
+                ObjectDetectStrategy strategy(std::string(), std::string());
+                strategy.SetConfig(finder_config_);
+                strategy.SetTargetSource(target_source_);
+                strategy.SetTemplatePack(TemplateFor(-1));
+                strategy.SetDisplayImages(false);
+
+                std::vector<cv::Mat> images;
+                images.reserve(group.size());
+                for (const ImageSource &scene : group) {
+                    images.push_back(scene.Decode());
+                    if (images.back().empty()) {
+                        std::cout << "Unable to read scene image " << scene.name() << std::endl;
+                    }
+                }
+                return strategy.FindTargets(images);
+            }));
+        }
+
+        std::vector<TargetObjectImage> results;
+        results.reserve(scenes.size());
+        for (size_t i = 0; i < pending.size(); i++) {
+            size_t count = std::min(batch, scenes.size() - i * batch);
+            try {
+                std::vector<TargetObjectImage> group = pending[i].get();
+                results.insert(results.end(), group.begin(), group.end());
+            } catch (const std::exception &e) {
+                std::cout << "ProcessScenes: batch from " << scenes[i * batch].name() << " failed: " << e.what()
+                          << std::endl;
+                results.resize(results.size() + count);
+            }
+        }
+        return results;
+    }
+
+    //================================================
+    // Member Function: ProcessStream
+    //================================================
+    StreamStats TargetSceneImage::ProcessStream(const std::string &source, const StreamCallback &on_result,
+                                                StreamOptions options)
+    {
+        if (target_finder_strategy_type_ != TargetFinderStrategyType::OpenCvRect) {
+            std::cout << "ProcessStream: NOT SUPPORTED for this finder strategy" << std::endl;
+            return StreamStats();
+        }
+
+        auto strategy = std::make_shared<OpenCvStrategy>(std::string(), std::string());
+        strategy->SetTargetSource(target_source_);
+        strategy->SetConfig(finder_config_);
+        strategy->SetTemplatePack(TemplateFor(-1));
+        strategy->SetDebugSink(debug_sink_);
+
+        TargetStream stream(strategy, options);
+        return stream.Run(source, on_result);
+    }
+
 } // TactNib
\ No newline at end of file
@@ -15,36 +15,141 @@
 #ifndef SYSTEM_API_TARGET_SCENE_IMAGE_H
 #define SYSTEM_API_TARGET_SCENE_IMAGE_H
 
+#include <future>
+#include <memory>
 #include <string>
+#include <vector>
+#include "cancel_token.h"
+#include "debug_sink.h"
+#include "finder_config.h"
+#include "image_source.h"
 #include "target_finder_strategy.h"
+#include "target_stream.h"
+#include "template_library.h"
+#include "template_pack.h"
 
 namespace TactNib {
 
+    class ThreadPool;
+
     enum class TargetFinderStrategyType
     {
-        ObjectDetect, OpenCvRect
+        ObjectDetect, OpenCvRect, Cascade, ContourQuad
     };
 
     class TargetSceneImage {
         public:
             // Initialize functions
             TargetSceneImage();
+            ~TargetSceneImage();
 
             void SetTargetFinderStrategy(TargetFinderStrategyType);
+            void SetFinderConfig(const FinderConfig &);
+            bool SetFinderConfigFile(std::string);
 
             // Class Support functions
             void SetSceneImage(std::string);
+            void SetSceneImage(const ImageSource &);
             void SetTargetImage(std::string);
+            void SetTargetImage(const ImageSource &);
+            bool SetTemplatePack(std::string);
+
+            // Route every scene to the library template it shows before finding it; replaces
+            // the target image and template pack for scenes. ProcessStream keeps one template.
+            void SetTemplateLibrary(std::shared_ptr<const TemplateLibrary>);
+
+            // Headless: no HighGUI windows, no waitKey and no drawing; required on the board
+            void SetHeadless(bool);
+
+            // Receive matches/align/overlay images on a background writer, also when headless
+            void SetDebugSink(std::shared_ptr<DebugSink>);
 
             // Image processing function
             void ProcessScene();
 
+            // Find the target in scene on a background thread, one request at a time. The
+            // finder stops between stages, and inside matching and SSIM, once cancel is
+            // cancelled or its deadline passes; the result is then partial_, e.g. corners
+            // without a score. Cancel superseded frames so the next one starts at once.
+            // A request uses the configuration, target and templates set when it was made.
+            std::future<TargetObjectImage> ProcessSceneAsync(const ImageSource &scene,
+                                                             CancelToken cancel = CancelToken());
+
+            // Score many scenes against the same template on a pool of worker threads.
+            // Results are returned in the order of scene_files; zero threads uses every core.
+            // The workers are kept for later calls with the same thread count. OpenCV's own
+            // thread count is process wide and left alone; with a worker per core, call
+            // cv::setNumThreads(1) once at startup so OpenCV does not oversubscribe them.
+            std::vector<TargetObjectImage> ProcessScenes(const std::vector<std::string> &scene_files,
+                                                         unsigned int num_threads = 0);
+
+            // Same for scenes already in memory, e.g. uploaded JPEG buffers
+            std::vector<TargetObjectImage> ProcessScenes(const std::vector<ImageSource> &scenes,
+                                                         unsigned int num_threads = 0);
+
+            // Score frames from a video file or GStreamer pipeline with the finder stages
+            // overlapped on separate threads. Only the OpenCvRect strategy supports streaming.
+            StreamStats ProcessStream(const std::string &source, const StreamCallback &on_result,
+                                      StreamOptions options = StreamOptions());
+
         private:
+            // What a worker reads to find a target, copied on the caller's thread so the
+            // setters may run while asynchronous requests are pending
+            struct FinderSettings
+            {
+                TargetFinderStrategyType strategy_type;
+                FinderConfig config;
+                ImageSource target_source;
+                std::shared_ptr<const TemplatePack> template_pack;      // for scenes not routed
+                std::shared_ptr<const TemplateLibrary> template_library;
+                bool headless;
+                std::shared_ptr<DebugSink> debug_sink;
+            };
+            FinderSettings Snapshot() const;
+
+            // The overloads without settings use the current ones
+            static TargetFinderStrategy *CreateTargetFinderStrategy(const FinderSettings &settings,
+                                                                    const ImageSource &scene_source,
+                                                                    std::shared_ptr<const TemplatePack> template_pack);
+            TargetFinderStrategy *CreateTargetFinderStrategy(const ImageSource &scene_source,
+                                                             std::shared_ptr<const TemplatePack> template_pack) const;
+
+            // Library index of the scene's template, -1 without a library
+            static int RouteScene(const FinderSettings &settings, const ImageSource &scene_source);
+            int RouteScene(const ImageSource &scene_source) const;
+            static std::shared_ptr<const TemplatePack> TemplateFor(const FinderSettings &settings, int library_index);
+            std::shared_ptr<const TemplatePack> TemplateFor(int library_index) const;
+
+            // Analyze the target image once into prepared_pack_ for the feature strategies
+            void PrepareTemplatePack();
+
+            // Route, create a headless strategy and find the target in one scene
+            static TargetObjectImage FindInScene(const FinderSettings &settings, const ImageSource &scene,
+                                                 const CancelToken &cancel);
+
+            // ProcessScenes for ObjectDetect, batched through the network
+            std::vector<TargetObjectImage> DetectScenes(const std::vector<ImageSource> &scenes, ThreadPool &pool);
+
             TargetFinderStrategy *target_finder_strategy_;
+            TargetFinderStrategyType target_finder_strategy_type_;
+            FinderConfig finder_config_;
+
+            ImageSource scene_source_;
+            ImageSource target_source_;
+            std::shared_ptr<const TemplatePack> template_pack_;     // loaded by SetTemplatePack
+            std::shared_ptr<const TemplateLibrary> template_library_;
+
+            // Analysis of target_source_ shared by the workers when there is no pack;
+            // cleared whenever the target, the pack or the configuration changes
+            std::shared_ptr<const TemplatePack> prepared_pack_;
+            bool headless_;
+            std::shared_ptr<DebugSink> debug_sink_;
+
+            // Worker of ProcessSceneAsync, started by the first request
+            std::unique_ptr<ThreadPool> async_pool_;
 
-            // std::filesystem is not available on the embedded board, use std::string in the meantime
-            std::string image_scene_file_;
-            std::string image_target_file_;
+            // Workers of ProcessScenes, started by the first batch
+            std::unique_ptr<ThreadPool> batch_pool_;
 
         protected:
     }; // TargetSceneImage
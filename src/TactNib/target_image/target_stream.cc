@@ -0,0 +1,228 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: target_stream.cc
+ * Purpose:	  Streaming mode for the OpenCV target finder. Frames are read from a
+ *            video file or a GStreamer pipeline and pushed through the finder
+ *            stages, each stage on its own thread, connected by bounded queues.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <opencv2/videoio.hpp>
+
+#include "bounded_queue.h"
+#include "finder_workspace.h"
+#include "target_stream.h"
+
+namespace TactNib {
+
+    namespace {
+        using SceneQueue = BoundedQueue<SceneContext>;
+
+        // Run one pipeline stage until its input is closed and drained
+        std::thread StartStage(SceneQueue &input, SceneQueue &output, std::atomic<int64_t> &failed,
+                               std::function<void(SceneContext &)> work)
+        {
+            return std::thread([&input, &output, &failed, work]() {
+                SceneContext context;
+                while (input.Pop(context)) {
+                    if (context.valid) {
+                        try {
+                            work(context);
+                        } catch (const std::exception &e) {
+                            std::cout << "Stream: frame " << context.frame_index << " failed: " << e.what() << std::endl;
+                            context.valid = false;
+                            failed++;
+                        }
+                    }
+                    if (!output.Push(std::move(context))) {
+                        break;
+                    }
+                }
+                output.Close();
+            });
+        }
+    }
+
+    //================================================
+    // Default constructor
+    //================================================
+    TargetStream::TargetStream(std::shared_ptr<OpenCvStrategy> strategy, StreamOptions options)
+    {
+        strategy_ = strategy;
+        options_ = options;
+        stop_ = false;
+
+        // HighGUI must not be driven from the stage threads
+        strategy_->SetDisplayImages(false);
+    }
+
+    //================================================
+    // Member Function: Run
+    //================================================
+    StreamStats TargetStream::Run(const std::string &source, const StreamCallback &on_result)
+    {
+        StreamStats stats;
+
+        // Template side work is done once, before the first frame
+        if (!strategy_->PrepareTemplate()) {
+            std::cout << "Stream: unable to prepare the template" << std::endl;
+            stop_ = false;
+            return stats;
+        }
+
+        VideoCapture capture;
+        if (source.find('!') != std::string::npos) {
+            capture.open(source, CAP_GSTREAMER);
+        } else {
+            capture.open(source);
+        }
+        if (!capture.isOpened()) {
+            std::cout << "Stream: unable to open " << source << std::endl;
+            stop_ = false;
+            return stats;
+        }
+
+        // decode -> brightness/scale -> detect/extract -> match/filter/homography -> warp/score
+        SceneQueue decoded(options_.queue_depth);
+        SceneQueue prepared(options_.queue_depth);
+        SceneQueue detected(options_.queue_depth);
+        SceneQueue located(options_.queue_depth);
+
+        // The last located frame tells the detect stage where to look in the next one;
+        // a frame that is not located clears it so the next frame searches everywhere
+        std::mutex location_mutex;
+        Mat location;
+
+        // Frames whose stage work or callback threw; the stream goes on without them
+        std::atomic<int64_t> frames_failed(0);
+
+        const OpenCvStrategy &strategy = *strategy_;
+        std::thread prepare_stage = StartStage(decoded, prepared, frames_failed, [&strategy](SceneContext &context) {
+            strategy.PrepareScene(context);
+        });
+        std::thread detect_stage = StartStage(prepared, detected, frames_failed,
+                                              [&strategy, &location_mutex, &location](SceneContext &context) {
+            {
+                std::lock_guard<std::mutex> lock(location_mutex);
+                context.h_obj_to_scene_hint = location;
+            }
+            strategy.DetectFeatures(context);
+        });
+        std::thread locate_stage = StartStage(detected, located, frames_failed,
+                                              [&strategy, &location_mutex, &location](SceneContext &context) {
+            strategy.MatchFeatures(context);
+            strategy.EstimateHomography(context);
+            strategy.RefineAlignment(context);
+
+            std::lock_guard<std::mutex> lock(location_mutex);
+            location = context.valid ? context.h_obj_to_scene.clone() : Mat();
+        });
+
+        int64_t frames_scored = 0;
+        const bool track_holes = options_.track_holes;
+        HoleTracker hole_tracker(options_.hole_options);
+        std::thread score_stage([&located, &strategy, &on_result, &frames_scored, &frames_failed, &location_mutex,
+                                 &location, track_holes, &hole_tracker]() {
+            SceneContext context;
+            while (located.Pop(context)) {
+                // Frames that failed before the locate stage never reached it
+                if (!context.valid) {
+                    std::lock_guard<std::mutex> lock(location_mutex);
+                    location = Mat();
+                }
+                TargetObjectImage result;
+                try {
+                    strategy.WarpAndScore(context);
+                } catch (const std::exception &e) {
+                    std::cout << "Stream: frame " << context.frame_index << " failed: " << e.what() << std::endl;
+                    context.valid = false;
+                    frames_failed++;
+                }
+                frames_scored++;
+
+                // Frames arrive in order here, so each one is compared with the last located frame
+                try {
+                    result = strategy.MakeResult(context);
+                    if (track_holes && context.valid) {
+                        result.new_holes_ = hole_tracker.Update(context.image_dewarp);
+                    }
+                } catch (const std::exception &e) {
+                    std::cout << "Stream: frame " << context.frame_index << " failed: " << e.what() << std::endl;
+                    frames_failed++;
+                    result = TargetObjectImage();
+                }
+
+                // An exception from the caller's callback would end the stage thread, and
+                // with it the process
+                if (on_result) {
+                    try {
+                        on_result(context.frame_index, result);
+                    } catch (const std::exception &e) {
+                        std::cout << "Stream: frame " << context.frame_index << " callback failed: " << e.what()
+                                  << std::endl;
+                        frames_failed++;
+                    } catch (...) {
+                        std::cout << "Stream: frame " << context.frame_index << " callback failed" << std::endl;
+                        frames_failed++;
+                    }
+                }
+            }
+        });
+
+        auto start_time = std::chrono::steady_clock::now();
+        int64_t frame_index = 0;
+        MatPool frame_pool;
+        Size frame_size;
+        int frame_type = CV_8UC3;
+        while (!stop_ && (options_.max_frames < 0 || frame_index < options_.max_frames)) {
+            // Only a buffer no frame in the pipeline still uses; read() decodes into it
+            // when the size is unchanged
+            Mat frame = frame_pool.Acquire(frame_size, frame_type);
+            if (!capture.read(frame) || frame.empty()) {
+                break;
+            }
+            frame_size = frame.size();
+            frame_type = frame.type();
+            stats.frames_read++;
+
+            SceneContext context;
+            context.frame_index = frame_index++;
+            context.image_scene = frame;
+            if (options_.drop_frames_when_busy) {
+                if (!decoded.TryPush(std::move(context))) {
+                    stats.frames_dropped++;
+                }
+            } else if (!decoded.Push(std::move(context))) {
+                break;
+            }
+        }
+        decoded.Close();
+
+        prepare_stage.join();
+        detect_stage.join();
+        locate_stage.join();
+        score_stage.join();
+        auto end_time = std::chrono::steady_clock::now();
+
+        // A Stop() before Run() stops this run; the next run starts fresh
+        stop_ = false;
+
+        stats.frames_scored = frames_scored;
+        stats.frames_failed = frames_failed;
+        stats.elapsed_seconds = std::chrono::duration<double>(end_time - start_time).count();
+        if (stats.elapsed_seconds > 0.0) {
+            stats.frames_per_second = stats.frames_scored / stats.elapsed_seconds;
+        }
+        return stats;
+    }
+
+} // TactNib
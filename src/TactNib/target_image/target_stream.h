@@ -0,0 +1,79 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: target_stream.h
+ * Purpose:	  Streaming mode for the OpenCV target finder. Frames are read from a
+ *            video file or a GStreamer pipeline and pushed through the finder
+ *            stages, each stage on its own thread, connected by bounded queues.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_TARGET_STREAM_H
+#define SYSTEM_API_TARGET_STREAM_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include "hole_tracker.h"
+#include "opencv_strategy.h"
+#include "target_object_image.h"
+
+namespace TactNib {
+
+    struct StreamOptions
+    {
+        // Frames allowed to wait between two stages
+        size_t queue_depth = 2;
+
+        // Live cameras: drop a new frame instead of blocking the capture when the pipeline is full
+        bool drop_frames_when_busy = false;
+
+        // Stop after this many frames; negative reads until the source ends
+        int64_t max_frames = -1;
+
+        // Report holes that appeared since the previous located frame in
+        // TargetObjectImage::new_holes_, see HoleTracker
+        bool track_holes = false;
+        HoleTrackerOptions hole_options;
+    };
+
+    struct StreamStats
+    {
+        int64_t frames_read = 0;
+        int64_t frames_dropped = 0;
+        int64_t frames_scored = 0;
+        int64_t frames_failed = 0;      // an exception in a stage or in the callback
+        double elapsed_seconds = 0.0;
+        double frames_per_second = 0.0;
+    };
+
+    // Called on the scoring thread, in frame order, once per frame that was not dropped
+    using StreamCallback = std::function<void(int64_t frame_index, const TargetObjectImage &)>;
+
+    class TargetStream {
+        public:
+            TargetStream(std::shared_ptr<OpenCvStrategy>, StreamOptions = StreamOptions());
+
+            // Blocks until the source ends, max_frames is reached, or Stop() is called.
+            // A source containing '!' is opened as a GStreamer pipeline, anything else
+            // as a video file, e.g. "videotestsrc ! videoconvert ! appsink".
+            StreamStats Run(const std::string &source, const StreamCallback &on_result);
+
+            // Stop reading frames; frames already in the pipeline are still scored. Also
+            // stops a Run() that has not started yet; the flag clears when a run ends.
+            void Stop() { stop_ = true; }
+
+        private:
+            std::shared_ptr<OpenCvStrategy> strategy_;
+            StreamOptions options_;
+            std::atomic<bool> stop_;
+    };
+
+} // TactNib
+
+#endif //SYSTEM_API_TARGET_STREAM_H
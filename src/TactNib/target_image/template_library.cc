@@ -0,0 +1,288 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: template_library.cc
+ * Purpose:	  Any number of paper target templates, with a bag of visual words
+ *            index that tells which of them a scene shows. Routing a scene costs
+ *            one small ORB pass and a histogram per template, so the full finder
+ *            runs once per scene however many templates the library holds.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <opencv2/features2d.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "opencv_algo.h"
+#include "template_library.h"
+
+using namespace cv;
+
+namespace TactNib {
+
+    struct TemplateLibrary::Index
+    {
+        Mat vocabulary;         // words x 256 bits as CV_32F
+        Mat idf;                // 1 x words
+        Mat histograms;         // templates x words, tf-idf rows of unit length
+    };
+
+    namespace {
+        // Retrieval works on small grayscale images, whatever the finder configuration
+        const int kRetrievalHeight = 480;
+        const int kRetrievalFeatures = 500;
+
+        // Vocabulary size and the most descriptors k-means is trained on
+        const int kMaxWords = 256;
+        const int kDescriptorsPerWord = 8;
+        const int kMaxTrainingRows = 32768;
+
+        //================================================
+        // Function: RetrievalDescriptors
+        //  Note: ORB bits unpacked to 0/1 floats, so the squared L2 distance of two
+        //        rows is their Hamming distance and k-means applies
+        //================================================
+        Mat RetrievalDescriptors(const Mat &image)
+        {
+            if (image.empty()) {
+                return Mat();
+            }
+            Mat gray;
+            if (image.channels() == 3) {
+                cvtColor(image, gray, COLOR_BGR2GRAY);
+            } else {
+                gray = image;
+            }
+            if (gray.rows > kRetrievalHeight) {
+                double scale = static_cast<double>(kRetrievalHeight) / gray.rows;
+                Mat reduced;
+                resize(gray, reduced, Size(), scale, scale, INTER_AREA);
+                gray = reduced;
+            }
+
+            // Feature2D objects are not shared between threads
+            thread_local Ptr<ORB> orb = ORB::create(kRetrievalFeatures);
+            std::vector<KeyPoint> keypoints;
+            Mat binary;
+            orb->detectAndCompute(gray, noArray(), keypoints, binary);
+
+            Mat bits(binary.rows, binary.cols * 8, CV_32F);
+            for (int i = 0; i < binary.rows; i++) {
+                const uchar *in = binary.ptr<uchar>(i);
+                float *out = bits.ptr<float>(i);
+                for (int b = 0; b < binary.cols * 8; b++) {
+                    out[b] = static_cast<float>((in[b >> 3] >> (7 - (b & 7))) & 1);
+                }
+            }
+            return bits;
+        }
+
+        //================================================
+        // Function: WordCounts
+        //================================================
+        Mat WordCounts(const Mat &descriptors, const Mat &vocabulary)
+        {
+            Mat counts = Mat::zeros(1, vocabulary.rows, CV_32F);
+            if (descriptors.empty()) {
+                return counts;
+            }
+            Mat distances;
+            Mat nearest;
+            batchDistance(descriptors, vocabulary, distances, CV_32F, nearest, NORM_L2SQR, 1);
+            for (int i = 0; i < nearest.rows; i++) {
+                counts.at<float>(0, nearest.at<int>(i, 0)) += 1.0f;
+            }
+            return counts;
+        }
+
+        //================================================
+        // Function: WeightedHistogram
+        //================================================
+        Mat WeightedHistogram(const Mat &counts, const Mat &idf)
+        {
+            Mat histogram;
+            multiply(counts, idf, histogram);
+            double length = norm(histogram);
+            if (length > 0.0) {
+                histogram /= length;
+            }
+            return histogram;
+        }
+    }
+
+    //================================================
+    // Default constructor
+    //================================================
+    TemplateLibrary::TemplateLibrary(size_t ssim_cache_size)
+        : ssim_cache_(std::make_shared<SsimEngineCache>(ssim_cache_size)) {}
+
+    //================================================
+    // Member Function: Add
+    //================================================
+    bool TemplateLibrary::Add(const std::string &name, std::shared_ptr<const TemplatePack> pack)
+    {
+        if (pack == nullptr || pack->image().empty()) {
+            std::cout << "TemplateLibrary: no template for " << name << std::endl;
+            return false;
+        }
+        pack->SetSsimCache(ssim_cache_);
+        entries_.push_back({name, pack});
+
+        std::lock_guard<std::mutex> lock(index_mutex_);
+        index_.reset();
+        return true;
+    }
+
+    //================================================
+    // Member Function: AddImage
+    //================================================
+    bool TemplateLibrary::AddImage(const std::string &name, const std::string &image_file,
+                                   const FinderConfig &config)
+    {
+        Mat image = ImageSource::FromFile(image_file).Decode();
+        if (image.empty()) {
+            std::cout << "TemplateLibrary: unable to read template image " << image_file << std::endl;
+            return false;
+        }
+
+        // Same template side analysis as OpenCvStrategy::PrepareTemplate
+        Mat roi_mask;
+        if (config.template_roi) {
+            roi_mask = OpencvAlgo::CreateMarkerMask(image.size(), config.marker_top_margin, config.marker_left_margin);
+        }
+        return Add(name, TemplatePack::Create(image, config.detector_type, config.extract_type,
+                                              config.max_features, roi_mask));
+    }
+
+    //================================================
+    // Member Function: AddPack
+    //================================================
+    bool TemplateLibrary::AddPack(const std::string &name, const std::string &pack_file)
+    {
+        return Add(name, TemplatePack::Load(pack_file));
+    }
+
+    //================================================
+    // Member Function: GetIndex
+    //  Note: k-means vocabulary over the retrieval descriptors of every template,
+    //        with words weighted by inverse document frequency
+    //================================================
+    std::shared_ptr<const TemplateLibrary::Index> TemplateLibrary::GetIndex() const
+    {
+        std::lock_guard<std::mutex> lock(index_mutex_);
+        if (index_ != nullptr || entries_.empty()) {
+            return index_;
+        }
+
+        std::vector<Mat> descriptors(entries_.size());
+        parallel_for_(Range(0, static_cast<int>(entries_.size())), [&](const Range &range) {
+            for (int i = range.start; i < range.end; i++) {
+                descriptors[i] = RetrievalDescriptors(entries_[i].pack->image());
+            }
+        });
+
+        std::vector<Mat> featured;
+        for (const Mat &rows : descriptors) {
+            if (!rows.empty()) {
+                featured.push_back(rows);
+            }
+        }
+        Mat all;
+        if (!featured.empty()) {
+            vconcat(featured, all);
+        }
+        if (all.rows == 0) {
+            std::cout << "TemplateLibrary: no features on any template" << std::endl;
+            return nullptr;
+        }
+
+        // Evenly spaced rows keep every template in the training set
+        Mat training = all;
+        if (all.rows > kMaxTrainingRows) {
+            training.create(kMaxTrainingRows, all.cols, all.type());
+            for (int i = 0; i < kMaxTrainingRows; i++) {
+                all.row(static_cast<int>(static_cast<int64_t>(i) * all.rows / kMaxTrainingRows)).copyTo(training.row(i));
+            }
+        }
+
+        auto index = std::make_shared<Index>();
+        int words = std::min(kMaxWords, std::max(1, training.rows / kDescriptorsPerWord));
+        Mat labels;
+        kmeans(training, words, labels, TermCriteria(TermCriteria::COUNT + TermCriteria::EPS, 10, 1.0), 1,
+               KMEANS_PP_CENTERS, index->vocabulary);
+
+        // idf = log(templates / templates using the word); a word on every template says nothing
+        std::vector<Mat> counts(entries_.size());
+        Mat document_frequency = Mat::zeros(1, words, CV_32F);
+        for (size_t i = 0; i < entries_.size(); i++) {
+            counts[i] = WordCounts(descriptors[i], index->vocabulary);
+            for (int w = 0; w < words; w++) {
+                if (counts[i].at<float>(0, w) > 0.0f) {
+                    document_frequency.at<float>(0, w) += 1.0f;
+                }
+            }
+        }
+        index->idf.create(1, words, CV_32F);
+        for (int w = 0; w < words; w++) {
+            float used = std::max(document_frequency.at<float>(0, w), 1.0f);
+            index->idf.at<float>(0, w) = static_cast<float>(std::log(entries_.size() / used));
+        }
+
+        // A library of one has all idf weights 0; it still ranks its only template
+        index->histograms.create(static_cast<int>(entries_.size()), words, CV_32F);
+        for (size_t i = 0; i < entries_.size(); i++) {
+            WeightedHistogram(counts[i], index->idf).copyTo(index->histograms.row(static_cast<int>(i)));
+        }
+
+        index_ = index;
+        return index_;
+    }
+
+    //================================================
+    // Member Function: Rank
+    //================================================
+    std::vector<TemplateCandidate> TemplateLibrary::Rank(const Mat &scene, int max_results) const
+    {
+        std::vector<TemplateCandidate> candidates;
+        std::shared_ptr<const Index> index = GetIndex();
+        if (index == nullptr || scene.empty()) {
+            return candidates;
+        }
+
+        Mat histogram = WeightedHistogram(WordCounts(RetrievalDescriptors(scene), index->vocabulary), index->idf);
+        Mat scores = index->histograms * histogram.t();
+
+        candidates.resize(entries_.size());
+        for (int i = 0; i < scores.rows; i++) {
+            candidates[i].index = i;
+            candidates[i].score = scores.at<float>(i, 0);
+        }
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [](const TemplateCandidate &a, const TemplateCandidate &b) { return a.score > b.score; });
+        if (max_results > 0 && candidates.size() > static_cast<size_t>(max_results)) {
+            candidates.resize(max_results);
+        }
+        return candidates;
+    }
+
+    //================================================
+    // Member Function: Retrieve
+    //================================================
+    int TemplateLibrary::Retrieve(const ImageSource &scene) const
+    {
+        if (entries_.size() == 1) {
+            return 0;
+        }
+
+        // A reduced JPEG decode is plenty for the retrieval resolution
+        std::vector<TemplateCandidate> best = Rank(scene.DecodeForHeight(kRetrievalHeight), 1);
+        return best.empty() ? -1 : best[0].index;
+    }
+
+} // TactNib
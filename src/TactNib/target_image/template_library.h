@@ -0,0 +1,90 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: template_library.h
+ * Purpose:	  Any number of paper target templates, with a bag of visual words
+ *            index that tells which of them a scene shows. Routing a scene costs
+ *            one small ORB pass and a histogram per template, so the full finder
+ *            runs once per scene however many templates the library holds.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_TEMPLATE_LIBRARY_H
+#define SYSTEM_API_TEMPLATE_LIBRARY_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "finder_config.h"
+#include "image_source.h"
+#include "template_pack.h"
+
+namespace TactNib {
+
+    struct TemplateCandidate
+    {
+        int index = -1;         // into the library
+        double score = 0.0;     // cosine similarity of the word histograms, 0..1
+    };
+
+    // Add every template before scoring scenes; ranking may run on many threads at once.
+    //
+    // Memory: a template costs its image and features for as long as it is in the
+    // library; the image alone is 4.4 MB for the bundled 992x1470 template. Its SSIM
+    // reference, up to SsimOptions::max_cached_bytes (about 35 MB for the bundled
+    // template at ssim_scale 1.0), is only kept for the ssim_cache_size most recently
+    // scored templates.
+    class TemplateLibrary {
+        public:
+            static const size_t kDefaultSsimCacheSize = 2;
+
+            explicit TemplateLibrary(size_t ssim_cache_size = kDefaultSsimCacheSize);
+            TemplateLibrary(const TemplateLibrary &) = delete;
+            TemplateLibrary &operator=(const TemplateLibrary &) = delete;
+
+            // The pack is matched as is, so it should support the finder configuration. Its
+            // SSIM engines move to the library's cache.
+            bool Add(const std::string &name, std::shared_ptr<const TemplatePack> pack);
+
+            // Analyze a template image, or memory map a template_pack_tool pack
+            bool AddImage(const std::string &name, const std::string &image_file, const FinderConfig &config);
+            bool AddPack(const std::string &name, const std::string &pack_file);
+
+            size_t size() const { return entries_.size(); }
+            const std::string &name(int index) const { return entries_[index].name; }
+            std::shared_ptr<const TemplatePack> pack(int index) const { return entries_[index].pack; }
+
+            // Templates most like the scene, best first, at most max_results of them
+            std::vector<TemplateCandidate> Rank(const cv::Mat &scene, int max_results = 1) const;
+
+            // Index of the best template for the scene; -1 when the library is empty or
+            // the scene cannot be decoded
+            int Retrieve(const ImageSource &scene) const;
+
+        private:
+            struct Entry
+            {
+                std::string name;
+                std::shared_ptr<const TemplatePack> pack;
+            };
+            struct Index;
+
+            // Vocabulary and template histograms, built on first use after an Add
+            std::shared_ptr<const Index> GetIndex() const;
+
+            std::vector<Entry> entries_;
+            std::shared_ptr<SsimEngineCache> ssim_cache_;
+
+            mutable std::mutex index_mutex_;
+            mutable std::shared_ptr<const Index> index_;
+    };
+
+} // TactNib
+
+#endif //SYSTEM_API_TEMPLATE_LIBRARY_H
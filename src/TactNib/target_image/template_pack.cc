@@ -0,0 +1,468 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: template_pack.cc
+ * Purpose:	  Pre-analyzed paper target template. The pack holds the template
+ *            pixels, keypoints, descriptors, color statistics and corner geometry
+ *            so a scene only pays for scene-side work. Packs are built once with
+ *            the template_pack_tool and memory mapped at startup.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "template_pack.h"
+
+namespace TactNib {
+
+    namespace {
+        // File layout (native byte order, every section starts on a kAlignment boundary):
+        //   PackHeader | image pixels (rows x cols x 3, BGR) | PackedKeyPoint[] | descriptors |
+        //   ROI mask (rows x cols, CV_8U, only when has_roi_mask)
+        const char kMagic[8] = {'T', 'N', 'T', 'P', 'A', 'C', 'K', '\0'};
+        const uint64_t kAlignment = 64;
+
+        struct PackHeader
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t header_size;
+            int32_t detector_type;
+            int32_t extract_type;
+            int32_t image_rows, image_cols, image_type;
+            int32_t descriptor_rows, descriptor_cols, descriptor_type;
+            uint32_t keypoint_count;
+            uint32_t has_roi_mask;
+            uint64_t image_offset, keypoint_offset, descriptor_offset, roi_mask_offset, file_size;
+            double stat_mean[3];        // HSV statistics; only saturation, index 1, is used
+            double stat_stddev[3];
+            float corners[8];
+        };
+
+        struct PackedKeyPoint
+        {
+            float x, y, size, angle, response;
+            int32_t octave, class_id;
+        };
+
+        uint64_t AlignUp(uint64_t offset)
+        {
+            return (offset + kAlignment - 1) / kAlignment * kAlignment;
+        }
+
+        void WritePadding(std::ofstream &out, uint64_t target_offset)
+        {
+            static const char zeros[kAlignment] = {};
+            uint64_t position = static_cast<uint64_t>(out.tellp());
+            out.write(zeros, static_cast<std::streamsize>(target_offset - position));
+        }
+
+        // A section of bytes at offset lies inside the file and starts aligned; written
+        // so that large values from a damaged header cannot wrap around
+        bool SectionFits(uint64_t offset, uint64_t bytes, uint64_t file_size)
+        {
+            return offset % kAlignment == 0 && offset <= file_size && bytes <= file_size - offset;
+        }
+
+        //================================================
+        // Function: ValidHeader
+        //  Note: Everything Load builds a Mat or a keypoint from, checked before it does
+        //================================================
+        bool ValidHeader(const PackHeader &header, uint64_t file_size)
+        {
+            if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+                header.version != TemplatePack::kVersion || header.header_size != sizeof(PackHeader) ||
+                header.file_size != file_size) {
+                return false;
+            }
+
+            // Enums as written by Save, see finder_config.h
+            if (header.detector_type < static_cast<int32_t>(FeatureDetectorType::Detect_FAST) ||
+                header.detector_type > static_cast<int32_t>(FeatureDetectorType::Detect_ORB) ||
+                header.extract_type < static_cast<int32_t>(FeatureExtractType::Extract_FAST) ||
+                header.extract_type > static_cast<int32_t>(FeatureExtractType::Extract_ORB)) {
+                return false;
+            }
+
+            if (header.image_type != CV_8UC3 || header.image_rows <= 0 || header.image_cols <= 0) {
+                return false;
+            }
+
+            // SIFT descriptors are float, binary ones bytes; one row per keypoint, since
+            // matches index the keypoints by descriptor row
+            if (header.descriptor_type != CV_32FC1 && header.descriptor_type != CV_8UC1) {
+                return false;
+            }
+            if (header.descriptor_rows < 0 || header.descriptor_cols < 0 ||
+                (header.descriptor_rows > 0 && header.descriptor_cols == 0) ||
+                header.keypoint_count != static_cast<uint32_t>(header.descriptor_rows)) {
+                return false;
+            }
+
+            uint64_t image_bytes = static_cast<uint64_t>(header.image_rows) * static_cast<uint64_t>(header.image_cols) * 3;
+            uint64_t keypoint_bytes = static_cast<uint64_t>(header.keypoint_count) * sizeof(PackedKeyPoint);
+            uint64_t descriptor_bytes = static_cast<uint64_t>(header.descriptor_rows) *
+                                        static_cast<uint64_t>(header.descriptor_cols) * CV_ELEM_SIZE(header.descriptor_type);
+            uint64_t roi_mask_bytes = static_cast<uint64_t>(header.image_rows) * static_cast<uint64_t>(header.image_cols);
+            return SectionFits(header.image_offset, image_bytes, file_size) &&
+                   SectionFits(header.keypoint_offset, keypoint_bytes, file_size) &&
+                   SectionFits(header.descriptor_offset, descriptor_bytes, file_size) &&
+                   (!header.has_roi_mask || SectionFits(header.roi_mask_offset, roi_mask_bytes, file_size));
+        }
+
+        void SetCorners(std::vector<cv::Point2f> &corners, int cols, int rows)
+        {
+            corners.resize(4);
+            corners[0] = cv::Point2f(0, 0);
+            corners[1] = cv::Point2f((float) cols, 0);
+            corners[2] = cv::Point2f((float) cols, (float) rows);
+            corners[3] = cv::Point2f(0, (float) rows);
+        }
+    }
+
+    //================================================
+    // Default constructor
+    //================================================
+    TemplatePack::TemplatePack()
+    {
+        detector_type_ = FeatureDetectorType::Detect_SIFT;
+        extract_type_ = FeatureExtractType::Extract_SIFT;
+        mapping_ = nullptr;
+        mapping_size_ = 0;
+        parent_ = nullptr;
+        rootsift_built_ = false;
+    }
+
+    //================================================
+    // Destructor
+    //================================================
+    TemplatePack::~TemplatePack()
+    {
+        // Release the Mat headers before the memory they point to goes away
+        image_.release();
+        descriptors_.release();
+        roi_mask_.release();
+        if (mapping_ != nullptr) {
+            munmap(mapping_, mapping_size_);
+        }
+    }
+
+    //================================================
+    // Member Function: Create
+    //================================================
+    std::shared_ptr<TemplatePack> TemplatePack::Create(const std::string &image_file,
+                                                       FeatureDetectorType detector_type,
+                                                       FeatureExtractType extract_type,
+                                                       int max_features,
+                                                       const cv::Mat &roi_mask)
+    {
+        Mat image = imread(image_file, IMREAD_COLOR);
+        if (image.empty()) {
+            std::cout << "TemplatePack: unable to read template image " << image_file << std::endl;
+            return nullptr;
+        }
+
+        return Create(image, detector_type, extract_type, max_features, roi_mask);
+    }
+
+    //================================================
+    // Member Function: Create
+    //================================================
+    std::shared_ptr<TemplatePack> TemplatePack::Create(const cv::Mat &image,
+                                                       FeatureDetectorType detector_type,
+                                                       FeatureExtractType extract_type,
+                                                       int max_features,
+                                                       const cv::Mat &roi_mask)
+    {
+        if (image.empty() || image.type() != CV_8UC3) {
+            std::cout << "TemplatePack: template image must be a BGR image" << std::endl;
+            return nullptr;
+        }
+
+        std::shared_ptr<TemplatePack> pack(new TemplatePack());
+        pack->detector_type_ = detector_type;
+        pack->extract_type_ = extract_type;
+        pack->image_ = image;
+        if (!roi_mask.empty()) {
+            if (roi_mask.size() != image.size() || roi_mask.type() != CV_8U) {
+                std::cout << "TemplatePack: ROI mask must be a CV_8U image of the template size" << std::endl;
+                return nullptr;
+            }
+            pack->roi_mask_ = roi_mask;
+        }
+
+        // Template side of Step 1 and Step 2 of the OpenCV finder
+        Ptr<Feature2D> detector = OpencvAlgo::CreateFeatureDetector(detector_type, max_features);
+        detector->detect(image, pack->keypoints_, pack->roi_mask_);
+        Ptr<Feature2D> extractor = OpencvAlgo::CreateFeatureExtractor(extract_type, max_features);
+        extractor->compute(image, pack->keypoints_, pack->descriptors_);
+
+        // Color statistics used to adjust the brightness of each scene
+        pack->color_transfer_.SetReference(image);
+
+        SetCorners(pack->corners_, image.cols, image.rows);
+        return pack;
+    }
+
+    //================================================
+    // Member Function: Load
+    //================================================
+    std::shared_ptr<TemplatePack> TemplatePack::Load(const std::string &pack_file)
+    {
+        int fd = open(pack_file.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cout << "TemplatePack: unable to open " << pack_file << std::endl;
+            return nullptr;
+        }
+
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0 || static_cast<uint64_t>(file_stat.st_size) < sizeof(PackHeader)) {
+            std::cout << "TemplatePack: " << pack_file << " is too small to be a template pack" << std::endl;
+            close(fd);
+            return nullptr;
+        }
+
+        // Private, copy-on-write mapping: pages are only read from disk when touched
+        // and an accidental write to a Mat can never modify the pack file.
+        size_t mapping_size = static_cast<size_t>(file_stat.st_size);
+        void *mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            std::cout << "TemplatePack: unable to map " << pack_file << std::endl;
+            return nullptr;
+        }
+
+        std::shared_ptr<TemplatePack> pack(new TemplatePack());
+        pack->mapping_ = mapping;
+        pack->mapping_size_ = mapping_size;
+
+        auto *base = static_cast<uchar *>(mapping);
+        PackHeader header;
+        std::memcpy(&header, base, sizeof(header));
+
+        if (!ValidHeader(header, mapping_size)) {
+            std::cout << "TemplatePack: " << pack_file << " is not a version " << kVersion
+                      << " template pack" << std::endl;
+            return nullptr;
+        }
+
+        pack->detector_type_ = static_cast<FeatureDetectorType>(header.detector_type);
+        pack->extract_type_ = static_cast<FeatureExtractType>(header.extract_type);
+
+        // Pixels and descriptors are used in place
+        pack->image_ = Mat(header.image_rows, header.image_cols, CV_8UC3, base + header.image_offset);
+        if (header.descriptor_rows > 0) {
+            pack->descriptors_ = Mat(header.descriptor_rows, header.descriptor_cols, header.descriptor_type,
+                                     base + header.descriptor_offset);
+        }
+        if (header.has_roi_mask) {
+            pack->roi_mask_ = Mat(header.image_rows, header.image_cols, CV_8U, base + header.roi_mask_offset);
+        }
+
+        // Keypoints are small, expand them into the form OpenCV expects
+        pack->keypoints_.resize(header.keypoint_count);
+        const auto *packed = reinterpret_cast<const PackedKeyPoint *>(base + header.keypoint_offset);
+        for (uint32_t i = 0; i < header.keypoint_count; i++) {
+            pack->keypoints_[i] = KeyPoint(packed[i].x, packed[i].y, packed[i].size, packed[i].angle,
+                                           packed[i].response, packed[i].octave, packed[i].class_id);
+        }
+
+        ColorStat stat;
+        stat.mean = header.stat_mean[1];
+        stat.stddev = header.stat_stddev[1];
+        pack->color_transfer_.SetReference(stat);
+
+        pack->corners_.resize(4);
+        for (int i = 0; i < 4; i++) {
+            pack->corners_[i] = Point2f(header.corners[2 * i], header.corners[2 * i + 1]);
+        }
+
+        return pack;
+    }
+
+    //================================================
+    // Member Function: Save
+    //================================================
+    bool TemplatePack::Save(const std::string &pack_file) const
+    {
+        Mat image = image_.isContinuous() ? image_ : image_.clone();
+        Mat descriptors = descriptors_.isContinuous() ? descriptors_ : descriptors_.clone();
+        Mat roi_mask = roi_mask_.isContinuous() ? roi_mask_ : roi_mask_.clone();
+
+        PackHeader header = {};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.header_size = sizeof(PackHeader);
+        header.detector_type = static_cast<int32_t>(detector_type_);
+        header.extract_type = static_cast<int32_t>(extract_type_);
+        header.image_rows = image.rows;
+        header.image_cols = image.cols;
+        header.image_type = image.type();
+        header.descriptor_rows = descriptors.rows;
+        header.descriptor_cols = descriptors.cols;
+        header.descriptor_type = descriptors.empty() ? CV_32F : descriptors.type();
+        header.keypoint_count = static_cast<uint32_t>(keypoints_.size());
+        header.has_roi_mask = roi_mask.empty() ? 0 : 1;
+
+        uint64_t image_bytes = image.total() * image.elemSize();
+        uint64_t keypoint_bytes = keypoints_.size() * sizeof(PackedKeyPoint);
+        uint64_t descriptor_bytes = descriptors.total() * descriptors.elemSize();
+        uint64_t roi_mask_bytes = roi_mask.total();
+        header.image_offset = AlignUp(sizeof(PackHeader));
+        header.keypoint_offset = AlignUp(header.image_offset + image_bytes);
+        header.descriptor_offset = AlignUp(header.keypoint_offset + keypoint_bytes);
+        header.roi_mask_offset = AlignUp(header.descriptor_offset + descriptor_bytes);
+        header.file_size = header.has_roi_mask ? header.roi_mask_offset + roi_mask_bytes
+                                               : header.descriptor_offset + descriptor_bytes;
+
+        header.stat_mean[1] = color_transfer_.reference().mean;
+        header.stat_stddev[1] = color_transfer_.reference().stddev;
+        for (int i = 0; i < 4 && i < (int) corners_.size(); i++) {
+            header.corners[2 * i] = corners_[i].x;
+            header.corners[2 * i + 1] = corners_[i].y;
+        }
+
+        std::vector<PackedKeyPoint> packed(keypoints_.size());
+        for (size_t i = 0; i < keypoints_.size(); i++) {
+            const KeyPoint &kp = keypoints_[i];
+            packed[i] = {kp.pt.x, kp.pt.y, kp.size, kp.angle, kp.response, kp.octave, kp.class_id};
+        }
+
+        std::ofstream out(pack_file, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cout << "TemplatePack: unable to create " << pack_file << std::endl;
+            return false;
+        }
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        WritePadding(out, header.image_offset);
+        out.write(reinterpret_cast<const char *>(image.data), static_cast<std::streamsize>(image_bytes));
+        WritePadding(out, header.keypoint_offset);
+        out.write(reinterpret_cast<const char *>(packed.data()), static_cast<std::streamsize>(keypoint_bytes));
+        WritePadding(out, header.descriptor_offset);
+        out.write(reinterpret_cast<const char *>(descriptors.data), static_cast<std::streamsize>(descriptor_bytes));
+        if (header.has_roi_mask) {
+            WritePadding(out, header.roi_mask_offset);
+            out.write(reinterpret_cast<const char *>(roi_mask.data), static_cast<std::streamsize>(roi_mask_bytes));
+        }
+
+        if (!out) {
+            std::cout << "TemplatePack: failed writing " << pack_file << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    //================================================
+    // Member Function: GetSsimEngine
+    //================================================
+    std::shared_ptr<const SsimEngine> TemplatePack::GetSsimEngine(const SsimOptions &options) const
+    {
+        // A variant's image is its parent's, so is the reference
+        if (parent_ != nullptr) {
+            return parent_->GetSsimEngine(options);
+        }
+
+        std::unique_lock<std::mutex> lock(ssim_mutex_);
+        if (ssim_cache_ != nullptr) {
+            std::shared_ptr<SsimEngineCache> cache = ssim_cache_;
+            lock.unlock();
+            return cache->Get(this, image_, options);
+        }
+        for (const std::shared_ptr<const SsimEngine> &engine : ssim_engines_) {
+            if (engine->options() == options) {
+                return engine;
+            }
+        }
+
+        auto engine = std::make_shared<SsimEngine>(options);
+        engine->SetReference(image_);
+        ssim_engines_.push_back(engine);
+        return engine;
+    }
+
+    //================================================
+    // Member Function: GetRootSiftIndex
+    //  Note: Built once, like the FLANN index over the template; a failed build is
+    //        not retried
+    //================================================
+    std::shared_ptr<const RootSiftIndex> TemplatePack::GetRootSiftIndex() const
+    {
+        std::lock_guard<std::mutex> lock(rootsift_mutex_);
+        if (!rootsift_built_) {
+            rootsift_built_ = true;
+            if (extract_type_ == FeatureExtractType::Extract_SIFT) {
+                rootsift_index_ = RootSiftMatcher::BuildIndex(descriptors_);
+            } else {
+                std::cout << "TemplatePack: RootSIFT needs SIFT descriptors, not " << ToString(extract_type_) << std::endl;
+            }
+        }
+        return rootsift_index_;
+    }
+
+    //================================================
+    // Member Function: SetSsimCache
+    //================================================
+    void TemplatePack::SetSsimCache(std::shared_ptr<SsimEngineCache> cache) const
+    {
+        std::lock_guard<std::mutex> lock(ssim_mutex_);
+        ssim_cache_ = cache;
+        ssim_engines_.clear();
+    }
+
+    //================================================
+    // Member Function: color_transfer
+    //================================================
+    const ColorTransfer &TemplatePack::color_transfer() const
+    {
+        return parent_ != nullptr ? parent_->color_transfer() : color_transfer_;
+    }
+
+    //================================================
+    // Member Function: GetVariant
+    //  Note: A variant of a loaded pack shares the mapped image, so the pointer handed
+    //        out keeps this pack alive
+    //================================================
+    std::shared_ptr<const TemplatePack> TemplatePack::GetVariant(FeatureDetectorType detector_type,
+                                                                 FeatureExtractType extract_type,
+                                                                 int max_features) const
+    {
+        if (Supports(detector_type, extract_type)) {
+            return shared_from_this();
+        }
+
+        // Held while analyzing, so concurrent callers wait for one analysis
+        std::lock_guard<std::mutex> lock(variant_mutex_);
+        for (const Variant &variant : variants_) {
+            if (variant.detector_type == detector_type && variant.extract_type == extract_type &&
+                variant.max_features == max_features) {
+                return std::shared_ptr<const TemplatePack>(shared_from_this(), variant.pack.get());
+            }
+        }
+
+        std::shared_ptr<TemplatePack> pack = Create(image_, detector_type, extract_type, max_features, roi_mask_);
+        if (pack == nullptr) {
+            return nullptr;
+        }
+        pack->parent_ = this;
+        variants_.push_back({detector_type, extract_type, max_features, pack});
+        return std::shared_ptr<const TemplatePack>(shared_from_this(), pack.get());
+    }
+
+    //================================================
+    // Member Function: Supports
+    //================================================
+    bool TemplatePack::Supports(FeatureDetectorType detector_type, FeatureExtractType extract_type) const
+    {
+        return detector_type == detector_type_ && extract_type == extract_type_;
+    }
+
+} // TactNib
@@ -0,0 +1,134 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: template_pack.h
+ * Purpose:	  Pre-analyzed paper target template. The pack holds the template
+ *            pixels, keypoints, descriptors, color statistics and corner geometry
+ *            so a scene only pays for scene-side work. Packs are built once with
+ *            the template_pack_tool and memory mapped at startup.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_TEMPLATE_PACK_H
+#define SYSTEM_API_TEMPLATE_PACK_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "color_transfer.h"
+#include "finder_config.h"
+#include "opencv_algo.h"
+#include "root_sift_matcher.h"
+#include "ssim_engine.h"
+
+namespace TactNib {
+
+    class TemplatePack : public std::enable_shared_from_this<TemplatePack> {
+        public:
+            // On-disk format version, bump when the layout in template_pack.cc changes
+            static constexpr uint32_t kVersion = 2;
+
+            ~TemplatePack();
+            TemplatePack(const TemplatePack &) = delete;
+            TemplatePack &operator=(const TemplatePack &) = delete;
+
+            // Analyze a template image in memory. max_features is the ORB keypoint budget;
+            // a saved pack keeps the budget it was built with. A non-zero roi_mask pixel
+            // (CV_8U, template size) marks where template keypoints are detected; the mask
+            // is stored with the pack and projected into scenes, see OpencvAlgo::CreateMarkerMask.
+            static std::shared_ptr<TemplatePack> Create(const std::string &image_file,
+                                                        FeatureDetectorType detector_type,
+                                                        FeatureExtractType extract_type,
+                                                        int max_features = 500,
+                                                        const cv::Mat &roi_mask = cv::Mat());
+            static std::shared_ptr<TemplatePack> Create(const cv::Mat &image,
+                                                        FeatureDetectorType detector_type,
+                                                        FeatureExtractType extract_type,
+                                                        int max_features = 500,
+                                                        const cv::Mat &roi_mask = cv::Mat());
+
+            // Memory map a pack written by Save(); returns nullptr if the file is missing or invalid
+            static std::shared_ptr<TemplatePack> Load(const std::string &pack_file);
+
+            bool Save(const std::string &pack_file) const;
+
+            // True when the keypoints/descriptors were produced by the given algorithms
+            bool Supports(FeatureDetectorType detector_type, FeatureExtractType extract_type) const;
+
+            const cv::Mat &image() const { return image_; }
+            const std::vector<cv::KeyPoint> &keypoints() const { return keypoints_; }
+            const cv::Mat &descriptors() const { return descriptors_; }
+            const cv::Mat &roi_mask() const { return roi_mask_; }   // empty: whole template
+            const ColorTransfer &color_transfer() const;
+            const std::vector<cv::Point2f> &corners() const { return corners_; }
+            FeatureDetectorType detector_type() const { return detector_type_; }
+            FeatureExtractType extract_type() const { return extract_type_; }
+
+            // SSIM scorer with the template side cached, built on first use per option set.
+            // A variant hands out the engine of the pack it was made from.
+            std::shared_ptr<const SsimEngine> GetSsimEngine(const SsimOptions &options) const;
+
+            // Quantized descriptors and coarse index for RootSiftMatcher, built on first
+            // use. nullptr unless the pack holds SIFT descriptors.
+            std::shared_ptr<const RootSiftIndex> GetRootSiftIndex() const;
+
+            // Keep SSIM engines in a cache shared with other packs instead of in this pack,
+            // see TemplateLibrary. Set before the pack is scored.
+            void SetSsimCache(std::shared_ptr<SsimEngineCache> cache) const;
+
+            // This template analyzed with other algorithms, in the same ROI. Built on first
+            // use per algorithm set and owned by this pack; the pack itself when it already
+            // supports them. Returns nullptr when the analysis fails.
+            std::shared_ptr<const TemplatePack> GetVariant(FeatureDetectorType detector_type,
+                                                           FeatureExtractType extract_type,
+                                                           int max_features) const;
+
+        private:
+            TemplatePack();
+
+            FeatureDetectorType detector_type_;
+            FeatureExtractType extract_type_;
+
+            // For a loaded pack, image_, descriptors_ and roi_mask_ point into the mapping
+            cv::Mat image_;
+            std::vector<cv::KeyPoint> keypoints_;
+            cv::Mat descriptors_;
+            cv::Mat roi_mask_;
+            ColorTransfer color_transfer_;
+            std::vector<cv::Point2f> corners_;
+
+            void *mapping_;
+            size_t mapping_size_;
+
+            // Set for a variant: the pack that owns it and has the same image
+            const TemplatePack *parent_;
+
+            mutable std::mutex rootsift_mutex_;
+            mutable bool rootsift_built_;
+            mutable std::shared_ptr<const RootSiftIndex> rootsift_index_;
+
+            mutable std::mutex ssim_mutex_;
+            mutable std::vector<std::shared_ptr<const SsimEngine>> ssim_engines_;
+            mutable std::shared_ptr<SsimEngineCache> ssim_cache_;
+
+            struct Variant
+            {
+                FeatureDetectorType detector_type;
+                FeatureExtractType extract_type;
+                int max_features;
+                std::shared_ptr<const TemplatePack> pack;
+            };
+            mutable std::mutex variant_mutex_;
+            mutable std::vector<Variant> variants_;
+    };
+
+} // TactNib
+
+#endif //SYSTEM_API_TEMPLATE_PACK_H
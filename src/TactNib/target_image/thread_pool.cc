@@ -0,0 +1,72 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: thread_pool.cc
+ * Purpose:	  Fixed size pool of worker threads. Tasks are run in submission
+ *            order and their results are returned through std::future.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <algorithm>
+
+#include "thread_pool.h"
+
+namespace TactNib {
+
+    //================================================
+    // Default constructor
+    //================================================
+    ThreadPool::ThreadPool(unsigned int num_threads)
+    {
+        stopping_ = false;
+
+        if (num_threads == 0) {
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        for (unsigned int i = 0; i < num_threads; i++) {
+            workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+        }
+    }
+
+    //================================================
+    // Destructor
+    //  Note: Queued tasks are finished before the workers exit
+    //================================================
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        condition_.notify_all();
+
+        for (std::thread &worker : workers_) {
+            worker.join();
+        }
+    }
+
+    //================================================
+    // Member Function: WorkerLoop
+    //================================================
+    void ThreadPool::WorkerLoop()
+    {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                condition_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+                if (tasks_.empty()) {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop();
+            }
+            task();
+        }
+    }
+
+} // TactNib
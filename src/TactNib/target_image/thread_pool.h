@@ -0,0 +1,64 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: thread_pool.h
+ * Purpose:	  Fixed size pool of worker threads. Tasks are run in submission
+ *            order and their results are returned through std::future.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_THREAD_POOL_H
+#define SYSTEM_API_THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace TactNib {
+
+    class ThreadPool {
+        public:
+            // Zero threads uses one thread per hardware core
+            explicit ThreadPool(unsigned int num_threads = 0);
+            ~ThreadPool();
+            ThreadPool(const ThreadPool &) = delete;
+            ThreadPool &operator=(const ThreadPool &) = delete;
+
+            // Queue a task; exceptions thrown by the task are rethrown by future::get()
+            template<typename Task>
+            auto Submit(Task task) -> std::future<decltype(task())>
+            {
+                using Result = decltype(task());
+                auto packaged = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+                std::future<Result> result = packaged->get_future();
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    tasks_.emplace([packaged]() { (*packaged)(); });
+                }
+                condition_.notify_one();
+                return result;
+            }
+
+            unsigned int size() const { return static_cast<unsigned int>(workers_.size()); }
+
+        private:
+            void WorkerLoop();
+
+            std::vector<std::thread> workers_;
+            std::queue<std::function<void()>> tasks_;
+            std::mutex mutex_;
+            std::condition_variable condition_;
+            bool stopping_;
+    };
+
+} // TactNib
+
+#endif //SYSTEM_API_THREAD_POOL_H
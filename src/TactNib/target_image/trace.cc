@@ -0,0 +1,330 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: trace.cc
+ * Purpose:	  Scoped, per-stage tracing of the target finder. Spans are timed
+ *            with the monotonic steady clock, appended to a per-thread buffer
+ *            without locking, and exported as Chrome trace JSON (chrome://tracing,
+ *            ui.perfetto.dev) or summarized as p50/p95/p99 latency per stage.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+#include "trace.h"
+
+namespace TactNib {
+
+    // Events are appended to fixed size chunks. Only the owning thread writes a chunk;
+    // it publishes each event by a release store of count, so readers of the chunk
+    // events never wait for it.
+    struct Tracer::Chunk
+    {
+        static const size_t kCapacity = 4096;
+
+        TraceEvent events[kCapacity];
+        std::atomic<size_t> count{0};
+        Chunk *next = nullptr;
+    };
+
+    // The chunk list is changed under buffers_mutex_ only: by the owner when its tail
+    // chunk is full, and by Clear()
+    struct Tracer::ThreadBuffer
+    {
+        explicit ThreadBuffer(uint32_t id) : thread_id(id), head(new Chunk()), tail(head) {}
+        ~ThreadBuffer()
+        {
+            Chunk *chunk = head;
+            while (chunk != nullptr) {
+                Chunk *next = chunk->next;
+                delete chunk;
+                chunk = next;
+            }
+        }
+
+        const uint32_t thread_id;
+        Chunk *head;
+        Chunk *tail;            // written to by the owner thread only
+        size_t chunks = 1;
+        bool retired = false;   // the owner thread has exited
+    };
+
+    // Retires the thread's buffer when the thread exits; the events stay readable
+    struct Tracer::ThreadOwner
+    {
+        ThreadBuffer *buffer = nullptr;
+        ~ThreadOwner()
+        {
+            if (buffer != nullptr) {
+                Tracer::Instance().RetireThread(buffer);
+            }
+        }
+    };
+
+    namespace {
+        double Percentile(const std::vector<uint64_t> &sorted_ns, double fraction)
+        {
+            size_t rank = static_cast<size_t>(std::ceil(fraction * sorted_ns.size()));
+            size_t index = rank > 0 ? rank - 1 : 0;
+            return sorted_ns[std::min(index, sorted_ns.size() - 1)] / 1.0e6;
+        }
+    }
+
+    //================================================
+    // Member Function: Instance
+    //================================================
+    Tracer &Tracer::Instance()
+    {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    //================================================
+    // Default constructor
+    //================================================
+    Tracer::Tracer()
+    {
+        enabled_ = false;
+        clear_ns_ = 0;
+        epoch_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    Tracer::~Tracer() = default;
+
+    //================================================
+    // Member Function: Now
+    //================================================
+    uint64_t Tracer::Now() const
+    {
+        int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        return static_cast<uint64_t>(now_ns - epoch_ns_);
+    }
+
+    //================================================
+    // Member Function: RegisterThread
+    //================================================
+    Tracer::ThreadBuffer *Tracer::RegisterThread()
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex_);
+        buffers_.push_back(std::make_unique<ThreadBuffer>(++last_thread_id_));
+        return buffers_.back().get();
+    }
+
+    //================================================
+    // Member Function: RetireThread
+    //  Note: Keeps the buffers of the last kMaxRetiredThreads exited threads, so pools
+    //        that come and go do not add up
+    //================================================
+    void Tracer::RetireThread(ThreadBuffer *buffer)
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex_);
+        buffer->retired = true;
+
+        size_t retired = std::count_if(buffers_.begin(), buffers_.end(), [](const auto &b) { return b->retired; });
+        if (retired > kMaxRetiredThreads) {
+            auto oldest = std::find_if(buffers_.begin(), buffers_.end(), [](const auto &b) { return b->retired; });
+            buffers_.erase(oldest);
+        }
+    }
+
+    //================================================
+    // Member Function: NextChunk
+    //  Note: The owner's only lock, once per Chunk::kCapacity events. Past
+    //        kMaxChunksPerThread the oldest chunk is reused, so a thread keeps its
+    //        most recent events only.
+    //================================================
+    Tracer::Chunk *Tracer::NextChunk(ThreadBuffer &buffer)
+    {
+        std::lock_guard<std::mutex> lock(buffers_mutex_);
+        Chunk *next;
+        if (buffer.chunks < kMaxChunksPerThread) {
+            next = new Chunk();
+            buffer.chunks++;
+        } else {
+            next = buffer.head;
+            buffer.head = next->next;
+            next->next = nullptr;
+            next->count.store(0, std::memory_order_relaxed);
+        }
+        buffer.tail->next = next;
+        buffer.tail = next;
+        return next;
+    }
+
+    //================================================
+    // Member Function: Record
+    //================================================
+    void Tracer::Record(const char *name, uint64_t start_ns, uint64_t end_ns)
+    {
+        // Buffers are owned by the tracer so events outlive the threads that made them
+        static thread_local ThreadOwner owner;
+        if (owner.buffer == nullptr) {
+            owner.buffer = RegisterThread();
+        }
+        ThreadBuffer *buffer = owner.buffer;
+
+        Chunk *chunk = buffer->tail;
+        size_t count = chunk->count.load(std::memory_order_relaxed);
+        if (count == Chunk::kCapacity) {
+            chunk = NextChunk(*buffer);
+            count = 0;
+        }
+        chunk->events[count] = TraceEvent{name, start_ns, end_ns - start_ns, buffer->thread_id};
+        chunk->count.store(count + 1, std::memory_order_release);
+    }
+
+    //================================================
+    // Member Function: Events
+    //================================================
+    std::vector<TraceEvent> Tracer::Events() const
+    {
+        uint64_t clear_ns = clear_ns_.load(std::memory_order_relaxed);
+        std::vector<TraceEvent> events;
+
+        std::lock_guard<std::mutex> lock(buffers_mutex_);
+        for (const auto &buffer : buffers_) {
+            for (const Chunk *chunk = buffer->head; chunk != nullptr; chunk = chunk->next) {
+                size_t count = chunk->count.load(std::memory_order_acquire);
+                for (size_t i = 0; i < count; i++) {
+                    if (chunk->events[i].start_ns >= clear_ns) {
+                        events.push_back(chunk->events[i]);
+                    }
+                }
+            }
+        }
+        std::sort(events.begin(), events.end(), [](const TraceEvent &a, const TraceEvent &b) {
+            return a.start_ns < b.start_ns;
+        });
+        return events;
+    }
+
+    //================================================
+    // Member Function: Clear
+    //  Note: Frees the buffers of exited threads and every chunk but the one each
+    //        live thread is writing to; events left in those are hidden by time
+    //================================================
+    void Tracer::Clear()
+    {
+        clear_ns_.store(Now(), std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(buffers_mutex_);
+        buffers_.erase(std::remove_if(buffers_.begin(), buffers_.end(), [](const auto &b) { return b->retired; }),
+                       buffers_.end());
+        for (const auto &buffer : buffers_) {
+            while (buffer->head != buffer->tail) {
+                Chunk *next = buffer->head->next;
+                delete buffer->head;
+                buffer->head = next;
+                buffer->chunks--;
+            }
+        }
+    }
+
+    //================================================
+    // Member Function: WriteChromeTrace
+    //  Note: Complete ("X") events in microseconds, one track per thread
+    //================================================
+    bool Tracer::WriteChromeTrace(const std::string &trace_file) const
+    {
+        std::ofstream out(trace_file);
+        if (!out) {
+            std::cout << "Tracer: unable to open " << trace_file << std::endl;
+            return false;
+        }
+
+        out << std::fixed << std::setprecision(3);
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        for (const TraceEvent &event : Events()) {
+            out << (first ? "\n" : ",\n");
+            out << "{\"name\":\"" << event.name << "\",\"cat\":\"finder\",\"ph\":\"X\",\"pid\":1"
+                << ",\"tid\":" << event.thread_id
+                << ",\"ts\":" << event.start_ns / 1000.0
+                << ",\"dur\":" << event.duration_ns / 1000.0 << "}";
+            first = false;
+        }
+        out << "\n]}\n";
+        return static_cast<bool>(out);
+    }
+
+    //================================================
+    // Member Function: Summary
+    //================================================
+    std::vector<StageLatency> Tracer::Summary() const
+    {
+        std::map<std::string, std::vector<uint64_t>> durations;
+        for (const TraceEvent &event : Events()) {
+            durations[event.name].push_back(event.duration_ns);
+        }
+
+        std::vector<StageLatency> summary;
+        for (auto &entry : durations) {
+            std::vector<uint64_t> &sorted_ns = entry.second;
+            std::sort(sorted_ns.begin(), sorted_ns.end());
+
+            StageLatency stage;
+            stage.name = entry.first;
+            stage.count = sorted_ns.size();
+            stage.p50_ms = Percentile(sorted_ns, 0.50);
+            stage.p95_ms = Percentile(sorted_ns, 0.95);
+            stage.p99_ms = Percentile(sorted_ns, 0.99);
+            stage.max_ms = sorted_ns.back() / 1.0e6;
+            summary.push_back(stage);
+        }
+        return summary;
+    }
+
+    //================================================
+    // Member Function: PrintSummary
+    //================================================
+    void Tracer::PrintSummary(std::ostream &out) const
+    {
+        out << std::left << std::setw(16) << "stage" << std::right
+            << std::setw(8) << "count" << std::setw(12) << "p50 ms" << std::setw(12) << "p95 ms"
+            << std::setw(12) << "p99 ms" << std::setw(12) << "max ms" << std::endl;
+        out << std::fixed << std::setprecision(3);
+        for (const StageLatency &stage : Summary()) {
+            out << std::left << std::setw(16) << stage.name << std::right
+                << std::setw(8) << stage.count << std::setw(12) << stage.p50_ms << std::setw(12) << stage.p95_ms
+                << std::setw(12) << stage.p99_ms << std::setw(12) << stage.max_ms << std::endl;
+        }
+        out << std::defaultfloat;
+    }
+
+    //================================================
+    // Default constructor
+    //================================================
+    TraceScope::TraceScope(const char *name)
+    {
+        name_ = name;
+        start_ns_ = Tracer::Instance().Now();
+        end_ns_ = 0;
+    }
+
+    //================================================
+    // Member Function: End
+    //================================================
+    double TraceScope::End()
+    {
+        Tracer &tracer = Tracer::Instance();
+        if (end_ns_ == 0) {
+            end_ns_ = tracer.Now();
+            if (tracer.enabled()) {
+                tracer.Record(name_, start_ns_, end_ns_);
+            }
+        }
+        return (end_ns_ - start_ns_) / 1.0e9;
+    }
+
+} // TactNib
@@ -0,0 +1,114 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: trace.h
+ * Purpose:	  Scoped, per-stage tracing of the target finder. Spans are timed
+ *            with the monotonic steady clock, appended to a per-thread buffer
+ *            without locking, and exported as Chrome trace JSON (chrome://tracing,
+ *            ui.perfetto.dev) or summarized as p50/p95/p99 latency per stage.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#ifndef SYSTEM_API_TRACE_H
+#define SYSTEM_API_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace TactNib {
+
+    struct TraceEvent
+    {
+        const char *name;       // string literal, only the pointer is stored
+        uint64_t start_ns;      // since the tracer was created
+        uint64_t duration_ns;
+        uint32_t thread_id;
+    };
+
+    struct StageLatency
+    {
+        std::string name;
+        size_t count = 0;
+        double p50_ms = 0.0;
+        double p95_ms = 0.0;
+        double p99_ms = 0.0;
+        double max_ms = 0.0;
+    };
+
+    class Tracer {
+        public:
+            static Tracer &Instance();
+
+            // Off by default; spans are still timed for the console output but not recorded
+            void SetEnabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+            bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+            // Monotonic nanoseconds since the tracer was created
+            uint64_t Now() const;
+
+            // Lock free for the calling thread after its first event, except once per
+            // 4096 events. A thread keeps its last kMaxChunksPerThread * 4096 events.
+            void Record(const char *name, uint64_t start_ns, uint64_t end_ns);
+
+            // Events recorded since the last Clear, from every thread
+            std::vector<TraceEvent> Events() const;
+
+            bool WriteChromeTrace(const std::string &trace_file) const;
+            std::vector<StageLatency> Summary() const;
+            void PrintSummary(std::ostream &) const;
+
+            // Drops earlier events and releases their memory
+            void Clear();
+
+            // Events of exited threads are kept for the last this many threads only
+            static const size_t kMaxRetiredThreads = 64;
+            static const size_t kMaxChunksPerThread = 16;
+
+        private:
+            struct Chunk;
+            struct ThreadBuffer;
+            struct ThreadOwner;
+
+            Tracer();
+            ~Tracer();
+            ThreadBuffer *RegisterThread();
+            void RetireThread(ThreadBuffer *);
+            Chunk *NextChunk(ThreadBuffer &);
+
+            std::atomic<bool> enabled_;
+            std::atomic<uint64_t> clear_ns_;
+            int64_t epoch_ns_;
+
+            mutable std::mutex buffers_mutex_;
+            std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+            uint32_t last_thread_id_ = 0;
+    };
+
+    // Times a stage from construction until End() or destruction, whichever is first
+    class TraceScope {
+        public:
+            explicit TraceScope(const char *name);
+            ~TraceScope() { End(); }
+            TraceScope(const TraceScope &) = delete;
+            TraceScope &operator=(const TraceScope &) = delete;
+
+            // Records the span once and returns its length in seconds
+            double End();
+
+        private:
+            const char *name_;
+            uint64_t start_ns_;
+            uint64_t end_ns_;
+    };
+
+} // TactNib
+
+#endif //SYSTEM_API_TRACE_H
@@ -0,0 +1,328 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: benchmarks.cc
+ * Purpose:	  Sweeps every detector x extractor x matcher x filter combination
+ *            of the OpenCV target finder over a generated corpus (the template
+ *            warped by known random homographies, with lighting changes, blur,
+ *            noise and simulated holes) and reports latency against accuracy.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "TactNib/target_image/opencv_strategy.h"
+#include "TactNib/target_image/trace.h"
+
+using namespace TactNib;
+
+namespace {
+
+    // A located target counts as found when its corners are this close to the truth
+    const double kFoundCornerError = 10.0; // pixels at template scale
+
+    // Stages reported per combination, in pipeline order
+    const char *const kStages[] = {"brightness", "scale", "detect", "extract", "match", "filter",
+                                   "homography", "ecc_refine", "warp", "ssim", "total"};
+
+    struct BenchScene
+    {
+        cv::Mat image;
+        std::vector<cv::Point2f> corners;   // ground truth template corners in the scene
+    };
+
+    struct BenchResult
+    {
+        std::string name;
+        int scenes = 0;
+        int found = 0;
+        double corner_error = 0.0;  // mean over located scenes
+        double score = 0.0;         // mean over located scenes
+        double peak_mb = 0.0;
+        std::vector<StageLatency> stages;
+    };
+
+    // Discards the finder's console output while a combination runs
+    class NullBuffer : public std::streambuf {
+        protected:
+            int overflow(int c) override { return c; }
+    };
+
+    //================================================
+    // Function: ResetPeakMemory / PeakMemoryMB
+    //  Note: Linux resets the peak RSS through clear_refs so each combination gets
+    //        its own peak; elsewhere the process peak is reported
+    //================================================
+    void ResetPeakMemory()
+    {
+        std::ofstream clear_refs("/proc/self/clear_refs");
+        if (clear_refs) {
+            clear_refs << "5";
+        }
+    }
+
+    double PeakMemoryMB()
+    {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line)) {
+            if (line.compare(0, 6, "VmHWM:") == 0) {
+                return std::stod(line.substr(6)) / 1024.0;
+            }
+        }
+
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+        return usage.ru_maxrss / 1024.0;
+#endif
+    }
+
+    //================================================
+    // Function: MakeScene
+    //  Note: Same size as the template so the finder's rescale is the identity
+    //================================================
+    BenchScene MakeScene(const cv::Mat &image_object, cv::RNG &rng)
+    {
+        const float width = (float) image_object.cols;
+        const float height = (float) image_object.rows;
+
+        // Simulated holes are punched in the paper before it is warped
+        cv::Mat paper = image_object.clone();
+        int holes = rng.uniform(3, 16);
+        for (int i = 0; i < holes; i++) {
+            cv::Point center(rng.uniform(0, image_object.cols), rng.uniform(0, image_object.rows));
+            cv::circle(paper, center, rng.uniform(6, 13), cv::Scalar(20, 20, 20), cv::FILLED, cv::LINE_AA);
+        }
+
+        // Random placement: scale, rotation, offset and per corner perspective jitter
+        double scale = rng.uniform(0.6, 0.9);
+        double angle = rng.uniform(-10.0, 10.0) * CV_PI / 180.0;
+        cv::Point2f center(width * 0.5f + (float) rng.uniform(-0.05, 0.05) * width,
+                           height * 0.5f + (float) rng.uniform(-0.05, 0.05) * height);
+        std::vector<cv::Point2f> object_corners = {{0, 0}, {width, 0}, {width, height}, {0, height}};
+        BenchScene scene;
+        for (const cv::Point2f &corner : object_corners) {
+            cv::Point2f offset = (corner - cv::Point2f(width * 0.5f, height * 0.5f)) * (float) scale;
+            cv::Point2f rotated((float) (offset.x * std::cos(angle) - offset.y * std::sin(angle)),
+                                (float) (offset.x * std::sin(angle) + offset.y * std::cos(angle)));
+            cv::Point2f jitter((float) rng.uniform(-0.04, 0.04) * width, (float) rng.uniform(-0.04, 0.04) * height);
+            scene.corners.push_back(center + rotated + jitter);
+        }
+        cv::Mat h_obj_to_scene = cv::getPerspectiveTransform(object_corners, scene.corners);
+
+        // Textured background, then the paper on top of it
+        scene.image = cv::Mat(image_object.size(), image_object.type());
+        rng.fill(scene.image, cv::RNG::UNIFORM, cv::Scalar::all(60), cv::Scalar::all(140));
+        cv::GaussianBlur(scene.image, scene.image, cv::Size(0, 0), 4.0);
+        cv::warpPerspective(paper, scene.image, h_obj_to_scene, scene.image.size(), cv::INTER_LINEAR,
+                            cv::BORDER_TRANSPARENT);
+
+        // Lighting, blur and sensor noise
+        scene.image.convertTo(scene.image, -1, rng.uniform(0.7, 1.3), rng.uniform(-30.0, 30.0));
+        double sigma = rng.uniform(0.0, 2.0);
+        if (sigma > 0.3) {
+            cv::GaussianBlur(scene.image, scene.image, cv::Size(0, 0), sigma);
+        }
+        cv::Mat noise(scene.image.size(), CV_16SC3);
+        rng.fill(noise, cv::RNG::NORMAL, cv::Scalar::all(0), cv::Scalar::all(rng.uniform(2.0, 8.0)));
+        cv::add(scene.image, noise, scene.image, cv::noArray(), scene.image.type());
+        return scene;
+    }
+
+    //================================================
+    // Function: RunCombination
+    //================================================
+    BenchResult RunCombination(const std::string &template_file, const FinderConfig &config,
+                               const std::vector<BenchScene> &corpus)
+    {
+        BenchResult result;
+        result.name = std::string(ToString(config.detector_type)) + "/" + ToString(config.extract_type) + "/" +
+                      ToString(config.match_type) + "/" + ToString(config.filter_type);
+        result.scenes = (int) corpus.size();
+
+        ResetPeakMemory();
+        Tracer::Instance().Clear();
+
+        OpenCvStrategy strategy(std::string(), template_file);
+        strategy.SetConfig(config);
+        strategy.SetDisplayImages(false);
+        try {
+            if (!strategy.PrepareTemplate()) {
+                return result;
+            }
+        } catch (const cv::Exception &) {
+            // e.g. FAST has no descriptor extractor
+            return result;
+        }
+
+        for (const BenchScene &scene : corpus) {
+            SceneContext context;
+            context.image_scene = scene.image;
+            try {
+                TraceScope trace_total("total");
+                strategy.PrepareScene(context);
+                strategy.DetectFeatures(context);
+                strategy.MatchFeatures(context);
+                strategy.EstimateHomography(context);
+                strategy.RefineAlignment(context);
+                strategy.WarpAndScore(context);
+            } catch (const cv::Exception &) {
+                context.valid = false;
+            }
+            if (!context.valid || context.scene_corners.size() != 4) {
+                continue;
+            }
+
+            // Scenes are template sized, so the scene corners need no rescaling
+            double error = 0.0;
+            for (int i = 0; i < 4; i++) {
+                error += cv::norm(context.scene_corners[i] - scene.corners[i]);
+            }
+            error /= 4.0;
+            if (error < kFoundCornerError) {
+                result.found++;
+                result.corner_error += error;
+                result.score += context.score;
+            }
+        }
+        if (result.found > 0) {
+            result.corner_error /= result.found;
+            result.score /= result.found;
+        }
+        result.peak_mb = PeakMemoryMB();
+        result.stages = Tracer::Instance().Summary();
+        return result;
+    }
+
+    const StageLatency *FindStage(const BenchResult &result, const std::string &name)
+    {
+        for (const StageLatency &stage : result.stages) {
+            if (stage.name == name) {
+                return &stage;
+            }
+        }
+        return nullptr;
+    }
+}
+
+int main(int argc, char *argv[]) {
+
+    std::string template_file = (argc > 1) ? argv[1] : "../data/target_template_image.jpeg";
+    int num_scenes = (argc > 2) ? std::stoi(argv[2]) : 8;
+    std::string csv_file = (argc > 3) ? argv[3] : "benchmarks.csv";
+    uint64_t seed = (argc > 4) ? std::stoull(argv[4]) : 1;
+
+    cv::Mat image_object = cv::imread(template_file, cv::IMREAD_COLOR);
+    if (image_object.empty()) {
+        std::cout << "Usage: benchmarks [template_image] [num_scenes] [output_csv] [seed]" << std::endl;
+        std::cout << "Unable to read template image " << template_file << std::endl;
+        return 1;
+    }
+
+    // The corpus is the same for every combination and, for a given seed, every run
+    cv::RNG rng(seed);
+    std::vector<BenchScene> corpus;
+    for (int i = 0; i < num_scenes; i++) {
+        corpus.push_back(MakeScene(image_object, rng));
+    }
+    std::cout << "Corpus: " << num_scenes << " scenes of " << image_object.cols << " x " << image_object.rows
+              << ", seed " << seed << std::endl;
+
+    Tracer::Instance().SetEnabled(true);
+
+    const FeatureDetectorType detectors[] = {FeatureDetectorType::Detect_FAST, FeatureDetectorType::Detect_SIFT,
+                                             FeatureDetectorType::Detect_ORB};
+    const FeatureExtractType extractors[] = {FeatureExtractType::Extract_FAST, FeatureExtractType::Extract_SIFT,
+                                             FeatureExtractType::Extract_ORB};
+    const MatchType matchers[] = {MatchType::Match_FLANN, MatchType::Match_BRUTEFORCE, MatchType::Match_HAMMING,
+                                  MatchType::Match_ROOTSIFT};
+    const FilterType filters[] = {FilterType::Filter_LOWES, FilterType::Filter_SCORE};
+
+    std::vector<BenchResult> results;
+    NullBuffer null_buffer;
+    for (FeatureDetectorType detector_type : detectors) {
+        for (FeatureExtractType extract_type : extractors) {
+            for (MatchType match_type : matchers) {
+                // The other pairs run even when they find nothing; RootSIFT cannot read them at all
+                if (!MatcherSupports(match_type, extract_type)) {
+                    continue;
+                }
+                for (FilterType filter_type : filters) {
+                    FinderConfig config;
+                    config.detector_type = detector_type;
+                    config.extract_type = extract_type;
+                    config.match_type = match_type;
+                    config.filter_type = filter_type;
+
+                    std::streambuf *console = std::cout.rdbuf(&null_buffer);
+                    BenchResult result = RunCombination(template_file, config, corpus);
+                    std::cout.rdbuf(console);
+
+                    std::cout << "  " << result.name << ": found " << result.found << "/" << result.scenes
+                              << std::endl;
+                    results.push_back(result);
+                }
+            }
+        }
+    }
+
+    // Latency vs accuracy table, p50 per stage in milliseconds
+    std::cout << std::endl << std::left << std::setw(28) << "combination" << std::right
+              << std::setw(7) << "found" << std::setw(9) << "err px" << std::setw(8) << "ssim"
+              << std::setw(9) << "peak MB" << std::setw(9) << "detect" << std::setw(9) << "extract"
+              << std::setw(9) << "match" << std::setw(9) << "ecc" << std::setw(9) << "ssim ms"
+              << std::setw(10) << "total p50" << std::setw(10) << "total p95" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    for (const BenchResult &result : results) {
+        auto p50 = [&result](const char *name) {
+            const StageLatency *stage = FindStage(result, name);
+            return stage ? stage->p50_ms : 0.0;
+        };
+        const StageLatency *total = FindStage(result, "total");
+        std::cout << std::left << std::setw(28) << result.name << std::right
+                  << std::setw(4) << result.found << "/" << std::setw(2) << result.scenes
+                  << std::setw(9) << result.corner_error << std::setw(8) << result.score
+                  << std::setw(9) << result.peak_mb << std::setw(9) << p50("detect") << std::setw(9) << p50("extract")
+                  << std::setw(9) << p50("match") << std::setw(9) << p50("ecc_refine") << std::setw(9) << p50("ssim")
+                  << std::setw(10) << (total ? total->p50_ms : 0.0) << std::setw(10) << (total ? total->p95_ms : 0.0)
+                  << std::endl;
+    }
+
+    // Every stage with p50/p95/p99 for tracking across releases
+    std::ofstream csv(csv_file);
+    csv << "combination,scenes,found,corner_error_px,ssim_score,peak_mb";
+    for (const char *name : kStages) {
+        csv << "," << name << "_p50_ms," << name << "_p95_ms," << name << "_p99_ms";
+    }
+    csv << std::endl;
+    for (const BenchResult &result : results) {
+        csv << result.name << "," << result.scenes << "," << result.found << "," << result.corner_error << ","
+            << result.score << "," << result.peak_mb;
+        for (const char *name : kStages) {
+            const StageLatency *stage = FindStage(result, name);
+            if (stage) {
+                csv << "," << stage->p50_ms << "," << stage->p95_ms << "," << stage->p99_ms;
+            } else {
+                csv << ",,,";
+            }
+        }
+        csv << std::endl;
+    }
+    std::cout << std::endl << "Results written to " << csv_file << std::endl;
+    return 0;
+}
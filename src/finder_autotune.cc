@@ -0,0 +1,82 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: finder_autotune.cc
+ * Purpose:	  Command line tool that tries the finder configurations on sample
+ *            scenes on this machine and writes the fastest one that meets the
+ *            required alignment score, for TargetSceneImage::SetFinderConfigFile.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "TactNib/target_image/finder_autotuner.h"
+
+namespace {
+    // Discards the finder's console output while the candidates run
+    class NullBuffer : public std::streambuf {
+        protected:
+            int overflow(int c) override { return c; }
+    };
+}
+
+int main(int argc, char *argv[]) {
+
+    if (argc < 5) {
+        std::cout << "Usage: finder_autotune <template_image> <output_config> <required_score> <scene_image>..."
+                  << std::endl;
+        return 1;
+    }
+
+    std::string template_file = argv[1];
+    std::string config_file = argv[2];
+    double required_score = std::stod(argv[3]);
+
+    // Thresholds come from the existing config file when there is one
+    TactNib::FinderConfig base;
+    TactNib::LoadFinderConfig(config_file, base);
+
+    TactNib::FinderAutotuner autotuner(template_file, base);
+    for (int i = 4; i < argc; i++) {
+        if (!autotuner.AddSampleScene(argv[i])) {
+            return 1;
+        }
+    }
+
+    NullBuffer null_buffer;
+    std::streambuf *console = std::cout.rdbuf(&null_buffer);
+    std::vector<TactNib::AutotuneResult> results = autotuner.Run(required_score);
+    std::cout.rdbuf(console);
+
+    std::sort(results.begin(), results.end(), [](const TactNib::AutotuneResult &a, const TactNib::AutotuneResult &b) {
+        return a.mean_seconds < b.mean_seconds;
+    });
+    std::cout << std::fixed << std::setprecision(3);
+    for (const TactNib::AutotuneResult &result : results) {
+        const TactNib::FinderConfig &config = result.config;
+        std::cout << (result.meets_score ? "  ok  " : "      ")
+                  << TactNib::ToString(config.detector_type) << "/" << TactNib::ToString(config.extract_type) << "/"
+                  << TactNib::ToString(config.match_type) << "/" << TactNib::ToString(config.filter_type)
+                  << (config.ecc_refine ? " +ecc" : "") << ": " << result.mean_seconds << " s, score min "
+                  << result.min_score << " mean " << result.mean_score << ", located " << result.located << "/"
+                  << result.scenes << std::endl;
+    }
+
+    TactNib::FinderConfig best;
+    if (!TactNib::FinderAutotuner::SelectFastest(results, best)) {
+        std::cout << "No configuration reaches a score of " << required_score << std::endl;
+        return 1;
+    }
+    if (!TactNib::SaveFinderConfig(config_file, best)) {
+        return 1;
+    }
+    std::cout << "Wrote " << config_file << ": " << TactNib::ToString(best.detector_type) << "/"
+              << TactNib::ToString(best.extract_type) << "/" << TactNib::ToString(best.match_type) << "/"
+              << TactNib::ToString(best.filter_type) << (best.ecc_refine ? " +ecc" : "") << std::endl;
+    return 0;
+}
@@ -19,21 +19,34 @@
 
 #include <iostream>
 #include "TactNib/target_image/target_scene_image.h"
+#include "TactNib/target_image/trace.h"
 
 int main() {
 
     std::cout << "System-API: Main!" << std::endl;
 
+    // Record per-stage timings; open trace.json in chrome://tracing or ui.perfetto.dev
+    TactNib::Tracer::Instance().SetEnabled(true);
+
     TactNib::TargetSceneImage scene_image;
 
     // Set up scene image for processing
     scene_image.SetSceneImage("../data/target_bullet_hole.jpg");
     scene_image.SetTargetImage("../data/target_template_image.jpeg");
+
+    // Use the pre-analyzed template when one has been built with template_pack_tool
+    scene_image.SetTemplatePack("../data/target_template_image.pack");
+
+    // Per template finder settings; finder_autotune writes a tuned one for this machine
+    scene_image.SetFinderConfigFile("../data/target_template_image.yml");
     scene_image.SetTargetFinderStrategy(TactNib::TargetFinderStrategyType::OpenCvRect);
 
     // Process scene image to find the desired paper target
     scene_image.ProcessScene();
 
+    TactNib::Tracer::Instance().WriteChromeTrace("trace.json");
+    TactNib::Tracer::Instance().PrintSummary(std::cout);
+
     std::cout << "End of Main" << std::endl;
     return 0;
 }
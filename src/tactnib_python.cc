@@ -0,0 +1,564 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: tactnib_python.cc
+ * Purpose:	  Python extension module "tactnib" for offline analytics. Scenes are
+ *            passed as NumPy arrays (or anything with the buffer protocol), JPEG
+ *            bytes or file paths; arrays are read in place and aligned images
+ *            come back as NumPy arrays over the finder's own pixels. The GIL is
+ *            released while the finder runs.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+#include "TactNib/target_image/target_scene_image.h"
+
+namespace {
+
+    using TactNib::CancelToken;
+    using TactNib::CornerPoint;
+    using TactNib::ImageSource;
+    using TactNib::TargetFinderStrategyType;
+    using TactNib::TargetObjectImage;
+    using TactNib::TargetSceneImage;
+
+    // Strategy names as Python passes them
+    struct StrategyName
+    {
+        const char *name;
+        TargetFinderStrategyType type;
+    };
+    const StrategyName kStrategies[] = {
+            {"ObjectDetect", TargetFinderStrategyType::ObjectDetect},
+            {"OpenCvRect", TargetFinderStrategyType::OpenCvRect},
+            {"Cascade", TargetFinderStrategyType::Cascade},
+            {"ContourQuad", TargetFinderStrategyType::ContourQuad},
+    };
+
+    PyTypeObject *image_type = nullptr;
+    PyTypeObject *result_type = nullptr;
+    PyTypeObject *finder_type = nullptr;
+
+    //================================================
+    // Image: a result cv::Mat exported through the buffer protocol
+    //================================================
+    struct ImageObject
+    {
+        PyObject_HEAD
+        cv::Mat mat;
+        int ndim;
+        Py_ssize_t shape[3];
+        Py_ssize_t strides[3];
+    };
+
+    void ImageDealloc(PyObject *self)
+    {
+        PyTypeObject *type = Py_TYPE(self);
+        reinterpret_cast<ImageObject *>(self)->mat.~Mat();
+        type->tp_free(self);
+        Py_DECREF(type);
+    }
+
+    int ImageGetBuffer(PyObject *self, Py_buffer *view, int flags)
+    {
+        ImageObject *image = reinterpret_cast<ImageObject *>(self);
+
+        // Without strides the consumer assumes contiguous rows
+        if ((flags & PyBUF_STRIDES) != PyBUF_STRIDES && !image->mat.isContinuous()) {
+            PyErr_SetString(PyExc_BufferError, "image rows are not contiguous");
+            view->obj = nullptr;
+            return -1;
+        }
+
+        view->buf = image->mat.data;
+        view->obj = self;
+        Py_INCREF(self);
+        view->len = static_cast<Py_ssize_t>(image->mat.total() * image->mat.elemSize());
+        view->readonly = 0;
+        view->itemsize = 1;
+        view->format = (flags & PyBUF_FORMAT) ? const_cast<char *>("B") : nullptr;
+        view->ndim = image->ndim;
+        view->shape = (flags & PyBUF_ND) == PyBUF_ND ? image->shape : nullptr;
+        view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? image->strides : nullptr;
+        view->suboffsets = nullptr;
+        view->internal = nullptr;
+        return 0;
+    }
+
+    PyType_Slot kImageSlots[] = {
+            {Py_tp_dealloc, reinterpret_cast<void *>(ImageDealloc)},
+            {Py_bf_getbuffer, reinterpret_cast<void *>(ImageGetBuffer)},
+            {Py_tp_doc, const_cast<char *>("Pixels of a finder result, shared with NumPy without a copy")},
+            {0, nullptr},
+    };
+    PyType_Spec kImageSpec = {"tactnib.Image", sizeof(ImageObject), 0, Py_TPFLAGS_DEFAULT, kImageSlots};
+
+    //================================================
+    // Function: MakeArray
+    //  Note: A memoryview when NumPy is not installed; None for an empty image
+    //================================================
+    PyObject *MakeArray(const cv::Mat &mat)
+    {
+        if (mat.empty()) {
+            Py_RETURN_NONE;
+        }
+        if (mat.depth() != CV_8U || mat.dims != 2) {
+            PyErr_SetString(PyExc_TypeError, "only 8 bit images are exported");
+            return nullptr;
+        }
+
+        PyObject *object = image_type->tp_alloc(image_type, 0);
+        if (object == nullptr) {
+            return nullptr;
+        }
+        ImageObject *image = reinterpret_cast<ImageObject *>(object);
+        new (&image->mat) cv::Mat(mat);
+        image->ndim = mat.channels() == 1 ? 2 : 3;
+        image->shape[0] = mat.rows;
+        image->shape[1] = mat.cols;
+        image->shape[2] = mat.channels();
+        image->strides[0] = static_cast<Py_ssize_t>(mat.step[0]);
+        image->strides[1] = static_cast<Py_ssize_t>(mat.elemSize());
+        image->strides[2] = 1;
+
+        // numpy.asarray views the buffer; the array keeps the Image, and so the Mat, alive
+        static PyObject *asarray = nullptr;
+        if (asarray == nullptr) {
+            PyObject *numpy = PyImport_ImportModule("numpy");
+            if (numpy == nullptr) {
+                PyErr_Clear();
+                PyObject *memory = PyMemoryView_FromObject(object);
+                Py_DECREF(object);
+                return memory;
+            }
+            asarray = PyObject_GetAttrString(numpy, "asarray");
+            Py_DECREF(numpy);
+            if (asarray == nullptr) {
+                Py_DECREF(object);
+                return nullptr;
+            }
+        }
+        PyObject *array = PyObject_CallFunctionObjArgs(asarray, object, nullptr);
+        Py_DECREF(object);
+        return array;
+    }
+
+    //================================================
+    // Function: SourceFromObject
+    //  Note: A buffer is wrapped in place and stays held in views until the finder is
+    //        done with it. The finder only reads scenes, so read-only arrays are fine.
+    //================================================
+    bool SourceFromObject(PyObject *object, ImageSource &source, std::vector<Py_buffer> &views)
+    {
+        if (PyUnicode_Check(object)) {
+            const char *path = PyUnicode_AsUTF8(object);
+            if (path == nullptr) {
+                return false;
+            }
+            source = ImageSource::FromFile(path);
+            return true;
+        }
+
+        // Encoded bytes are decoded by the finder, so only the JPEG itself is copied
+        if (PyBytes_Check(object)) {
+            const uchar *data = reinterpret_cast<const uchar *>(PyBytes_AS_STRING(object));
+            source = ImageSource::FromBuffer(std::vector<uchar>(data, data + PyBytes_GET_SIZE(object)));
+            return true;
+        }
+
+        Py_buffer view;
+        if (PyObject_GetBuffer(object, &view, PyBUF_RECORDS_RO) != 0) {
+            return false;
+        }
+        bool bgr = view.ndim == 3 && view.itemsize == 1 &&
+                   (view.format == nullptr || std::strcmp(view.format, "B") == 0) &&
+                   view.shape[0] > 0 && view.shape[1] > 0 && view.shape[2] == 3 &&
+                   view.strides[2] == 1 && view.strides[1] == 3 && view.strides[0] >= view.shape[1] * 3;
+        if (!bgr) {
+            PyBuffer_Release(&view);
+            PyErr_SetString(PyExc_ValueError, "scene arrays must be uint8 BGR of shape (rows, cols, 3) with "
+                                              "contiguous pixels");
+            return false;
+        }
+        cv::Mat image(static_cast<int>(view.shape[0]), static_cast<int>(view.shape[1]), CV_8UC3, view.buf,
+                      static_cast<size_t>(view.strides[0]));
+        source = ImageSource::FromMat(image, "array");
+        views.push_back(view);
+        return true;
+    }
+
+    void ReleaseViews(std::vector<Py_buffer> &views)
+    {
+        for (Py_buffer &view : views) {
+            PyBuffer_Release(&view);
+        }
+        views.clear();
+    }
+
+    //================================================
+    // Result: (score, corners, image, template_name, partial)
+    //================================================
+    PyStructSequence_Field kResultFields[] = {
+            {"score", "SSIM of the aligned image and the template, 0 to 100"},
+            {"corners", "Paper corners in pixels of the scene as given, with every strategy: top left, "
+                        "top right, bottom right, bottom left"},
+            {"image", "Aligned target as a NumPy array, None when not found"},
+            {"template_name", "Library template the scene was routed to"},
+            {"partial", "Stopped by the timeout: corners may be set without image or score"},
+            {nullptr, nullptr},
+    };
+    PyStructSequence_Desc kResultDesc = {"tactnib.Result", "Target found in one scene", kResultFields, 5};
+
+    PyObject *MakeResult(const TargetObjectImage &target)
+    {
+        const CornerPoint *corners = target.corner_points_;
+        PyObject *items[5] = {
+                PyFloat_FromDouble(target.score_),
+                Py_BuildValue("((ii)(ii)(ii)(ii))", corners[0].x, corners[0].y, corners[1].x, corners[1].y,
+                              corners[2].x, corners[2].y, corners[3].x, corners[3].y),
+                MakeArray(target.image_),
+                PyUnicode_FromStringAndSize(target.template_name_.data(),
+                                            static_cast<Py_ssize_t>(target.template_name_.size())),
+                PyBool_FromLong(target.partial_),
+        };
+        PyObject *result = PyStructSequence_New(result_type);
+        for (int i = 0; i < 5; i++) {
+            if (items[i] == nullptr || result == nullptr) {
+                for (PyObject *item : items) {
+                    Py_XDECREF(item);
+                }
+                Py_XDECREF(result);
+                return nullptr;
+            }
+        }
+        for (int i = 0; i < 5; i++) {
+            PyStructSequence_SetItem(result, i, items[i]);
+        }
+        return result;
+    }
+
+    //================================================
+    // Finder: one TargetSceneImage, configured once
+    //================================================
+    struct FinderObject
+    {
+        PyObject_HEAD
+        TargetSceneImage *scene;
+        std::mutex *mutex;                  // one call at a time; held without the GIL
+        std::vector<Py_buffer> *target_views;   // an array target is read for the finder's lifetime
+    };
+
+    void FinderDealloc(PyObject *self)
+    {
+        PyTypeObject *type = Py_TYPE(self);
+        FinderObject *finder = reinterpret_cast<FinderObject *>(self);
+
+        // Pending work finishes first and never needs the GIL
+        TargetSceneImage *scene = finder->scene;
+        Py_BEGIN_ALLOW_THREADS
+        delete scene;
+        Py_END_ALLOW_THREADS
+        if (finder->target_views != nullptr) {
+            ReleaseViews(*finder->target_views);
+        }
+        delete finder->target_views;
+        delete finder->mutex;
+        type->tp_free(self);
+        Py_DECREF(type);
+    }
+
+    int FinderInit(PyObject *self, PyObject *args, PyObject *kwargs)
+    {
+        static const char *keywords[] = {"target", "strategy", "template_pack", "config", nullptr};
+        PyObject *target = nullptr;
+        const char *strategy = "OpenCvRect";
+        const char *template_pack = nullptr;
+        const char *config = nullptr;
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|szz", const_cast<char **>(keywords), &target,
+                                         &strategy, &template_pack, &config)) {
+            return -1;
+        }
+
+        const StrategyName *strategy_name = nullptr;
+        for (const StrategyName &name : kStrategies) {
+            if (std::strcmp(name.name, strategy) == 0) {
+                strategy_name = &name;
+            }
+        }
+        if (strategy_name == nullptr) {
+            PyErr_Format(PyExc_ValueError, "unknown strategy '%s'", strategy);
+            return -1;
+        }
+
+        // A second __init__ would pull the scene from under a running call. The finder
+        // counts as initialized only once every step below succeeded, so a failed
+        // __init__ can be retried.
+        FinderObject *finder = reinterpret_cast<FinderObject *>(self);
+        if (finder->scene != nullptr) {
+            PyErr_SetString(PyExc_RuntimeError, "Finder is already initialized");
+            return -1;
+        }
+
+        ImageSource target_source;
+        std::vector<Py_buffer> target_views;
+        if (!SourceFromObject(target, target_source, target_views)) {
+            return -1;
+        }
+
+        // Same order as main.cc; never open a HighGUI window from Python
+        auto *scene = new TargetSceneImage();
+        scene->SetHeadless(true);
+        scene->SetTargetImage(target_source);
+        if (template_pack != nullptr && !scene->SetTemplatePack(template_pack)) {
+            delete scene;
+            ReleaseViews(target_views);
+            PyErr_Format(PyExc_ValueError, "unable to load template pack '%s'", template_pack);
+            return -1;
+        }
+        if (config != nullptr && !scene->SetFinderConfigFile(config)) {
+            delete scene;
+            ReleaseViews(target_views);
+            PyErr_Format(PyExc_ValueError, "unable to load finder config '%s'", config);
+            return -1;
+        }
+        scene->SetTargetFinderStrategy(strategy_name->type);
+        finder->mutex = new std::mutex();
+        finder->target_views = new std::vector<Py_buffer>(std::move(target_views));
+        finder->scene = scene;
+        return 0;
+    }
+
+    bool CheckInitialized(FinderObject *finder)
+    {
+        if (finder->scene == nullptr) {
+            PyErr_SetString(PyExc_RuntimeError, "Finder is not initialized");
+            return false;
+        }
+        return true;
+    }
+
+    //================================================
+    // Member Function: Finder.process
+    //================================================
+    PyObject *FinderProcess(PyObject *self, PyObject *args, PyObject *kwargs)
+    {
+        static const char *keywords[] = {"scene", "timeout", nullptr};
+        PyObject *scene_object = nullptr;
+        PyObject *timeout_object = Py_None;
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", const_cast<char **>(keywords), &scene_object,
+                                         &timeout_object)) {
+            return nullptr;
+        }
+        FinderObject *finder = reinterpret_cast<FinderObject *>(self);
+        if (!CheckInitialized(finder)) {
+            return nullptr;
+        }
+
+        CancelToken cancel;
+        if (timeout_object != Py_None) {
+            double timeout = PyFloat_AsDouble(timeout_object);
+            if (timeout == -1.0 && PyErr_Occurred()) {
+                return nullptr;
+            }
+            cancel.SetTimeout(std::chrono::duration_cast<CancelToken::Clock::duration>(
+                    std::chrono::duration<double>(timeout)));
+        }
+
+        std::vector<Py_buffer> views;
+        ImageSource scene;
+        if (!SourceFromObject(scene_object, scene, views)) {
+            return nullptr;
+        }
+
+        TargetObjectImage target;
+        std::string error;
+        Py_BEGIN_ALLOW_THREADS
+        try {
+            std::lock_guard<std::mutex> lock(*finder->mutex);
+            target = finder->scene->ProcessSceneAsync(scene, cancel).get();
+        } catch (const std::exception &e) {
+            error = e.what();
+        }
+        Py_END_ALLOW_THREADS
+
+        ReleaseViews(views);
+        if (!error.empty()) {
+            PyErr_SetString(PyExc_RuntimeError, error.c_str());
+            return nullptr;
+        }
+        return MakeResult(target);
+    }
+
+    //================================================
+    // Member Function: Finder.process_batch
+    //================================================
+    PyObject *FinderProcessBatch(PyObject *self, PyObject *args, PyObject *kwargs)
+    {
+        static const char *keywords[] = {"scenes", "num_threads", nullptr};
+        PyObject *scenes_object = nullptr;
+        unsigned int num_threads = 0;
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|I", const_cast<char **>(keywords), &scenes_object,
+                                         &num_threads)) {
+            return nullptr;
+        }
+        FinderObject *finder = reinterpret_cast<FinderObject *>(self);
+        if (!CheckInitialized(finder)) {
+            return nullptr;
+        }
+
+        PyObject *sequence = PySequence_Fast(scenes_object, "scenes must be a sequence");
+        if (sequence == nullptr) {
+            return nullptr;
+        }
+        Py_ssize_t count = PySequence_Fast_GET_SIZE(sequence);
+        std::vector<Py_buffer> views;
+        std::vector<ImageSource> scenes(static_cast<size_t>(count));
+        for (Py_ssize_t i = 0; i < count; i++) {
+            if (!SourceFromObject(PySequence_Fast_GET_ITEM(sequence, i), scenes[i], views)) {
+                ReleaseViews(views);
+                Py_DECREF(sequence);
+                return nullptr;
+            }
+        }
+
+        std::vector<TargetObjectImage> targets;
+        std::string error;
+        Py_BEGIN_ALLOW_THREADS
+        try {
+            std::lock_guard<std::mutex> lock(*finder->mutex);
+            targets = finder->scene->ProcessScenes(scenes, num_threads);
+        } catch (const std::exception &e) {
+            error = e.what();
+        }
+        scenes.clear();
+        Py_END_ALLOW_THREADS
+
+        ReleaseViews(views);
+        Py_DECREF(sequence);
+        if (!error.empty()) {
+            PyErr_SetString(PyExc_RuntimeError, error.c_str());
+            return nullptr;
+        }
+
+        PyObject *results = PyList_New(static_cast<Py_ssize_t>(targets.size()));
+        if (results == nullptr) {
+            return nullptr;
+        }
+        for (size_t i = 0; i < targets.size(); i++) {
+            PyObject *result = MakeResult(targets[i]);
+            if (result == nullptr) {
+                Py_DECREF(results);
+                return nullptr;
+            }
+            PyList_SET_ITEM(results, static_cast<Py_ssize_t>(i), result);
+        }
+        return results;
+    }
+
+    PyMethodDef kFinderMethods[] = {
+            {"process", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(FinderProcess)),
+             METH_VARARGS | METH_KEYWORDS,
+             "process(scene, timeout=None) -> Result\n\n"
+             "Find the target in one scene: a BGR uint8 array, JPEG bytes or a file path.\n"
+             "A timeout in seconds stops the finder early with a partial result."},
+            {"process_batch", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(FinderProcessBatch)),
+             METH_VARARGS | METH_KEYWORDS,
+             "process_batch(scenes, num_threads=0) -> list[Result]\n\n"
+             "Find the target in every scene on a pool of worker threads, results in scene\n"
+             "order; zero threads uses every core."},
+            {nullptr, nullptr, 0, nullptr},
+    };
+
+    PyType_Slot kFinderSlots[] = {
+            {Py_tp_new, reinterpret_cast<void *>(PyType_GenericNew)},
+            {Py_tp_init, reinterpret_cast<void *>(FinderInit)},
+            {Py_tp_dealloc, reinterpret_cast<void *>(FinderDealloc)},
+            {Py_tp_methods, kFinderMethods},
+            {Py_tp_doc, const_cast<char *>(
+                    "Finder(target, strategy='OpenCvRect', template_pack=None, config=None)\n\n"
+                    "Finds the target template in scenes. The target is a BGR uint8 array, JPEG bytes\n"
+                    "or a file path; an array is read in place, so leave it unchanged. strategy is one\n"
+                    "of tactnib.strategies; template_pack and config are files written by\n"
+                    "template_pack_tool and finder_autotune.")},
+            {0, nullptr},
+    };
+    PyType_Spec kFinderSpec = {"tactnib.Finder", sizeof(FinderObject), 0, Py_TPFLAGS_DEFAULT, kFinderSlots};
+
+    //================================================
+    // Function: set_opencv_threads
+    //================================================
+    PyObject *SetOpencvThreads(PyObject *, PyObject *args)
+    {
+        int num_threads = 0;
+        if (!PyArg_ParseTuple(args, "i", &num_threads)) {
+            return nullptr;
+        }
+        cv::setNumThreads(num_threads);
+        Py_RETURN_NONE;
+    }
+
+    PyMethodDef kModuleMethods[] = {
+            {"set_opencv_threads", SetOpencvThreads, METH_VARARGS,
+             "set_opencv_threads(n)\n\n"
+             "OpenCV's own thread count for the whole process. Call set_opencv_threads(1) once\n"
+             "before process_batch runs a worker per core, so OpenCV does not oversubscribe them."},
+            {nullptr, nullptr, 0, nullptr},
+    };
+
+    PyModuleDef kModule = {
+            PyModuleDef_HEAD_INIT, "tactnib",
+            "Paper target finder. Each process should create its own Finder; a Finder runs one\n"
+            "call at a time and releases the GIL while it does.",
+            -1, kModuleMethods, nullptr, nullptr, nullptr, nullptr,
+    };
+
+} // namespace
+
+//================================================
+// Function: PyInit_tactnib
+//================================================
+PyMODINIT_FUNC PyInit_tactnib()
+{
+    PyObject *module = PyModule_Create(&kModule);
+    if (module == nullptr) {
+        return nullptr;
+    }
+
+    image_type = reinterpret_cast<PyTypeObject *>(PyType_FromSpec(&kImageSpec));
+    result_type = PyStructSequence_NewType(&kResultDesc);
+    finder_type = reinterpret_cast<PyTypeObject *>(PyType_FromSpec(&kFinderSpec));
+    PyObject *strategies = PyTuple_New(sizeof(kStrategies) / sizeof(kStrategies[0]));
+    if (image_type == nullptr || result_type == nullptr || finder_type == nullptr || strategies == nullptr) {
+        Py_XDECREF(strategies);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    for (size_t i = 0; i < sizeof(kStrategies) / sizeof(kStrategies[0]); i++) {
+        PyTuple_SET_ITEM(strategies, static_cast<Py_ssize_t>(i), PyUnicode_FromString(kStrategies[i].name));
+    }
+
+    Py_INCREF(image_type);
+    Py_INCREF(result_type);
+    Py_INCREF(finder_type);
+    if (PyModule_AddObject(module, "Image", reinterpret_cast<PyObject *>(image_type)) != 0 ||
+        PyModule_AddObject(module, "Result", reinterpret_cast<PyObject *>(result_type)) != 0 ||
+        PyModule_AddObject(module, "Finder", reinterpret_cast<PyObject *>(finder_type)) != 0 ||
+        PyModule_AddObject(module, "strategies", strategies) != 0) {
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
@@ -0,0 +1,72 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: template_pack_tool.cc
+ * Purpose:	  Command line tool that analyzes a paper target template once and
+ *            writes a template pack for TargetSceneImage::SetTemplatePack.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <iostream>
+#include <string>
+#include "TactNib/target_image/template_pack.h"
+
+int main(int argc, char *argv[]) {
+
+    if (argc < 3) {
+        std::cout << "Usage: template_pack_tool <template_image> <output_pack> [sift|orb|fast] [finder_config]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string image_file = argv[1];
+    std::string pack_file = argv[2];
+    std::string features = (argc > 3) ? argv[3] : "sift";
+
+    // The ORB budget and the marker ROI come from the template's finder config
+    TactNib::FinderConfig config;
+    if (argc > 4 && !TactNib::LoadFinderConfig(argv[4], config)) {
+        return 1;
+    }
+
+    // Detector/extractor pairs match the working combinations in opencv_strategy.cc
+    TactNib::FeatureDetectorType detector_type;
+    TactNib::FeatureExtractType extract_type;
+    if (features == "sift") {
+        detector_type = TactNib::FeatureDetectorType::Detect_SIFT;
+        extract_type = TactNib::FeatureExtractType::Extract_SIFT;
+    } else if (features == "orb") {
+        detector_type = TactNib::FeatureDetectorType::Detect_ORB;
+        extract_type = TactNib::FeatureExtractType::Extract_ORB;
+    } else if (features == "fast") {
+        detector_type = TactNib::FeatureDetectorType::Detect_FAST;
+        extract_type = TactNib::FeatureExtractType::Extract_ORB;
+    } else {
+        std::cout << "Unknown feature type: " << features << std::endl;
+        return 1;
+    }
+
+    cv::Mat image = cv::imread(image_file, cv::IMREAD_COLOR);
+    if (image.empty()) {
+        std::cout << "Unable to read template image " << image_file << std::endl;
+        return 1;
+    }
+    cv::Mat roi_mask;
+    if (config.template_roi) {
+        roi_mask = TactNib::OpencvAlgo::CreateMarkerMask(image.size(), config.marker_top_margin,
+                                                         config.marker_left_margin);
+    }
+
+    std::shared_ptr<TactNib::TemplatePack> pack = TactNib::TemplatePack::Create(image, detector_type, extract_type,
+                                                                                config.max_features, roi_mask);
+    if (!pack || !pack->Save(pack_file)) {
+        return 1;
+    }
+
+    std::cout << "Template pack: " << pack_file << " (" << pack->keypoints().size() << " keypoints, "
+              << pack->image().cols << " x " << pack->image().rows << ")" << std::endl;
+    return 0;
+}
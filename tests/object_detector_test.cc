@@ -0,0 +1,86 @@
+/** ===========================================================================
+ * Copyright (c) 2022 TactNib, LCC
+ *
+ * File Name: object_detector_test.cc
+ * Purpose:	  Checks ObjectDetector's parsing of YOLOv8-OBB outputs on synthetic
+ *            tensors, so it runs without a model file. Exits non-zero on failure.
+ * Author:	  Michael Eaton
+ *
+ * Coding Standard: https://google.github.io/styleguide/cppguide.html
+ *
+ * ============================================================================*/
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include "TactNib/target_image/object_detector.h"
+
+namespace TactNib {
+
+    class ObjectDetectorTest {
+        public:
+            //================================================
+            // Member Function: ParsesLayout
+            //  Note: The scene is 1280 x 960 letterboxed into 640 x 640: scale 0.5 and
+            //        80 pixels of padding at the top. An overlapping weaker box must fall
+            //        to NMS and one under the score threshold must be dropped.
+            //================================================
+            static bool ParsesLayout(int classes, bool attributes_first)
+            {
+                const int kBoxes = 64;
+                const cv::RotatedRect expected(cv::Point2f(600.0f, 400.0f), cv::Size2f(500.0f, 300.0f), 10.0f);
+                ObjectDetector::Letterbox letterbox;
+                letterbox.scale = 0.5;
+                letterbox.pad = cv::Point2f(0.0f, 80.0f);
+
+                const int attributes = 5 + classes;
+                int sizes[] = {1, attributes_first ? attributes : kBoxes, attributes_first ? kBoxes : attributes};
+                cv::Mat output(3, sizes, CV_32F, cv::Scalar::all(0));
+                float *data = output.ptr<float>(0);
+                auto set = [&](int box, int attribute, double value) {
+                    float &cell = attributes_first ? data[attribute * kBoxes + box] : data[box * attributes + attribute];
+                    cell = static_cast<float>(value);
+                };
+                auto add_box = [&](int box, float x_offset, double score) {
+                    set(box, 0, (expected.center.x + x_offset) * letterbox.scale + letterbox.pad.x);
+                    set(box, 1, expected.center.y * letterbox.scale + letterbox.pad.y);
+                    set(box, 2, expected.size.width * letterbox.scale);
+                    set(box, 3, expected.size.height * letterbox.scale);
+                    set(box, 4 + classes - 1, score);
+                    set(box, 4 + classes, expected.angle * CV_PI / 180.0);
+                };
+                add_box(3, 0.0f, 0.9);
+                add_box(17, 4.0f, 0.6);
+                add_box(40, -300.0f, 0.1);
+
+                ObjectDetector detector;
+                std::vector<OrientedDetection> detections = detector.Parse(output, 0, letterbox);
+                bool ok = detections.size() == 1 && detections[0].class_id == classes - 1 &&
+                          std::abs(detections[0].score - 0.9f) < 1e-4f &&
+                          cv::norm(detections[0].box.center - expected.center) < 1e-2 &&
+                          std::abs(detections[0].box.size.width - expected.size.width) < 1e-2f &&
+                          std::abs(detections[0].box.size.height - expected.size.height) < 1e-2f &&
+                          std::abs(detections[0].box.angle - expected.angle) < 1e-3f;
+                if (!ok) {
+                    std::cout << "FAILED: " << classes << " class(es), " << (attributes_first ? "attributes" : "boxes")
+                              << " first: " << detections.size() << " detection(s)" << std::endl;
+                }
+                return ok;
+            }
+    };
+
+} // TactNib
+
+int main() {
+
+    bool ok = true;
+    for (int classes = 1; classes <= 2; classes++) {
+        for (bool attributes_first : {true, false}) {
+            ok = TactNib::ObjectDetectorTest::ParsesLayout(classes, attributes_first) && ok;
+        }
+    }
+    std::cout << (ok ? "object_detector_test: passed" : "object_detector_test: failed") << std::endl;
+    return ok ? 0 : 1;
+}